@@ -0,0 +1,517 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <bgzf.h>
+#include <ifq.h>
+#include <ifq_format.h>
+
+void usage()
+{
+    printf( "Usage: benchfastq [-p illumina|ont] [-n reads] [-q queries] [-B batch_size] [-S seed] [-z level]\n" );
+    printf( "                  [-a algorithm] [-H hash] [-k keys_per_bin] outputprefix\n" );
+    printf( "Writes a synthetic fastq to outputprefix.fq.gz, indexes it and measures the lookups.\n" );
+}
+
+typedef enum
+{
+    BENCH_ILLUMINA,
+    BENCH_ONT
+} bench_platform_t;
+
+/**
+ * Returns the next value of a splitmix64 generator, the same
+ * seed gives the same fastq file on every machine.
+ *
+ * @param state State of the generator.
+ *
+ * @return A 64-bit pseudo random value.
+ */
+static uint64_t
+next_random(uint64_t *state)
+{
+    uint64_t z = ( *state += 0x9e3779b97f4a7c15ULL );
+    z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+    z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebULL;
+    return z ^ ( z >> 31 );
+}
+
+/**
+ * Returns a pseudo random value in [0, bound).
+ */
+static uint32_t
+random_below(uint64_t *state, uint32_t bound)
+{
+    return (uint32_t) ( ( ( next_random( state ) >> 32 ) * bound ) >> 32 );
+}
+
+/**
+ * Returns a normally distributed pseudo random value, by the
+ * Box-Muller transform.
+ */
+static double
+random_normal(uint64_t *state)
+{
+    double u = ( ( next_random( state ) >> 11 ) + 1.0 ) / 9007199254740993.0;
+    double v = ( next_random( state ) >> 11 ) / 9007199254740992.0;
+    return sqrt( -2.0 * log( u ) ) * cos( 2.0 * M_PI * v );
+}
+
+/**
+ * Writes the accession of a read. Illumina names are unique by
+ * their tile and y coordinate, ONT names by their read number.
+ * Accessions that are not in the file use another flowcell or
+ * run id.
+ *
+ * @param name Output buffer.
+ * @param size Size of the output buffer.
+ * @param platform The sequencing platform.
+ * @param state State of the generator.
+ * @param read Number of the read.
+ * @param missing Whether the accession should not be in the file.
+ *
+ * @return The length of the accession.
+ */
+static int
+make_name(char *name, size_t size, bench_platform_t platform, uint64_t *state, size_t read, int missing)
+{
+    static const char *barcodes[] = { "ATCACG", "CGATGT", "TTAGGC", "TGACCA", "ACAGTG", "GCCAAT", "CAGATC", "ACTTGA" };
+    if( platform == BENCH_ILLUMINA )
+    {
+        return snprintf( name, size, "A00%03u:%u:%s:%u:%zu:%u:%zu 1:N:0:%s", 100 + ( missing ? 1 : 0 ), 42,
+                         missing ? "HMISSDSXY" : "HFLOWDSXY", 1 + random_below( state, 4 ), 1101 + read / 400000,
+                         1000 + random_below( state, 30000 ), 1000 + read % 400000, barcodes[ random_below( state, 8 ) ] );
+    }
+    else
+    {
+        uint64_t a = next_random( state );
+        uint64_t b = next_random( state );
+        return snprintf( name, size, "%08x-%04x-%04x-%04x-%012llx runid=%s read=%zu ch=%u", (uint32_t) ( a >> 32 ),
+                         (uint32_t) ( a >> 16 ) & 0xffff, (uint32_t) a & 0xffff, (uint32_t) ( b >> 48 ),
+                         (unsigned long long) ( b & 0xffffffffffffULL ),
+                         missing ? "0000000000000000" : "5f3e2a9b81c04d67", read, 1 + random_below( state, 512 ) );
+    }
+}
+
+/**
+ * Writes the sequence, separator and quality lines of a read. The
+ * Illumina reads are 150 bp with binned qualities, the ONT reads
+ * have log-normal lengths with a median of about 3 kbp.
+ *
+ * @return The length of the lines, or -1 if they do not fit.
+ */
+static int
+make_lines(char *buffer, size_t size, bench_platform_t platform, uint64_t *state)
+{
+    static const char bases[] = "ACGT";
+    static const char bins[] = "FFFFFFFFFFFF:,#";
+    size_t length;
+    if( platform == BENCH_ILLUMINA )
+    {
+        length = 150;
+    }
+    else
+    {
+        double l = exp( 8.0 + 0.8 * random_normal( state ) );
+        length = l < 200.0 ? 200 : l > 100000.0 ? 100000 : (size_t) l;
+    }
+    if( 2 * length + 4 > size )
+    {
+        return -1;
+    }
+
+    char *quality = buffer + length + 3;
+    size_t i;
+    for(i = 0; i < length; i++)
+    {
+        uint64_t r = next_random( state );
+        buffer[ i ] = ( r & 0x3ff ) == 0 ? 'N' : bases[ ( r >> 10 ) & 3 ];
+        if( platform == BENCH_ILLUMINA )
+        {
+            quality[ i ] = bins[ ( r >> 12 ) % ( sizeof( bins ) - 1 ) ];
+        }
+        else
+        {
+            quality[ i ] = (char) ( '!' + 5 + ( ( r >> 12 ) % 26 ) );
+        }
+    }
+    memcpy( buffer + length, "\n+\n", 3 );
+    quality[ length ] = '\n';
+
+    return (int) ( 2 * length + 4 );
+}
+
+/*
+ * The accessions and the lines are drawn from separate generators,
+ * so that the accessions can be made again without the lines.
+ */
+#define BENCH_LINES_SEED 0x2545f4914f6cdd1dULL
+
+/**
+ * Writes the fastq file through bgzf.
+ *
+ * @param path Path of the compressed fastq file.
+ * @param level Compression level, or -1 for the default of bgzip.
+ * @param platform The sequencing platform.
+ * @param seed Seed of the generator.
+ * @param num_reads Number of reads.
+ * @param bytes Receives the uncompressed size of the file.
+ *
+ * @return 1 if successful, 0 otherwise.
+ */
+static int
+write_fastq(const char *path, int level, bench_platform_t platform, uint64_t seed, size_t num_reads, uint64_t *bytes)
+{
+    char mode[ 3 ] = { 'w', level >= 0 && level <= 9 ? (char) ( '0' + level ) : '\0', '\0' };
+    BGZF *fp = bgzf_open( path, mode );
+    if( fp == NULL )
+    {
+        return 0;
+    }
+
+    size_t buffer_size = 2 * 100000 + 1024;
+    char *buffer = (char *) malloc( buffer_size );
+    uint64_t name_state = seed;
+    uint64_t line_state = seed ^ BENCH_LINES_SEED;
+    size_t i;
+    int ok = buffer != NULL;
+    *bytes = 0;
+    for(i = 0; ok && i < num_reads; i++)
+    {
+        buffer[ 0 ] = '@';
+        int name_length = make_name( buffer + 1, 512, platform, &name_state, i, 0 );
+        buffer[ name_length + 1 ] = '\n';
+
+        int length = name_length + 2;
+        length += make_lines( buffer + length, buffer_size - length, platform, &line_state );
+        ok = bgzf_write( fp, buffer, length ) == length;
+        *bytes += length;
+    }
+
+    free( buffer );
+    if( bgzf_close( fp ) != 0 )
+    {
+        return 0;
+    }
+
+    return ok;
+}
+
+/**
+ * Makes the accessions of the fastq file again.
+ *
+ * @return The accessions in file order, or NULL.
+ */
+static char **
+make_names(bench_platform_t platform, uint64_t seed, size_t num_reads)
+{
+    char **names = (char **) calloc( num_reads, sizeof( char * ) );
+    uint64_t state = seed;
+    size_t i;
+    for(i = 0; names != NULL && i < num_reads; i++)
+    {
+        char name[ 512 ];
+        make_name( name, sizeof( name ), platform, &state, i, 0 );
+        names[ i ] = strdup( name );
+    }
+
+    return names;
+}
+
+static double
+now()
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Builds the index in a child process, so that the peak resident
+ * size is that of the build alone.
+ *
+ * @param seconds Receives the wall clock time of the build.
+ * @param max_rss Receives the peak resident size in kilobytes.
+ *
+ * @return 1 if successful, 0 otherwise.
+ */
+static int
+build_index(char *fastq_path, char *index_prefix, const ifq_options_t *options, double *seconds, long *max_rss)
+{
+    double start = now( );
+    pid_t pid = fork( );
+    if( pid < 0 )
+    {
+        return 0;
+    }
+    if( pid == 0 )
+    {
+        _exit( ifq_create_index_with_options( fastq_path, index_prefix, options ) == IFQ_OK ? 0 : 1 );
+    }
+
+    int status;
+    struct rusage usage;
+    if( wait4( pid, &status, 0, &usage ) != pid )
+    {
+        return 0;
+    }
+    *seconds = now( ) - start;
+    *max_rss = usage.ru_maxrss;
+
+    return WIFEXITED( status ) && WEXITSTATUS( status ) == 0;
+}
+
+static int
+compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return ( x > y ) - ( x < y );
+}
+
+/**
+ * Sorts the latencies and prints a row of percentiles.
+ *
+ * @param workload Name of the workload.
+ * @param latencies Latency in nanoseconds of every sample.
+ * @param num_samples Number of samples.
+ * @param num_queries Number of queries the samples cover.
+ * @param found Number of queries that found their record.
+ * @param seconds Total time of the workload.
+ */
+static void
+print_latencies(const char *workload, double *latencies, size_t num_samples, size_t num_queries, size_t found, double seconds)
+{
+    qsort( latencies, num_samples, sizeof( double ), compare_doubles );
+    printf( "%-20s %9zu %9zu %10.0f %9.0f %9.0f %9.0f %9.0f %9.0f\n", workload, num_queries, found,
+            num_queries / seconds, latencies[ num_samples / 2 ], latencies[ num_samples * 90 / 100 ],
+            latencies[ num_samples * 99 / 100 ], latencies[ num_samples * 999 / 1000 ], latencies[ num_samples - 1 ] );
+}
+
+/**
+ * Times ifq_query_index for every query.
+ */
+static void
+bench_single(ifq_index_t *index, const char *workload, char **queries, size_t num_queries, double *latencies)
+{
+    ifq_record_t *record = ifq_new_record( );
+    size_t found = 0;
+    size_t i;
+    double start = now( );
+    for(i = 0; i < num_queries; i++)
+    {
+        double t = now( );
+        found += ifq_query_index( index, queries[ i ], record ) == IFQ_OK;
+        latencies[ i ] = ( now( ) - t ) * 1e9;
+    }
+    double seconds = now( ) - start;
+    ifq_destroy_record( record );
+
+    print_latencies( workload, latencies, num_queries, num_queries, found, seconds );
+}
+
+/**
+ * Times ifq_query_many on batches of the queries, the latency of
+ * a batch is divided by its size.
+ */
+static void
+bench_batch(ifq_index_t *index, const char *workload, char **queries, size_t num_queries, size_t batch_size, double *latencies)
+{
+    ifq_record_t **records = (ifq_record_t **) malloc( sizeof( ifq_record_t * ) * batch_size );
+    ifq_codes_t *results = (ifq_codes_t *) malloc( sizeof( ifq_codes_t ) * batch_size );
+    size_t num_batches = 0;
+    size_t found = 0;
+    size_t i;
+    for(i = 0; i < batch_size; i++)
+    {
+        records[ i ] = ifq_new_record( );
+    }
+
+    double start = now( );
+    for(i = 0; i < num_queries; i += batch_size)
+    {
+        size_t count = num_queries - i < batch_size ? num_queries - i : batch_size;
+        double t = now( );
+        found += ifq_query_many( index, queries + i, count, records, results );
+        latencies[ num_batches++ ] = ( now( ) - t ) * 1e9 / count;
+    }
+    double seconds = now( ) - start;
+
+    for(i = 0; i < batch_size; i++)
+    {
+        ifq_destroy_record( records[ i ] );
+    }
+    free( records );
+    free( results );
+
+    print_latencies( workload, latencies, num_batches, num_queries, found, seconds );
+}
+
+static int
+compare_names(const void *a, const void *b)
+{
+    return strcmp( *(char * const *) a, *(char * const *) b );
+}
+
+int main(int argc, char **argv)
+{
+    ifq_options_t options;
+    ifq_default_options( &options );
+    bench_platform_t platform = BENCH_ILLUMINA;
+    size_t num_reads = 1000000;
+    size_t num_queries = 100000;
+    size_t batch_size = 1024;
+    uint64_t seed = 42;
+    int level = -1;
+
+    int opt;
+    while( ( opt = getopt( argc, argv, "p:n:q:B:S:z:a:H:k:" ) ) != -1 )
+    {
+        switch( opt )
+        {
+            case 'p':
+                if( strcmp( optarg, "illumina" ) == 0 )
+                {
+                    platform = BENCH_ILLUMINA;
+                }
+                else if( strcmp( optarg, "ont" ) == 0 )
+                {
+                    platform = BENCH_ONT;
+                }
+                else
+                {
+                    printf( "Unknown platform: %s\n", optarg );
+                    exit( 1 );
+                }
+                break;
+            case 'n':
+                num_reads = (size_t) atol( optarg );
+                break;
+            case 'q':
+                num_queries = (size_t) atol( optarg );
+                break;
+            case 'B':
+                batch_size = (size_t) atol( optarg );
+                break;
+            case 'S':
+                seed = (uint64_t) strtoull( optarg, NULL, 10 );
+                break;
+            case 'z':
+                level = atoi( optarg );
+                break;
+            case 'a':
+                options.algorithm = ifq_parse_algorithm( optarg );
+                if( options.algorithm == CMPH_COUNT )
+                {
+                    printf( "Unknown algorithm: %s\n", optarg );
+                    exit( 1 );
+                }
+                break;
+            case 'H':
+                options.hash = ifq_parse_hash( optarg );
+                if( options.hash == CMPH_HASH_COUNT )
+                {
+                    printf( "Unknown hash function: %s\n", optarg );
+                    exit( 1 );
+                }
+                break;
+            case 'k':
+                options.keys_per_bin = (cmph_uint32) atoi( optarg );
+                break;
+            default:
+                usage( );
+                exit( 1 );
+        }
+    }
+
+    if( argc - optind != 1 || num_reads == 0 || num_queries == 0 || batch_size == 0 )
+    {
+        usage( );
+        exit( 1 );
+    }
+
+    char fastq_path[ 4096 ];
+    snprintf( fastq_path, sizeof( fastq_path ), "%s.fq.gz", argv[ optind ] );
+    uint64_t fastq_bytes;
+    double start = now( );
+    if( write_fastq( fastq_path, level, platform, seed, num_reads, &fastq_bytes ) != 1 )
+    {
+        printf( "Failed to write %s\n", fastq_path );
+        return 1;
+    }
+    printf( "generate  %zu reads, %.1f MB in %.2f s\n", num_reads, fastq_bytes / 1e6, now( ) - start );
+
+    double build_seconds;
+    long max_rss;
+    if( build_index( fastq_path, fastq_path, &options, &build_seconds, &max_rss ) != 1 )
+    {
+        printf( "Failed to create index\n" );
+        return 1;
+    }
+    printf( "build     %.2f s, %.0f reads/s, %.1f MB/s, peak RSS %.1f MB\n", build_seconds, num_reads / build_seconds,
+            fastq_bytes / 1e6 / build_seconds, max_rss / 1024.0 );
+
+    char **names = make_names( platform, seed, num_reads );
+    ifq_index_t index;
+    if( names == NULL || ifq_open_index( fastq_path, fastq_path, &index ) != IFQ_OK )
+    {
+        printf( "Failed to open index\n" );
+        return 1;
+    }
+    const ifq_section_t *hash_section = ifq_find_section( index.data, IFQ_SECTION_HASH );
+    printf( "index     %.1f MB, %.2f bits/key, hash function %.2f bits/key\n", index.data_size / 1e6,
+            index.data_size * 8.0 / num_reads, hash_section->size * 8.0 / num_reads );
+
+    /* Hits in random order, in file order, and accessions that are not in the file */
+    uint64_t state = seed ^ 0x5bd1e995ULL;
+    char **random_hits = (char **) malloc( sizeof( char * ) * num_queries );
+    char **sorted_hits = (char **) malloc( sizeof( char * ) * num_queries );
+    char **misses = (char **) malloc( sizeof( char * ) * num_queries );
+    double *latencies = (double *) malloc( sizeof( double ) * num_queries );
+    size_t i;
+    for(i = 0; i < num_queries; i++)
+    {
+        char name[ 512 ];
+        random_hits[ i ] = names[ random_below( &state, (uint32_t) num_reads ) ];
+        make_name( name, sizeof( name ), platform, &state, i, 1 );
+        misses[ i ] = strdup( name );
+    }
+    for(i = 0; i < num_queries; i++)
+    {
+        sorted_hits[ i ] = names[ (size_t) ( (double) i * num_reads / num_queries ) ];
+    }
+    qsort( misses, num_queries, sizeof( char * ), compare_names );
+
+    printf( "%-20s %9s %9s %10s %9s %9s %9s %9s %9s\n", "workload", "queries", "found", "queries/s",
+            "p50_ns", "p90_ns", "p99_ns", "p99.9_ns", "max_ns" );
+    bench_single( &index, "single hit random", random_hits, num_queries, latencies );
+    bench_single( &index, "single hit sorted", sorted_hits, num_queries, latencies );
+    bench_single( &index, "single miss", misses, num_queries, latencies );
+    bench_batch( &index, "batch hit random", random_hits, num_queries, batch_size, latencies );
+    bench_batch( &index, "batch hit sorted", sorted_hits, num_queries, batch_size, latencies );
+    bench_batch( &index, "batch miss", misses, num_queries, batch_size, latencies );
+
+    ifq_destroy_index( &index );
+    for(i = 0; i < num_queries; i++)
+    {
+        free( misses[ i ] );
+    }
+    for(i = 0; i < num_reads; i++)
+    {
+        free( names[ i ] );
+    }
+    free( random_hits );
+    free( sorted_hits );
+    free( misses );
+    free( latencies );
+    free( names );
+
+    return 0;
+}
@@ -1,19 +1,185 @@
+#define PY_SSIZE_T_CLEAN
 #include <Python.h>
+#include <pthread.h>
+#include <errno.h>
 
 #include <ifq.h>
 
+/**
+ * Number of accessions that query_many_indexed_fastq looks up with
+ * each call to ifq_query_many.
+ */
+#define QUERY_BATCH_SIZE 1024
+
+/**
+ * Most readers of one handle, further threads wait for an idle one.
+ */
+#define MAX_READERS 64
+
+/**
+ * A reader serves one query at a time, with its own position and
+ * decompressed block in the fastq file and its own records.
+ */
+typedef struct
+{
+    /**
+     * The index of the handle for the first reader, otherwise own.
+     */
+    ifq_index_t *index;
+
+    /**
+     * A reader opened with ifq_open_reader.
+     */
+    ifq_index_t own;
+
+    ifq_record_t *record;
+
+    /**
+     * QUERY_BATCH_SIZE records for the batched queries, NULL
+     * until the first batch.
+     */
+    ifq_record_t **batch;
+
+    /**
+     * 1 while a thread uses the reader.
+     */
+    int busy;
+} reader_t;
+
 /**
  * Wrapper object for a indexed fastq file. In python it will
- * act as a handle to the file.
+ * act as a handle to the file. The queries run without the GIL,
+ * and threads that query at the same time each get a reader of
+ * their own, so they run in parallel also without a GIL.
  */
 typedef struct
 {
     PyObject_HEAD
 
     ifq_index_t index;
-    ifq_record_t *record;
+
+    /**
+     * The readers, the first reads through index and the others
+     * are opened when more threads query at once.
+     */
+    reader_t **readers;
+    int num_readers;
+
+    /**
+     * Guards the readers and the fields below, idle is signalled
+     * when a reader is released or an exclusive operation ends.
+     */
+    pthread_mutex_t mutex;
+    pthread_cond_t idle;
+
+    /**
+     * Number of readers in use, including those being opened.
+     */
+    int num_busy;
+
+    /**
+     * Number of readers being opened outside the mutex.
+     */
+    int num_opening;
+
+    /**
+     * 1 while an operation on all readers runs, such as reading
+     * the counters, no reader is handed out meanwhile.
+     */
+    int exclusive;
+
+    /**
+     * 1 once the index has been closed.
+     */
+    int closed;
 } c_indexed_fastq_t;
 
+/**
+ * Allocates a reader, it can be called without the mutex and the GIL.
+ *
+ * @param index The index of the handle.
+ * @param own 0 for the first reader, which reads through the index,
+ *            1 for the others, which open the fastq file again.
+ * @param error Receives ENOMEM if out of memory, otherwise the errno
+ *              of opening the fastq file when it could not be opened.
+ *
+ * @return The reader, or NULL on error.
+ */
+static reader_t *
+new_reader(ifq_index_t *index, int own, int *error)
+{
+    reader_t *reader = (reader_t *) calloc( 1, sizeof( reader_t ) );
+    if( reader == NULL || ( reader->record = ifq_new_record( ) ) == NULL )
+    {
+        free( reader );
+        *error = ENOMEM;
+        return NULL;
+    }
+
+    reader->index = index;
+    if( own )
+    {
+        errno = 0;
+        if( ifq_open_reader( index, &reader->own ) != IFQ_OK )
+        {
+            *error = errno != 0 ? errno : EIO;
+            ifq_destroy_record( reader->record );
+            free( reader );
+            return NULL;
+        }
+        reader->index = &reader->own;
+    }
+
+    return reader;
+}
+
+static void
+destroy_reader(reader_t *reader)
+{
+    ifq_destroy_record( reader->record );
+    if( reader->batch != NULL )
+    {
+        size_t i;
+        for(i = 0; i < QUERY_BATCH_SIZE; i++)
+        {
+            ifq_destroy_record( reader->batch[ i ] );
+        }
+        free( reader->batch );
+    }
+    if( reader->index == &reader->own )
+    {
+        ifq_destroy_index( &reader->own );
+    }
+    free( reader );
+}
+
+/**
+ * Closes the readers and the index of a handle, the handle
+ * must not be in use.
+ *
+ * @param self Pointer to a c_indexed_fastq_t.
+ */
+static void
+close_index(c_indexed_fastq_t *self)
+{
+    if( self->closed )
+    {
+        return;
+    }
+
+    /* The index itself last, the readers share its mapping */
+    int i;
+    for(i = self->num_readers - 1; i >= 0; i--)
+    {
+        destroy_reader( self->readers[ i ] );
+    }
+    free( self->readers );
+    self->readers = NULL;
+    self->num_readers = 0;
+    ifq_destroy_index( &self->index );
+    self->closed = 1;
+}
+
 /**
  * Deallocates a Python CIndexedFastq object.
  * 
@@ -22,13 +188,163 @@ typedef struct
 void
 c_indexed_fastq_dealloc(c_indexed_fastq_t *self)
 {
-    if( self->record != NULL )
+    close_index( self );
+    pthread_mutex_destroy( &self->mutex );
+    pthread_cond_destroy( &self->idle );
+    Py_TYPE( self )->tp_free( ( PyObject * ) self );
+}
+
+/**
+ * Returns an idle reader. Called with the mutex held.
+ *
+ * @return An idle reader, or NULL if there is none.
+ */
+static reader_t *
+idle_reader(c_indexed_fastq_t *cifq)
+{
+    int i;
+    for(i = 0; i < cifq->num_readers; i++)
+    {
+        if( !cifq->readers[ i ]->busy )
+        {
+            return cifq->readers[ i ];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Takes a reader of a handle, the GIL is released while waiting
+ * for one. When all readers are busy another one is opened, outside
+ * the mutex so that the other threads keep querying meanwhile.
+ *
+ * @param cifq The handle.
+ *
+ * @return The reader, or NULL with an exception set if the index
+ *         is closed or no reader could be opened.
+ */
+static reader_t *
+acquire_reader(c_indexed_fastq_t *cifq)
+{
+    reader_t *reader = NULL;
+    int error = 0;
+
+    Py_BEGIN_ALLOW_THREADS
+    pthread_mutex_lock( &cifq->mutex );
+    while( !cifq->closed )
+    {
+        if( !cifq->exclusive )
+        {
+            reader = idle_reader( cifq );
+            if( reader != NULL )
+            {
+                reader->busy = 1;
+                cifq->num_busy++;
+                break;
+            }
+
+            /* Reserve a slot, the reservation counts as busy so that
+             * the index is not closed or changed while it is opened.
+             * After a failed open the thread waits for a busy reader,
+             * and gives up if there is none */
+            if( error == 0 && cifq->num_readers + cifq->num_opening < MAX_READERS )
+            {
+                cifq->num_opening++;
+                cifq->num_busy++;
+                pthread_mutex_unlock( &cifq->mutex );
+                reader = new_reader( &cifq->index, 1, &error );
+                pthread_mutex_lock( &cifq->mutex );
+                cifq->num_opening--;
+                if( reader != NULL )
+                {
+                    reader->busy = 1;
+                    cifq->readers[ cifq->num_readers++ ] = reader;
+                    break;
+                }
+                cifq->num_busy--;
+                pthread_cond_broadcast( &cifq->idle );
+                continue;
+            }
+            if( error != 0 && cifq->num_busy == 0 )
+            {
+                break;
+            }
+        }
+        pthread_cond_wait( &cifq->idle, &cifq->mutex );
+    }
+    pthread_mutex_unlock( &cifq->mutex );
+    Py_END_ALLOW_THREADS
+
+    if( reader == NULL )
+    {
+        if( error == ENOMEM )
+        {
+            PyErr_NoMemory( );
+        }
+        else if( error != 0 )
+        {
+            errno = error;
+            PyErr_SetFromErrnoWithFilename( PyExc_IOError, cifq->index.fastq_path );
+        }
+        else
+        {
+            PyErr_SetString( PyExc_ValueError, "The index is closed." );
+        }
+    }
+
+    return reader;
+}
+
+static void
+release_reader(c_indexed_fastq_t *cifq, reader_t *reader)
+{
+    pthread_mutex_lock( &cifq->mutex );
+    reader->busy = 0;
+    cifq->num_busy--;
+    pthread_cond_broadcast( &cifq->idle );
+    pthread_mutex_unlock( &cifq->mutex );
+}
+
+static void
+unlock_all(c_indexed_fastq_t *cifq)
+{
+    pthread_mutex_lock( &cifq->mutex );
+    cifq->exclusive = 0;
+    pthread_cond_broadcast( &cifq->idle );
+    pthread_mutex_unlock( &cifq->mutex );
+}
+
+/**
+ * Waits until no reader of a handle is in use and keeps them
+ * from being handed out, for operations on all readers.
+ *
+ * @param cifq The handle.
+ *
+ * @return 1 if the index is open, otherwise 0 with an exception
+ *         set and the readers released.
+ */
+static int
+lock_all(c_indexed_fastq_t *cifq)
+{
+    Py_BEGIN_ALLOW_THREADS
+    pthread_mutex_lock( &cifq->mutex );
+    while( cifq->exclusive || cifq->num_busy > 0 )
+    {
+        pthread_cond_wait( &cifq->idle, &cifq->mutex );
+    }
+    cifq->exclusive = 1;
+    pthread_mutex_unlock( &cifq->mutex );
+    Py_END_ALLOW_THREADS
+
+    if( cifq->closed )
     {
-        ifq_destroy_record( self->record );
-        ifq_destroy_index( &self->index );
-        self->record = NULL;
-        Py_TYPE( self )->tp_free( ( PyObject * ) self );
+        unlock_all( cifq );
+        PyErr_SetString( PyExc_ValueError, "The index is closed." );
+        return 0;
     }
+
+    return 1;
 }
 
 #if PY_MAJOR_VERSION >= 3
@@ -94,166 +410,1376 @@ static PyTypeObject c_indexed_fastq_prototype =
 
 #endif
 
-c_indexed_fastq_t * open_index(char *fastq_path, char *index_prefix)
+/**
+ * Fields of a record, in the order they are stored.
+ */
+#define FIELD_NAME 0
+#define FIELD_SEQUENCE 1
+#define FIELD_QUALITY 2
+#define NUM_FIELDS 3
+
+/**
+ * A record returned by the queries. The accession, sequence and
+ * quality are copied into the object itself, each followed by a
+ * null, and only become Python objects when they are accessed.
+ */
+typedef struct
 {
-    ifq_index_t index;
-    c_indexed_fastq_t *cifq;
-    ifq_codes_t status = ifq_open_index( fastq_path, index_prefix, &index );
-    if( status != IFQ_OK )
-    {
-        if( status == IFQ_BAD_FASTQ )
-        {
-            PyErr_SetString( PyExc_IOError, "Error while opening fastq file." );
-        }
-        else if( status == IFQ_BAD_PREFIX )
-        {
-            PyErr_SetString( PyExc_IOError, "Error while opening index files." );
-        }
-        else
-        {
-            PyErr_SetString( PyExc_IOError, "Unknown error while reading the index." );
-        }
+    PyObject_VAR_HEAD
 
-        return NULL;
-    }
-    
-    cifq = (c_indexed_fastq_t *) c_indexed_fastq_prototype.tp_alloc( &c_indexed_fastq_prototype, 0 );
-    cifq->index = index;
-    cifq->record = ifq_new_record( );
+    /**
+     * Offset of each field in data.
+     */
+    Py_ssize_t offsets[ NUM_FIELDS ];
 
-    return cifq;
-}
+    /**
+     * Length of each field, without the null.
+     */
+    Py_ssize_t lengths[ NUM_FIELDS ];
 
-static PyObject *py_create_indexed_fastq(PyObject *self, PyObject *args)
+    char data[ 1 ];
+} fastq_record_t;
+
+static PyTypeObject fastq_record_prototype =
 {
-    char *fastq_path;
-    char *index_prefix;
+    PyVarObject_HEAD_INIT( NULL, 0 )
+    "indexedfastq.FastqRecord", /* tp_name */
+    sizeof( fastq_record_t ),   /* tp_basicsize */
+    1,                          /* tp_itemsize */
+};
 
-    if( !PyArg_ParseTuple( args, "ss", &fastq_path, &index_prefix ) )
+/**
+ * Creates a record from its fields.
+ *
+ * @param fields The accession, sequence and quality.
+ * @param lengths Length of each field.
+ *
+ * @return A new FastqRecord, or NULL if out of memory.
+ */
+static PyObject *new_fastq_record(const char **fields, const Py_ssize_t *lengths)
+{
+    Py_ssize_t size = lengths[ FIELD_NAME ] + lengths[ FIELD_SEQUENCE ] + lengths[ FIELD_QUALITY ] + NUM_FIELDS;
+    fastq_record_t *record = PyObject_NewVar( fastq_record_t, &fastq_record_prototype, size );
+    if( record == NULL )
     {
         return NULL;
     }
-    
-    ifq_codes_t status = ifq_create_index( fastq_path, index_prefix );
-    if( status != IFQ_OK )
+
+    Py_ssize_t offset = 0;
+    int field;
+    for(field = 0; field < NUM_FIELDS; field++)
     {
-        if( status == IFQ_BAD_FASTQ )
-        {
-            PyErr_SetString( PyExc_IOError, "Error while opening fastq file." );
-        }
-        else if( status == IFQ_BAD_PREFIX )
-        {
-            PyErr_SetString( PyExc_IOError, "Error while opening index files." );
-        }
-        else
-        {
-            PyErr_SetString( PyExc_IOError, "Error while creating the index." );
-        }
-        return NULL;
+        record->offsets[ field ] = offset;
+        record->lengths[ field ] = lengths[ field ];
+        memcpy( record->data + offset, fields[ field ], lengths[ field ] );
+        record->data[ offset + lengths[ field ] ] = '\0';
+        offset += lengths[ field ] + 1;
     }
 
-    return (PyObject *) open_index( fastq_path, index_prefix );
+    return (PyObject *) record;
 }
 
-static PyObject *py_open_indexed_fastq(PyObject *self, PyObject *args)
+/**
+ * Creates a FastqRecord from a record read by the library.
+ */
+static PyObject *record_from_ifq(const ifq_record_t *record)
 {
-    char *fastq_path;
-    char *index_prefix;
-
-    if( !PyArg_ParseTuple( args, "ss", &fastq_path, &index_prefix ) )
+    const char *fields[ NUM_FIELDS ] = { record->name, record->sequence, record->quality };
+    Py_ssize_t lengths[ NUM_FIELDS ];
+    int field;
+    for(field = 0; field < NUM_FIELDS; field++)
     {
-        return NULL;
+        lengths[ field ] = (Py_ssize_t) strlen( fields[ field ] );
     }
 
-    return (PyObject *) open_index( fastq_path, index_prefix );
+    return new_fastq_record( fields, lengths );
 }
 
-static PyObject *py_query_indexed_fastq(PyObject *self, PyObject *args)
+static PyObject *fastq_record_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
 {
-    char *query;
-    c_indexed_fastq_t *cifq;
+    static char *keywords[] = { "name", "sequence", "quality", NULL };
+    const char *fields[ NUM_FIELDS ];
+    Py_ssize_t lengths[ NUM_FIELDS ];
 
-    if( !PyArg_ParseTuple( args, "O!s", &c_indexed_fastq_prototype, &cifq, &query ) )
+    if( !PyArg_ParseTupleAndKeywords( args, kwds, "s#s#s#", keywords, &fields[ FIELD_NAME ], &lengths[ FIELD_NAME ],
+                                      &fields[ FIELD_SEQUENCE ], &lengths[ FIELD_SEQUENCE ],
+                                      &fields[ FIELD_QUALITY ], &lengths[ FIELD_QUALITY ] ) )
     {
         return NULL;
     }
 
-    if( ifq_query_index( &cifq->index, query, cifq->record ) == IFQ_OK )
-    {
-        return Py_BuildValue( "sss", cifq->record->name, cifq->record->sequence, cifq->record->quality );
-    }
-    else
-    {
-        return Py_BuildValue( "sss", NULL, NULL, NULL );
-    }
+    return new_fastq_record( fields, lengths );
 }
 
-static PyObject *py_close_indexed_fastq(PyObject *self, PyObject *args)
-{ 
-    c_indexed_fastq_t *cifq;
+/**
+ * Returns a field as a string, decoded on every access.
+ */
+static PyObject *fastq_record_get_str(fastq_record_t *self, void *closure)
+{
+    int field = (int) (intptr_t) closure;
+#if PY_MAJOR_VERSION >= 3
+    return PyUnicode_DecodeUTF8( self->data + self->offsets[ field ], self->lengths[ field ], NULL );
+#else
+    return PyString_FromStringAndSize( self->data + self->offsets[ field ], self->lengths[ field ] );
+#endif
+}
 
-    if( !PyArg_ParseTuple( args, "O!", &c_indexed_fastq_prototype, &cifq ) )
+/**
+ * Returns a copy of a field as bytes, without decoding it.
+ */
+static PyObject *fastq_record_get_bytes(fastq_record_t *self, void *closure)
+{
+    int field = (int) (intptr_t) closure;
+    return PyBytes_FromStringAndSize( self->data + self->offsets[ field ], self->lengths[ field ] );
+}
+
+#if PY_MAJOR_VERSION >= 3
+
+/**
+ * Returns a read-only memoryview of a field, that keeps the
+ * record alive and copies nothing.
+ */
+static PyObject *fastq_record_get_view(fastq_record_t *self, void *closure)
+{
+    int field = (int) (intptr_t) closure;
+    PyObject *view = PyMemoryView_FromObject( (PyObject *) self );
+    if( view == NULL )
     {
         return NULL;
     }
 
-    ifq_destroy_record( cifq->record );
-    ifq_destroy_index( &cifq->index );
-    cifq->record = NULL;
+    PyObject *slice = PySequence_GetSlice( view, self->offsets[ field ], self->offsets[ field ] + self->lengths[ field ] );
+    Py_DECREF( view );
 
-    Py_RETURN_NONE;
+    return slice;
 }
 
-static PyMethodDef module_methods[] = {
-    { "create_indexed_fastq", py_create_indexed_fastq, METH_VARARGS, "Create an index and return it." },
-    { "open_indexed_fastq", py_open_indexed_fastq, METH_VARARGS, "Open an already indexed file." },
-    { "query_indexed_fastq", py_query_indexed_fastq, METH_VARARGS, "Query and indexed fastq." },
-    { "close_indexed_fastq", py_close_indexed_fastq, METH_VARARGS, "Close an opened index." },
-    { NULL, NULL, 0, NULL }
-};
-
-#if PY_MAJOR_VERSION  >= 3
+/**
+ * Exports the fields, each followed by a null, as a read-only
+ * buffer of bytes.
+ */
+static int fastq_record_get_buffer(fastq_record_t *self, Py_buffer *view, int flags)
+{
+    return PyBuffer_FillInfo( view, (PyObject *) self, self->data, Py_SIZE( self ), 1, flags );
+}
 
-static PyModuleDef moduledef = {
-    PyModuleDef_HEAD_INIT,
-    "cindexedfastq",
-    "Wrapper module for the cindexedfastq methods.",
-    -1,
-    module_methods,
-    NULL,
-    NULL,
-    NULL,
+static PyBufferProcs fastq_record_buffer = {
+    (getbufferproc) fastq_record_get_buffer,
     NULL
 };
 
-PyMODINIT_FUNC
-PyInit_cindexedfastq(void)
-{
-    PyObject *module;
-    
-    c_indexed_fastq_prototype.tp_new = PyType_GenericNew;
-    if( PyType_Ready( &c_indexed_fastq_prototype ) < 0 )
-    {
-        return NULL;
-    }
-
-    module = PyModule_Create( &moduledef );
-    
-    Py_INCREF( &c_indexed_fastq_prototype );
-    PyModule_AddObject( module, "CIndexedFastq", (PyObject *) &c_indexed_fastq_prototype );
+#endif
 
-    return module;
+static PyObject *fastq_record_str(fastq_record_t *self)
+{
+    const char *format = "@%s\n%s\n+\n%s\n";
+#if PY_MAJOR_VERSION >= 3
+    return PyUnicode_FromFormat( format,
+#else
+    return PyString_FromFormat( format,
+#endif
+                                 self->data + self->offsets[ FIELD_NAME ], self->data + self->offsets[ FIELD_SEQUENCE ],
+                                 self->data + self->offsets[ FIELD_QUALITY ] );
 }
 
+static PyObject *fastq_record_repr(fastq_record_t *self)
+{
+    const char *format = "(@%s,%s,+,%s)";
+#if PY_MAJOR_VERSION >= 3
+    return PyUnicode_FromFormat( format,
 #else
+    return PyString_FromFormat( format,
+#endif
+                                 self->data + self->offsets[ FIELD_NAME ], self->data + self->offsets[ FIELD_SEQUENCE ],
+                                 self->data + self->offsets[ FIELD_QUALITY ] );
+}
 
-PyMODINIT_FUNC
-initcindexedfastq(void)
+static PyGetSetDef fastq_record_getset[] = {
+    { "name", (getter) fastq_record_get_str, NULL, "The accession.", (void *) FIELD_NAME },
+    { "sequence", (getter) fastq_record_get_str, NULL, "The sequence.", (void *) FIELD_SEQUENCE },
+    { "quality", (getter) fastq_record_get_str, NULL, "The quality values.", (void *) FIELD_QUALITY },
+    { "name_bytes", (getter) fastq_record_get_bytes, NULL, "The accession as bytes.", (void *) FIELD_NAME },
+    { "sequence_bytes", (getter) fastq_record_get_bytes, NULL, "The sequence as bytes.", (void *) FIELD_SEQUENCE },
+    { "quality_bytes", (getter) fastq_record_get_bytes, NULL, "The quality values as bytes.", (void *) FIELD_QUALITY },
+#if PY_MAJOR_VERSION >= 3
+    { "name_view", (getter) fastq_record_get_view, NULL, "A memoryview of the accession.", (void *) FIELD_NAME },
+    { "sequence_view", (getter) fastq_record_get_view, NULL, "A memoryview of the sequence.", (void *) FIELD_SEQUENCE },
+    { "quality_view", (getter) fastq_record_get_view, NULL, "A memoryview of the quality values.", (void *) FIELD_QUALITY },
+#endif
+    { NULL, NULL, NULL, NULL, NULL }
+};
+
+/**
+ * Fills in the slots of the FastqRecord type that are not set
+ * above, before it is readied.
+ */
+static void init_fastq_record_type(void)
 {
-    PyObject *module;
+    fastq_record_prototype.tp_flags = Py_TPFLAGS_DEFAULT;
+    fastq_record_prototype.tp_doc = "A fastq record, FastqRecord( name, sequence, quality ).";
+    fastq_record_prototype.tp_new = fastq_record_new;
+    fastq_record_prototype.tp_str = (reprfunc) fastq_record_str;
+    fastq_record_prototype.tp_repr = (reprfunc) fastq_record_repr;
+    fastq_record_prototype.tp_getset = fastq_record_getset;
+#if PY_MAJOR_VERSION >= 3
+    fastq_record_prototype.tp_as_buffer = &fastq_record_buffer;
+#endif
+}
 
-    c_indexed_fastq_prototype.tp_new = PyType_GenericNew;
-    if( PyType_Ready( &c_indexed_fastq_prototype ) < 0 )
+#if PY_MAJOR_VERSION >= 3
+
+/**
+ * A one dimensional array that is exported through the buffer
+ * protocol, for the output of extract_indexed_fastq.
+ */
+typedef struct
+{
+    PyObject_HEAD
+
+    /**
+     * The items, freed with the buffer.
+     */
+    char *data;
+
+    /**
+     * Number of items, the only dimension of the array.
+     */
+    Py_ssize_t length;
+
+    /**
+     * Size of each item in bytes, also the stride.
+     */
+    Py_ssize_t itemsize;
+
+    /**
+     * struct module format of the items.
+     */
+    char *format;
+} buffer_t;
+
+static PyTypeObject buffer_prototype =
+{
+    PyVarObject_HEAD_INIT( NULL, 0 )
+    "indexedfastq.Buffer",      /* tp_name */
+    sizeof( buffer_t ),         /* tp_basicsize */
+    0,                          /* tp_itemsize */
+};
+
+/**
+ * Creates a buffer that takes ownership of data.
+ *
+ * @param data Memory from malloc, freed with the buffer or on error.
+ * @param length Number of items.
+ * @param itemsize Size of each item.
+ * @param format Format of the items, a static string.
+ *
+ * @return A new Buffer, or NULL if out of memory.
+ */
+static buffer_t *new_buffer(char *data, Py_ssize_t length, Py_ssize_t itemsize, char *format)
+{
+    buffer_t *buffer = PyObject_New( buffer_t, &buffer_prototype );
+    if( buffer == NULL )
+    {
+        free( data );
+        return NULL;
+    }
+    buffer->data = data;
+    buffer->length = length;
+    buffer->itemsize = itemsize;
+    buffer->format = format;
+
+    return buffer;
+}
+
+static void buffer_dealloc(buffer_t *self)
+{
+    free( self->data );
+    Py_TYPE( self )->tp_free( (PyObject *) self );
+}
+
+static int buffer_get_buffer(buffer_t *self, Py_buffer *view, int flags)
+{
+    view->obj = (PyObject *) self;
+    view->buf = self->data;
+    view->len = self->length * self->itemsize;
+    view->readonly = 0;
+    view->itemsize = self->itemsize;
+    view->format = ( flags & PyBUF_FORMAT ) ? self->format : NULL;
+    view->ndim = 1;
+    view->shape = ( flags & PyBUF_ND ) ? &self->length : NULL;
+    view->strides = ( flags & PyBUF_STRIDES ) ? &self->itemsize : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    Py_INCREF( self );
+
+    return 0;
+}
+
+static Py_ssize_t buffer_length(buffer_t *self)
+{
+    return self->length;
+}
+
+static PyObject *buffer_item(buffer_t *self, Py_ssize_t i)
+{
+    if( i < 0 || i >= self->length )
+    {
+        PyErr_SetString( PyExc_IndexError, "Buffer index out of range." );
+        return NULL;
+    }
+
+    if( self->itemsize == sizeof( int64_t ) )
+    {
+        return PyLong_FromLongLong( ( (int64_t *) self->data )[ i ] );
+    }
+
+    return PyLong_FromLong( ( (unsigned char *) self->data )[ i ] );
+}
+
+static PyBufferProcs buffer_procs = {
+    (getbufferproc) buffer_get_buffer,
+    NULL
+};
+
+static PySequenceMethods buffer_sequence = {
+    (lenfunc) buffer_length,
+    NULL,
+    NULL,
+    (ssizeargfunc) buffer_item
+};
+
+static void init_buffer_type(void)
+{
+    buffer_prototype.tp_flags = Py_TPFLAGS_DEFAULT;
+    buffer_prototype.tp_doc = "A one dimensional array of the fields or offsets of an extraction.";
+    buffer_prototype.tp_dealloc = (destructor) buffer_dealloc;
+    buffer_prototype.tp_as_buffer = &buffer_procs;
+    buffer_prototype.tp_as_sequence = &buffer_sequence;
+}
+
+#endif
+
+c_indexed_fastq_t * open_index(char *fastq_path, char *index_prefix, int flags)
+{
+    ifq_index_t index;
+    c_indexed_fastq_t *cifq;
+    ifq_codes_t status;
+    Py_BEGIN_ALLOW_THREADS
+    status = ifq_open_index_with_flags( fastq_path, index_prefix, flags, &index );
+    Py_END_ALLOW_THREADS
+    if( status != IFQ_OK )
+    {
+        if( status == IFQ_BAD_FASTQ )
+        {
+            PyErr_SetString( PyExc_IOError, "Error while opening fastq file." );
+        }
+        else if( status == IFQ_BAD_PREFIX )
+        {
+            PyErr_SetString( PyExc_IOError, "Error while opening index files." );
+        }
+        else if( status == IFQ_BAD_LOCK )
+        {
+            PyErr_SetString( PyExc_IOError, "Error while locking the index in memory." );
+        }
+        else if( status == IFQ_BAD_INDEX )
+        {
+            PyErr_SetString( PyExc_IOError, "The index file is corrupt or has an unsupported version." );
+        }
+        else
+        {
+            PyErr_SetString( PyExc_IOError, "Unknown error while reading the index." );
+        }
+
+        return NULL;
+    }
+    
+    cifq = (c_indexed_fastq_t *) c_indexed_fastq_prototype.tp_alloc( &c_indexed_fastq_prototype, 0 );
+    if( cifq == NULL )
+    {
+        ifq_destroy_index( &index );
+        return NULL;
+    }
+    pthread_mutex_init( &cifq->mutex, NULL );
+    pthread_cond_init( &cifq->idle, NULL );
+    cifq->index = index;
+    cifq->readers = (reader_t **) calloc( MAX_READERS, sizeof( reader_t * ) );
+    int error;
+    if( cifq->readers == NULL || ( cifq->readers[ 0 ] = new_reader( &cifq->index, 0, &error ) ) == NULL )
+    {
+        Py_DECREF( cifq );
+        return (c_indexed_fastq_t *) PyErr_NoMemory( );
+    }
+    cifq->num_readers = 1;
+
+    return cifq;
+}
+
+/**
+ * A Python callable that receives the events of an index build,
+ * and whether it has raised an exception.
+ */
+typedef struct
+{
+    PyObject *progress;
+    int failed;
+} build_progress_t;
+
+/**
+ * Calls the progress callable with the name of the event, a dict
+ * with the measurements of the phase, and the progress. After an
+ * exception it is not called again, and the exception is raised
+ * when the build is done. The build runs without the GIL, it is
+ * taken for the call.
+ */
+static void report_build(void *data, ifq_build_event_t event, const ifq_build_phase_t *phase, uint64_t done, uint64_t total)
+{
+    static const char *event_names[] = { "start", "end", "progress" };
+    build_progress_t *progress = (build_progress_t *) data;
+    if( progress->failed )
+    {
+        return;
+    }
+
+    PyGILState_STATE state = PyGILState_Ensure( );
+
+    PyObject *result = PyObject_CallFunction( progress->progress, "s{s:s,s:I,s:d,s:d,s:K,s:K}KK", event_names[ event ],
+                                              "name", phase->name,
+                                              "runs", (unsigned int) phase->runs,
+                                              "wall_seconds", phase->wall_seconds,
+                                              "cpu_seconds", phase->cpu_seconds,
+                                              "peak_rss_kb", (unsigned long long) phase->peak_rss_kb,
+                                              "bytes_decompressed", (unsigned long long) phase->bytes_decompressed,
+                                              (unsigned long long) done, (unsigned long long) total );
+    if( result == NULL )
+    {
+        progress->failed = 1;
+    }
+    Py_XDECREF( result );
+    PyGILState_Release( state );
+}
+
+static PyObject *py_create_indexed_fastq(PyObject *self, PyObject *args)
+{
+    char *fastq_path;
+    char *index_prefix;
+    char *algorithm = NULL;
+    char *hash = NULL;
+    PyObject *progress_callable = Py_None;
+    build_progress_t progress = { NULL, 0 };
+    ifq_options_t options;
+    ifq_default_options( &options );
+
+    if( !PyArg_ParseTuple( args, "ss|zIIdzzO", &fastq_path, &index_prefix, &algorithm, &options.b, &options.keys_per_bin,
+                           &options.graph_size, &hash, &options.profile_path, &progress_callable ) )
+    {
+        return NULL;
+    }
+
+    if( progress_callable != Py_None )
+    {
+        if( !PyCallable_Check( progress_callable ) )
+        {
+            PyErr_SetString( PyExc_TypeError, "The progress must be callable." );
+            return NULL;
+        }
+        progress.progress = progress_callable;
+        options.callback = report_build;
+        options.callback_data = &progress;
+    }
+
+    if( algorithm != NULL )
+    {
+        options.algorithm = ifq_parse_algorithm( algorithm );
+        if( options.algorithm == CMPH_COUNT )
+        {
+            PyErr_SetString( PyExc_ValueError, "Unknown hash algorithm." );
+            return NULL;
+        }
+        if( options.algorithm == CMPH_BMZ8 )
+        {
+            PyErr_SetString( PyExc_ValueError, "The bmz8 algorithm holds at most 256 records, use bmz instead." );
+            return NULL;
+        }
+    }
+
+    if( hash != NULL )
+    {
+        options.hash = ifq_parse_hash( hash );
+        if( options.hash == CMPH_HASH_COUNT )
+        {
+            PyErr_SetString( PyExc_ValueError, "Unknown hash function." );
+            return NULL;
+        }
+    }
+    
+    ifq_codes_t status;
+    Py_BEGIN_ALLOW_THREADS
+    status = ifq_create_index_with_options( fastq_path, index_prefix, &options );
+    Py_END_ALLOW_THREADS
+    if( progress.failed )
+    {
+        return NULL;
+    }
+    if( status != IFQ_OK )
+    {
+        if( status == IFQ_BAD_FASTQ )
+        {
+            PyErr_SetString( PyExc_IOError, "Error while opening fastq file." );
+        }
+        else if( status == IFQ_BAD_PREFIX )
+        {
+            PyErr_SetString( PyExc_IOError, "Error while opening index files." );
+        }
+        else if( status == IFQ_BAD_HASH )
+        {
+            PyErr_SetString( PyExc_IOError, "The hash function could not be built with these options." );
+        }
+        else
+        {
+            PyErr_SetString( PyExc_IOError, "Error while creating the index." );
+        }
+        return NULL;
+    }
+
+    return (PyObject *) open_index( fastq_path, index_prefix, IFQ_OPEN_DEFAULT );
+}
+
+static PyObject *py_open_indexed_fastq(PyObject *self, PyObject *args)
+{
+    char *fastq_path;
+    char *index_prefix;
+    int flags = IFQ_OPEN_DEFAULT;
+
+    if( !PyArg_ParseTuple( args, "ss|i", &fastq_path, &index_prefix, &flags ) )
+    {
+        return NULL;
+    }
+
+    return (PyObject *) open_index( fastq_path, index_prefix, flags );
+}
+
+static PyObject *py_query_indexed_fastq(PyObject *self, PyObject *args)
+{
+    char *query;
+    c_indexed_fastq_t *cifq;
+
+    if( !PyArg_ParseTuple( args, "O!s", &c_indexed_fastq_prototype, &cifq, &query ) )
+    {
+        return NULL;
+    }
+
+    reader_t *reader = acquire_reader( cifq );
+    if( reader == NULL )
+    {
+        return NULL;
+    }
+
+    ifq_codes_t status;
+    Py_BEGIN_ALLOW_THREADS
+    status = ifq_query_index( reader->index, query, reader->record );
+    Py_END_ALLOW_THREADS
+
+    PyObject *record;
+    if( status == IFQ_OK )
+    {
+        record = record_from_ifq( reader->record );
+    }
+    else
+    {
+        Py_INCREF( Py_None );
+        record = Py_None;
+    }
+    release_reader( cifq, reader );
+
+    return record;
+}
+
+/**
+ * Returns the string contents of a query object.
+ *
+ * @param query A Python string.
+ *
+ * @return The contents of the string, or NULL if it is not a string.
+ */
+static char *query_string(PyObject *query)
+{
+#if PY_MAJOR_VERSION >= 3
+    if( PyUnicode_Check( query ) )
+    {
+        return (char *) PyUnicode_AsUTF8( query );
+    }
+    else if( PyBytes_Check( query ) )
+    {
+        return PyBytes_AsString( query );
+    }
+#else
+    if( PyString_Check( query ) )
+    {
+        return PyString_AsString( query );
+    }
+#endif
+
+    PyErr_SetString( PyExc_TypeError, "Queries must be strings." );
+    return NULL;
+}
+
+/**
+ * Returns the contents of every string of a tuple, they are valid
+ * as long as the tuple is, also while the GIL is released.
+ *
+ * @param queries A tuple of Python strings.
+ *
+ * @return The strings, free them with free, or NULL on error.
+ */
+static char **query_strings_of(PyObject *queries)
+{
+    Py_ssize_t num_queries = PyTuple_GET_SIZE( queries );
+    char **query_strings = (char **) malloc( sizeof( char * ) * ( num_queries + 1 ) );
+    if( query_strings == NULL )
+    {
+        PyErr_NoMemory( );
+        return NULL;
+    }
+
+    Py_ssize_t i;
+    for(i = 0; i < num_queries; i++)
+    {
+        query_strings[ i ] = query_string( PyTuple_GET_ITEM( queries, i ) );
+        if( query_strings[ i ] == NULL )
+        {
+            free( query_strings );
+            return NULL;
+        }
+    }
+
+    return query_strings;
+}
+
+static PyObject *py_prefetch_indexed_fastq(PyObject *self, PyObject *args)
+{
+    PyObject *query_list;
+    c_indexed_fastq_t *cifq;
+
+    if( !PyArg_ParseTuple( args, "O!O", &c_indexed_fastq_prototype, &cifq, &query_list ) )
+    {
+        return NULL;
+    }
+
+    PyObject *queries = PySequence_Tuple( query_list );
+    if( queries == NULL )
+    {
+        return NULL;
+    }
+
+    Py_ssize_t num_queries = PyTuple_GET_SIZE( queries );
+    char **query_strings = query_strings_of( queries );
+    reader_t *reader = query_strings != NULL ? acquire_reader( cifq ) : NULL;
+    if( reader == NULL )
+    {
+        free( query_strings );
+        Py_DECREF( queries );
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    ifq_prefetch( reader->index, query_strings, (size_t) num_queries );
+    Py_END_ALLOW_THREADS
+    release_reader( cifq, reader );
+
+    free( query_strings );
+    Py_DECREF( queries );
+
+    Py_RETURN_NONE;
+}
+
+/**
+ * Allocates the batch records of a reader, if not already done.
+ *
+ * @return 1 if successful, 0 if out of memory.
+ */
+static int ensure_batch(reader_t *reader)
+{
+    if( reader->batch != NULL )
+    {
+        return 1;
+    }
+
+    reader->batch = (ifq_record_t **) calloc( QUERY_BATCH_SIZE, sizeof( ifq_record_t * ) );
+    if( reader->batch == NULL )
+    {
+        return 0;
+    }
+
+    size_t i;
+    for(i = 0; i < QUERY_BATCH_SIZE; i++)
+    {
+        reader->batch[ i ] = ifq_new_record( );
+        if( reader->batch[ i ] == NULL )
+        {
+            /* A partial batch is freed so that the next call tries again */
+            while( i > 0 )
+            {
+                ifq_destroy_record( reader->batch[ --i ] );
+            }
+            free( reader->batch );
+            reader->batch = NULL;
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * Looks up a sequence of accessions with ifq_query_many, in batches
+ * of QUERY_BATCH_SIZE, and returns a list with a FastqRecord for
+ * every accession, or None where it is not found.
+ */
+static PyObject *py_query_many_indexed_fastq(PyObject *self, PyObject *args)
+{
+    PyObject *query_list;
+    c_indexed_fastq_t *cifq;
+    ifq_codes_t results[ QUERY_BATCH_SIZE ];
+
+    if( !PyArg_ParseTuple( args, "O!O", &c_indexed_fastq_prototype, &cifq, &query_list ) )
+    {
+        return NULL;
+    }
+
+    PyObject *queries = PySequence_Tuple( query_list );
+    if( queries == NULL )
+    {
+        return NULL;
+    }
+
+    Py_ssize_t num_queries = PyTuple_GET_SIZE( queries );
+    char **query_strings = query_strings_of( queries );
+    PyObject *records = query_strings != NULL ? PyList_New( num_queries ) : NULL;
+    reader_t *reader = records != NULL ? acquire_reader( cifq ) : NULL;
+    if( reader == NULL )
+    {
+        Py_XDECREF( records );
+        free( query_strings );
+        Py_DECREF( queries );
+        return NULL;
+    }
+
+    if( !ensure_batch( reader ) )
+    {
+        Py_DECREF( records );
+        records = PyErr_NoMemory( );
+        goto cleanup;
+    }
+
+    Py_ssize_t start, count, i;
+    for(start = 0; start < num_queries; start += count)
+    {
+        count = num_queries - start < QUERY_BATCH_SIZE ? num_queries - start : QUERY_BATCH_SIZE;
+        Py_BEGIN_ALLOW_THREADS
+        ifq_query_many( reader->index, query_strings + start, (size_t) count, reader->batch, results );
+        Py_END_ALLOW_THREADS
+
+        for(i = 0; i < count; i++)
+        {
+            PyObject *record = Py_None;
+            if( results[ i ] == IFQ_OK )
+            {
+                record = record_from_ifq( reader->batch[ i ] );
+                if( record == NULL )
+                {
+                    Py_DECREF( records );
+                    records = NULL;
+                    goto cleanup;
+                }
+            }
+            else
+            {
+                Py_INCREF( Py_None );
+            }
+            PyList_SET_ITEM( records, start + i, record );
+        }
+    }
+
+cleanup:
+    release_reader( cifq, reader );
+    free( query_strings );
+    Py_DECREF( queries );
+
+    return records;
+}
+
+#if PY_MAJOR_VERSION >= 3
+
+/**
+ * Looks up accessions in batches and copies one field of each
+ * record to the end of data, runs without the GIL.
+ *
+ * @param reader A reader of the handle, with its batch records.
+ * @param queries The accessions.
+ * @param num_queries Number of accessions.
+ * @param field The field to copy, FIELD_NAME, FIELD_SEQUENCE or FIELD_QUALITY.
+ * @param data The output, grown with realloc if grow is set.
+ * @param capacity Size of data in bytes.
+ * @param grow Whether data may be reallocated.
+ * @param offsets Output, field i is copied to data[ offsets[ i ], offsets[ i + 1 ] ).
+ *
+ * @return The number of accessions extracted, fewer than num_queries if
+ *         data is full and can not grow, or -1 if out of memory.
+ */
+static Py_ssize_t extract_fields(reader_t *reader, char **queries, Py_ssize_t num_queries, int field,
+                                 char **data, Py_ssize_t *capacity, int grow, int64_t *offsets)
+{
+    ifq_codes_t results[ QUERY_BATCH_SIZE ];
+    Py_ssize_t start, count, i, length = 0;
+
+    offsets[ 0 ] = 0;
+    for(start = 0; start < num_queries; start += count)
+    {
+        count = num_queries - start < QUERY_BATCH_SIZE ? num_queries - start : QUERY_BATCH_SIZE;
+        ifq_query_many( reader->index, queries + start, (size_t) count, reader->batch, results );
+
+        for(i = 0; i < count; i++)
+        {
+            const char *value = "";
+            if( results[ i ] == IFQ_OK )
+            {
+                ifq_record_t *record = reader->batch[ i ];
+                value = field == FIELD_NAME ? record->name : field == FIELD_SEQUENCE ? record->sequence : record->quality;
+            }
+
+            Py_ssize_t value_length = (Py_ssize_t) strlen( value );
+            if( length + value_length > *capacity )
+            {
+                if( !grow )
+                {
+                    return start + i;
+                }
+
+                Py_ssize_t new_capacity = 2 * *capacity > length + value_length ? 2 * *capacity : length + value_length;
+                char *new_data = (char *) realloc( *data, new_capacity );
+                if( new_data == NULL )
+                {
+                    return -1;
+                }
+                *data = new_data;
+                *capacity = new_capacity;
+            }
+
+            memcpy( *data + length, value, value_length );
+            length += value_length;
+            offsets[ start + i + 1 ] = length;
+        }
+    }
+
+    return num_queries;
+}
+
+/**
+ * Extracts one field of the records of many accessions into a
+ * contiguous buffer, see IndexedFastq.extract.
+ */
+static PyObject *py_extract_indexed_fastq(PyObject *self, PyObject *args)
+{
+    static const char *field_names[] = { "name", "sequence", "quality" };
+    PyObject *query_list;
+    c_indexed_fastq_t *cifq;
+    char *field_name;
+    PyObject *out = Py_None;
+    PyObject *result = NULL;
+    Py_buffer out_view;
+    int field;
+
+    if( !PyArg_ParseTuple( args, "O!Os|O", &c_indexed_fastq_prototype, &cifq, &query_list, &field_name, &out ) )
+    {
+        return NULL;
+    }
+
+    for(field = 0; field < NUM_FIELDS && strcmp( field_name, field_names[ field ] ) != 0; field++);
+    if( field == NUM_FIELDS )
+    {
+        PyErr_SetString( PyExc_ValueError, "The field must be name, sequence or quality." );
+        return NULL;
+    }
+
+    if( out != Py_None && PyObject_GetBuffer( out, &out_view, PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS ) != 0 )
+    {
+        return NULL;
+    }
+
+    PyObject *queries = PySequence_Tuple( query_list );
+    char **query_strings = queries != NULL ? query_strings_of( queries ) : NULL;
+    if( query_strings == NULL )
+    {
+        goto cleanup;
+    }
+
+    Py_ssize_t num_queries = PyTuple_GET_SIZE( queries );
+    int64_t *offsets = (int64_t *) malloc( sizeof( int64_t ) * ( num_queries + 1 ) );
+
+    /* Reads are a few hundred bytes, the buffer grows if they are longer */
+    Py_ssize_t capacity = out != Py_None ? out_view.len : 256 * num_queries + 1;
+    char *data = out != Py_None ? (char *) out_view.buf : (char *) malloc( capacity );
+    if( offsets == NULL || data == NULL )
+    {
+        free( offsets );
+        if( out == Py_None )
+        {
+            free( data );
+        }
+        PyErr_NoMemory( );
+        goto cleanup;
+    }
+
+    reader_t *reader = acquire_reader( cifq );
+    if( reader == NULL )
+    {
+        free( offsets );
+        if( out == Py_None )
+        {
+            free( data );
+        }
+        goto cleanup;
+    }
+
+    Py_ssize_t num_done = -1;
+    if( ensure_batch( reader ) )
+    {
+        Py_BEGIN_ALLOW_THREADS
+        num_done = extract_fields( reader, query_strings, num_queries, field, &data, &capacity, out == Py_None, offsets );
+        Py_END_ALLOW_THREADS
+    }
+    release_reader( cifq, reader );
+
+    if( num_done < 0 )
+    {
+        free( offsets );
+        if( out == Py_None )
+        {
+            free( data );
+        }
+        PyErr_NoMemory( );
+        goto cleanup;
+    }
+
+    PyObject *data_buffer = out;
+    if( out == Py_None )
+    {
+        data_buffer = (PyObject *) new_buffer( data, (Py_ssize_t) offsets[ num_done ], 1, "B" );
+    }
+    else
+    {
+        Py_INCREF( out );
+    }
+    PyObject *offsets_buffer = (PyObject *) new_buffer( (char *) offsets, num_done + 1, sizeof( int64_t ), "q" );
+    if( data_buffer != NULL && offsets_buffer != NULL )
+    {
+        result = PyTuple_Pack( 2, data_buffer, offsets_buffer );
+    }
+    Py_XDECREF( data_buffer );
+    Py_XDECREF( offsets_buffer );
+
+cleanup:
+    free( query_strings );
+    Py_XDECREF( queries );
+    if( out != Py_None )
+    {
+        PyBuffer_Release( &out_view );
+    }
+
+    return result;
+}
+
+#endif
+
+static PyObject *py_stats_indexed_fastq(PyObject *self, PyObject *args)
+{
+    c_indexed_fastq_t *cifq;
+    ifq_stats_t stats;
+
+    if( !PyArg_ParseTuple( args, "O!", &c_indexed_fastq_prototype, &cifq ) )
+    {
+        return NULL;
+    }
+
+    if( !lock_all( cifq ) )
+    {
+        return NULL;
+    }
+
+    /* The counters of all readers, the table is the same for each */
+    ifq_get_stats( &cifq->index, &stats );
+    int r;
+    for(r = 1; r < cifq->num_readers; r++)
+    {
+        ifq_stats_t reader_stats;
+        ifq_get_stats( cifq->readers[ r ]->index, &reader_stats );
+        stats.queries += reader_stats.queries;
+        stats.records_returned += reader_stats.records_returned;
+        stats.not_found += reader_stats.not_found;
+        stats.compressed_bytes_read += reader_stats.compressed_bytes_read;
+        stats.blocks_inflated += reader_stats.blocks_inflated;
+        stats.cache_hits += reader_stats.cache_hits;
+        stats.cache_misses += reader_stats.cache_misses;
+        stats.cache_evictions += reader_stats.cache_evictions;
+    }
+    unlock_all( cifq );
+
+    return Py_BuildValue( "{s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:K}",
+                          "queries", (unsigned long long) stats.queries,
+                          "records_returned", (unsigned long long) stats.records_returned,
+                          "not_found", (unsigned long long) stats.not_found,
+                          "compressed_bytes_read", (unsigned long long) stats.compressed_bytes_read,
+                          "blocks_inflated", (unsigned long long) stats.blocks_inflated,
+                          "cache_hits", (unsigned long long) stats.cache_hits,
+                          "cache_misses", (unsigned long long) stats.cache_misses,
+                          "cache_evictions", (unsigned long long) stats.cache_evictions,
+                          "table_bytes", (unsigned long long) stats.table_bytes,
+                          "table_entries", (unsigned long long) stats.table_entries );
+}
+
+static PyObject *py_reset_stats_indexed_fastq(PyObject *self, PyObject *args)
+{
+    c_indexed_fastq_t *cifq;
+
+    if( !PyArg_ParseTuple( args, "O!", &c_indexed_fastq_prototype, &cifq ) )
+    {
+        return NULL;
+    }
+
+    if( !lock_all( cifq ) )
+    {
+        return NULL;
+    }
+    int r;
+    for(r = 0; r < cifq->num_readers; r++)
+    {
+        ifq_reset_stats( cifq->readers[ r ]->index );
+    }
+    unlock_all( cifq );
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *py_start_trace_indexed_fastq(PyObject *self, PyObject *args)
+{
+    c_indexed_fastq_t *cifq;
+    char *path;
+
+    if( !PyArg_ParseTuple( args, "O!s", &c_indexed_fastq_prototype, &cifq, &path ) )
+    {
+        return NULL;
+    }
+
+    if( !lock_all( cifq ) )
+    {
+        return NULL;
+    }
+
+    /* The readers write to the trace of the index */
+    ifq_codes_t status = ifq_start_trace( &cifq->index, path );
+    int r;
+    for(r = 1; r < cifq->num_readers; r++)
+    {
+        cifq->readers[ r ]->index->trace = cifq->index.trace;
+    }
+    unlock_all( cifq );
+    if( status != IFQ_OK )
+    {
+        PyErr_SetString( PyExc_IOError, "Error while creating the trace file." );
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *py_stop_trace_indexed_fastq(PyObject *self, PyObject *args)
+{
+    c_indexed_fastq_t *cifq;
+
+    if( !PyArg_ParseTuple( args, "O!", &c_indexed_fastq_prototype, &cifq ) )
+    {
+        return NULL;
+    }
+
+    if( !lock_all( cifq ) )
+    {
+        return NULL;
+    }
+    int r;
+    for(r = 1; r < cifq->num_readers; r++)
+    {
+        cifq->readers[ r ]->index->trace = NULL;
+    }
+    ifq_codes_t status = ifq_stop_trace( &cifq->index );
+    unlock_all( cifq );
+    if( status != IFQ_OK )
+    {
+        PyErr_SetString( PyExc_IOError, "Error while writing the trace file." );
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+/**
+ * Converts a histogram into a dict with its count, mean, maximum,
+ * a few percentiles and the (lower_ns, count) of its nonempty buckets.
+ *
+ * @param histogram The histogram.
+ *
+ * @return A new dict, or NULL on error.
+ */
+static PyObject *histogram_dict(const ifq_histogram_t *histogram)
+{
+    PyObject *buckets = PyList_New( 0 );
+    if( buckets == NULL )
+    {
+        return NULL;
+    }
+
+    size_t i;
+    for(i = 0; i < IFQ_HISTOGRAM_BUCKETS; i++)
+    {
+        if( histogram->counts[ i ] == 0 )
+        {
+            continue;
+        }
+
+        PyObject *bucket = Py_BuildValue( "(KK)", (unsigned long long) ifq_histogram_bucket_ns( i ),
+                                          (unsigned long long) histogram->counts[ i ] );
+        if( bucket == NULL || PyList_Append( buckets, bucket ) != 0 )
+        {
+            Py_XDECREF( bucket );
+            Py_DECREF( buckets );
+            return NULL;
+        }
+        Py_DECREF( bucket );
+    }
+
+    double mean = histogram->count > 0 ? (double) histogram->total_ns / (double) histogram->count : 0.0;
+    return Py_BuildValue( "{s:K,s:d,s:K,s:K,s:K,s:K,s:K,s:N}",
+                          "count", (unsigned long long) histogram->count,
+                          "mean_ns", mean,
+                          "max_ns", (unsigned long long) histogram->max_ns,
+                          "p50_ns", (unsigned long long) ifq_histogram_quantile( histogram, 0.5 ),
+                          "p90_ns", (unsigned long long) ifq_histogram_quantile( histogram, 0.9 ),
+                          "p99_ns", (unsigned long long) ifq_histogram_quantile( histogram, 0.99 ),
+                          "p999_ns", (unsigned long long) ifq_histogram_quantile( histogram, 0.999 ),
+                          "buckets", buckets );
+}
+
+static PyObject *py_latency_histograms_indexed_fastq(PyObject *self, PyObject *args)
+{
+    c_indexed_fastq_t *cifq;
+
+    if( !PyArg_ParseTuple( args, "O!", &c_indexed_fastq_prototype, &cifq ) )
+    {
+        return NULL;
+    }
+
+    if( !lock_all( cifq ) )
+    {
+        return NULL;
+    }
+    if( ifq_get_histogram( &cifq->index, IFQ_STAGE_TOTAL ) == NULL )
+    {
+        unlock_all( cifq );
+        Py_RETURN_NONE;
+    }
+
+    /* Sums the histograms of all readers */
+    ifq_histogram_t *merged = (ifq_histogram_t *) malloc( sizeof( ifq_histogram_t ) * IFQ_NUM_STAGES );
+    if( merged == NULL )
+    {
+        unlock_all( cifq );
+        return PyErr_NoMemory( );
+    }
+    int stage, r, b;
+    for(stage = 0; stage < IFQ_NUM_STAGES; stage++)
+    {
+        merged[ stage ] = *ifq_get_histogram( &cifq->index, (ifq_stage_t) stage );
+        for(r = 1; r < cifq->num_readers; r++)
+        {
+            const ifq_histogram_t *h = ifq_get_histogram( cifq->readers[ r ]->index, (ifq_stage_t) stage );
+            if( h == NULL )
+            {
+                continue;
+            }
+            merged[ stage ].count += h->count;
+            merged[ stage ].total_ns += h->total_ns;
+            merged[ stage ].max_ns = h->max_ns > merged[ stage ].max_ns ? h->max_ns : merged[ stage ].max_ns;
+            for(b = 0; b < IFQ_HISTOGRAM_BUCKETS; b++)
+            {
+                merged[ stage ].counts[ b ] += h->counts[ b ];
+            }
+        }
+    }
+    unlock_all( cifq );
+
+    PyObject *stages = PyDict_New( );
+    for(stage = 0; stages != NULL && stage < IFQ_NUM_STAGES; stage++)
+    {
+        PyObject *histogram = histogram_dict( &merged[ stage ] );
+        if( histogram == NULL || PyDict_SetItemString( stages, ifq_stage_name( (ifq_stage_t) stage ), histogram ) != 0 )
+        {
+            Py_CLEAR( stages );
+        }
+        Py_XDECREF( histogram );
+    }
+    free( merged );
+
+    return stages;
+}
+
+static PyObject *py_reset_latency_histograms_indexed_fastq(PyObject *self, PyObject *args)
+{
+    c_indexed_fastq_t *cifq;
+
+    if( !PyArg_ParseTuple( args, "O!", &c_indexed_fastq_prototype, &cifq ) )
+    {
+        return NULL;
+    }
+
+    if( !lock_all( cifq ) )
+    {
+        return NULL;
+    }
+    int r;
+    for(r = 0; r < cifq->num_readers; r++)
+    {
+        ifq_reset_histograms( cifq->readers[ r ]->index );
+    }
+    unlock_all( cifq );
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *py_close_indexed_fastq(PyObject *self, PyObject *args)
+{ 
+    c_indexed_fastq_t *cifq;
+
+    if( !PyArg_ParseTuple( args, "O!", &c_indexed_fastq_prototype, &cifq ) )
+    {
+        return NULL;
+    }
+
+    if( !lock_all( cifq ) )
+    {
+        PyErr_Clear( );
+        Py_RETURN_NONE;
+    }
+    close_index( cifq );
+    unlock_all( cifq );
+
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef module_methods[] = {
+    { "create_indexed_fastq", py_create_indexed_fastq, METH_VARARGS, "Create an index and return it." },
+    { "open_indexed_fastq", py_open_indexed_fastq, METH_VARARGS, "Open an already indexed file, optionally with OPEN_* flags." },
+    { "query_indexed_fastq", py_query_indexed_fastq, METH_VARARGS, "Query and indexed fastq, returns a FastqRecord or None." },
+    { "query_many_indexed_fastq", py_query_many_indexed_fastq, METH_VARARGS, "Query an indexed fastq for a list of accessions at once." },
+#if PY_MAJOR_VERSION >= 3
+    { "extract_indexed_fastq", py_extract_indexed_fastq, METH_VARARGS, "Copy one field of many records into a contiguous buffer." },
+#endif
+    { "prefetch_indexed_fastq", py_prefetch_indexed_fastq, METH_VARARGS, "Hint that the given accessions will be queried soon." },
+    { "stats_indexed_fastq", py_stats_indexed_fastq, METH_VARARGS, "Query, I/O and cache counters of an index." },
+    { "reset_stats_indexed_fastq", py_reset_stats_indexed_fastq, METH_VARARGS, "Clear the counters of an index." },
+    { "start_trace_indexed_fastq", py_start_trace_indexed_fastq, METH_VARARGS, "Log the queries of an index to a trace file." },
+    { "stop_trace_indexed_fastq", py_stop_trace_indexed_fastq, METH_VARARGS, "Stop logging the queries and close the trace file." },
+    { "latency_histograms_indexed_fastq", py_latency_histograms_indexed_fastq, METH_VARARGS, "Per-stage query latency histograms, or None if not timed." },
+    { "reset_latency_histograms_indexed_fastq", py_reset_latency_histograms_indexed_fastq, METH_VARARGS, "Clear the query latency histograms." },
+    { "close_indexed_fastq", py_close_indexed_fastq, METH_VARARGS, "Close an opened index." },
+    { NULL, NULL, 0, NULL }
+};
+
+/**
+ * Adds the flags that can be passed to open_indexed_fastq
+ * to the module.
+ *
+ * @param module The cindexedfastq module.
+ */
+static void add_constants(PyObject *module)
+{
+    PyModule_AddIntConstant( module, "OPEN_DEFAULT", IFQ_OPEN_DEFAULT );
+    PyModule_AddIntConstant( module, "OPEN_POPULATE", IFQ_OPEN_POPULATE );
+    PyModule_AddIntConstant( module, "OPEN_LOCK", IFQ_OPEN_LOCK );
+    PyModule_AddIntConstant( module, "OPEN_HUGEPAGES", IFQ_OPEN_HUGEPAGES );
+    PyModule_AddIntConstant( module, "OPEN_VERIFY", IFQ_OPEN_VERIFY );
+    PyModule_AddIntConstant( module, "OPEN_TIMING", IFQ_OPEN_TIMING );
+}
+
+#if PY_MAJOR_VERSION  >= 3
+
+static PyModuleDef moduledef = {
+    PyModuleDef_HEAD_INIT,
+    "cindexedfastq",
+    "Wrapper module for the cindexedfastq methods.",
+    -1,
+    module_methods,
+    NULL,
+    NULL,
+    NULL,
+    NULL
+};
+
+PyMODINIT_FUNC
+PyInit_cindexedfastq(void)
+{
+    PyObject *module;
+    
+    if( PyType_Ready( &c_indexed_fastq_prototype ) < 0 )
+    {
+        return NULL;
+    }
+
+    init_fastq_record_type( );
+    if( PyType_Ready( &fastq_record_prototype ) < 0 )
+    {
+        return NULL;
+    }
+
+    init_buffer_type( );
+    if( PyType_Ready( &buffer_prototype ) < 0 )
+    {
+        return NULL;
+    }
+
+    module = PyModule_Create( &moduledef );
+    if( module == NULL )
+    {
+        return NULL;
+    }
+#ifdef Py_GIL_DISABLED
+    /* The handles guard their readers, the records are immutable */
+    PyUnstable_Module_SetGIL( module, Py_MOD_GIL_NOT_USED );
+#endif
+    
+    Py_INCREF( &c_indexed_fastq_prototype );
+    PyModule_AddObject( module, "CIndexedFastq", (PyObject *) &c_indexed_fastq_prototype );
+    Py_INCREF( &fastq_record_prototype );
+    PyModule_AddObject( module, "FastqRecord", (PyObject *) &fastq_record_prototype );
+    Py_INCREF( &buffer_prototype );
+    PyModule_AddObject( module, "Buffer", (PyObject *) &buffer_prototype );
+    add_constants( module );
+
+    return module;
+}
+
+#else
+
+PyMODINIT_FUNC
+initcindexedfastq(void)
+{
+    PyObject *module;
+
+    if( PyType_Ready( &c_indexed_fastq_prototype ) < 0 )
+    {
+        return;
+    }
+
+    init_fastq_record_type( );
+    if( PyType_Ready( &fastq_record_prototype ) < 0 )
     {
         return;
     }
@@ -262,6 +1788,9 @@ initcindexedfastq(void)
 
     Py_INCREF( &c_indexed_fastq_prototype );
     PyModule_AddObject( module, "CIndexedFastq", (PyObject *) &c_indexed_fastq_prototype );
+    Py_INCREF( &fastq_record_prototype );
+    PyModule_AddObject( module, "FastqRecord", (PyObject *) &fastq_record_prototype );
+    add_constants( module );
 }
 
 #endif
@@ -1,12 +1,32 @@
 #include <cmph.h>
+#include <cmph_cpu.h>
 #include <string.h>
+#include <stdint.h>
+#include <time.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <sys/resource.h>
 #include <bgzf.h>
 
 #include <ifq.h>
+#include <ifq_format.h>
+
+#ifdef CMPH_CPU_X86
+#include <immintrin.h>
+#endif
+
+/* Static tracepoints for perf and bpftrace, each is a nop instruction
+ * until a tracer attaches, and nothing without IFQ_USDT */
+#ifdef IFQ_USDT
+#include <sys/sdt.h>
+#define IFQ_PROBE1( name, a ) DTRACE_PROBE1( ifq, name, a )
+#define IFQ_PROBE2( name, a, b ) DTRACE_PROBE2( ifq, name, a, b )
+#else
+#define IFQ_PROBE1( name, a ) do { } while( 0 )
+#define IFQ_PROBE2( name, a, b ) do { } while( 0 )
+#endif
 
 /**
  * Concatenates the given strings and returns the concatenated
@@ -46,7 +66,7 @@ bgzf_fgets(char *buffer, size_t buffer_size, BGZF *fp)
     }
     buffer[ i ] = '\0';
 
-    if( i > 0 && c != -1 )
+    if( i > 0 )
     {
         return buffer;
     }
@@ -56,6 +76,17 @@ bgzf_fgets(char *buffer, size_t buffer_size, BGZF *fp)
     }
 }
 
+/**
+ * Reads one line from the file, the trailing newline is stripped.
+ *
+ * @param line Pointer to a malloc:ed buffer or NULL, it is grown
+ *             as needed to hold the line.
+ * @param line_length The length of the line will be stored here.
+ * @param fp The file to read from.
+ *
+ * @return The number of bytes consumed from the file including
+ *         the newline, or 0 at end of file.
+ */
 int
 read_one_line(char **line, cmph_uint32 *line_length, BGZF *fp)
 {
@@ -66,7 +97,7 @@ read_one_line(char **line, cmph_uint32 *line_length, BGZF *fp)
         char *buffer_p = bgzf_fgets( buffer, BUFSIZ, fp );
         if( buffer_p == NULL )
         {
-            return 0;
+            break;
         }
         size_t buffer_length = strlen( buffer );
 
@@ -79,20 +110,400 @@ read_one_line(char **line, cmph_uint32 *line_length, BGZF *fp)
         }
     }
 
-    if( *line_length > 0 && (*line)[ *line_length - 1 ] == '\n' )
+    if( *line_length == 0 )
+    {
+        return 0;
+    }
+
+    int consumed = (int) *line_length;
+    (*line)[ *line_length ] = '\0';
+    if( (*line)[ *line_length - 1 ] == '\n' )
     {
         (*line)[ *line_length - 1 ] = '\0';
         (*line_length)--;
     }
 
-    return 1;
+    return consumed;
+}
+
+/**
+ * Skips one line in the file.
+ *
+ * @param fp The file to read from.
+ *
+ * @return The number of bytes consumed from the file including
+ *         the newline.
+ */
+int
+skip_one_line(BGZF *fp)
+{
+    int c;
+    int length = 0;
+    while( ( c = bgzf_getc( fp ) ) >= 0 )
+    {
+        length++;
+        if( c == '\n' )
+        {
+            break;
+        }
+    }
+
+    return length;
+}
+
+/**
+ * Counts the newlines in a buffer that end a non-empty line.
+ *
+ * @param buffer The bytes to scan.
+ * @param length Number of bytes in the buffer.
+ * @param previous The byte before the buffer, it is updated to
+ *                 the last byte of the buffer.
+ *
+ * @return The number of non-empty lines that end in the buffer.
+ */
+typedef size_t (*count_lines_fn_t)(const char *buffer, size_t length, char *previous);
+
+static size_t
+count_lines_scalar(const char *buffer, size_t length, char *previous)
+{
+    size_t lines = 0;
+    char last = *previous;
+    size_t i;
+    for(i = 0; i < length; i++)
+    {
+        if( buffer[ i ] == '\n' && last != '\n' )
+        {
+            lines++;
+        }
+        last = buffer[ i ];
+    }
+    *previous = last;
+
+    return lines;
+}
+
+#ifdef CMPH_CPU_X86
+/*
+ * The vector kernels compare a block at a time with newline, the
+ * mask shifted by one byte tells which bytes follow a newline.
+ */
+__attribute__((target("sse2,popcnt")))
+static size_t
+count_lines_sse2(const char *buffer, size_t length, char *previous)
+{
+    const __m128i newline = _mm_set1_epi8( '\n' );
+    uint32_t carry = *previous == '\n';
+    size_t lines = 0;
+    size_t i;
+    for(i = 0; i + 16 <= length; i += 16)
+    {
+        uint32_t mask = (uint32_t) _mm_movemask_epi8( _mm_cmpeq_epi8( _mm_loadu_si128( (const __m128i *) ( buffer + i ) ), newline ) );
+        lines += (size_t) __builtin_popcount( mask & ~( ( mask << 1 ) | carry ) );
+        carry = mask >> 15;
+    }
+    if( i > 0 )
+    {
+        *previous = buffer[ i - 1 ];
+    }
+
+    return lines + count_lines_scalar( buffer + i, length - i, previous );
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t
+count_lines_avx2(const char *buffer, size_t length, char *previous)
+{
+    const __m256i newline = _mm256_set1_epi8( '\n' );
+    uint32_t carry = *previous == '\n';
+    size_t lines = 0;
+    size_t i;
+    for(i = 0; i + 32 <= length; i += 32)
+    {
+        uint32_t mask = (uint32_t) _mm256_movemask_epi8( _mm256_cmpeq_epi8( _mm256_loadu_si256( (const __m256i *) ( buffer + i ) ), newline ) );
+        lines += (size_t) __builtin_popcount( mask & ~( ( mask << 1 ) | carry ) );
+        carry = mask >> 31;
+    }
+    if( i > 0 )
+    {
+        *previous = buffer[ i - 1 ];
+    }
+
+    return lines + count_lines_scalar( buffer + i, length - i, previous );
+}
+#endif
+
+/**
+ * Chooses the line counting kernel for the features of the
+ * processor, see cmph_cpu_features.
+ *
+ * @return The kernel.
+ */
+static count_lines_fn_t
+choose_count_lines()
+{
+    static count_lines_fn_t count_lines = NULL;
+    if( count_lines == NULL )
+    {
+        count_lines_fn_t kernel = count_lines_scalar;
+#ifdef CMPH_CPU_X86
+        cmph_uint32 features = cmph_cpu_features( );
+        if( ( features & CMPH_CPU_AVX2 ) && ( features & CMPH_CPU_POPCNT ) )
+        {
+            kernel = count_lines_avx2;
+        }
+        else if( ( features & CMPH_CPU_SSE2 ) && ( features & CMPH_CPU_POPCNT ) )
+        {
+            kernel = count_lines_sse2;
+        }
+#endif
+        count_lines = kernel;
+    }
+
+    return count_lines;
+}
+
+/**
+ * Maximum number of distinct phases of a build.
+ */
+#define BUILD_MAX_PHASES 16
+
+/**
+ * Seconds between the progress events of a phase.
+ */
+#define BUILD_PROGRESS_SECONDS 2.0
+
+/**
+ * The measurements of the phases of an index build.
+ */
+typedef struct build_profile
+{
+    const ifq_options_t *options;
+    BGZF *fastq_file;
+
+    ifq_build_phase_t phases[ BUILD_MAX_PHASES ];
+    size_t num_phases;
+
+    /* Totals of the progress of the count and populate phases */
+    uint64_t fastq_size;
+    uint64_t num_records;
+
+    /* The phase that runs now and where it started */
+    ifq_build_phase_t *current;
+    double wall_start;
+    double cpu_start;
+    int64_t bytes_start;
+    double last_progress;
+} build_profile_t;
+
+/**
+ * Returns the time of the given clock in seconds.
+ */
+static double
+profile_clock(clockid_t clock)
+{
+    struct timespec now;
+    clock_gettime( clock, &now );
+
+    return (double) now.tv_sec + (double) now.tv_nsec * 1e-9;
+}
+
+/**
+ * Ends the current phase, if any, and adds its measurements.
+ */
+static void
+profile_end_phase(build_profile_t *profile)
+{
+    ifq_build_phase_t *phase = profile->current;
+    if( phase == NULL )
+    {
+        return;
+    }
+
+    struct rusage usage;
+    getrusage( RUSAGE_SELF, &usage );
+
+    phase->wall_seconds += profile_clock( CLOCK_MONOTONIC ) - profile->wall_start;
+    phase->cpu_seconds += profile_clock( CLOCK_PROCESS_CPUTIME_ID ) - profile->cpu_start;
+    phase->peak_rss_kb = (uint64_t) usage.ru_maxrss;
+    phase->bytes_decompressed += (uint64_t) ( profile->fastq_file->stats.inflated_bytes - profile->bytes_start );
+    profile->current = NULL;
+    IFQ_PROBE1( build_phase_end, phase->name );
+
+    if( profile->options->callback != NULL )
+    {
+        profile->options->callback( profile->options->callback_data, IFQ_BUILD_PHASE_END, phase, 0, 0 );
+    }
+}
+
+/**
+ * Ends the current phase and starts the given one, the
+ * measurements of a phase that runs again are added up.
+ */
+static void
+profile_start_phase(build_profile_t *profile, const char *name)
+{
+    profile_end_phase( profile );
+
+    size_t i;
+    for(i = 0; i < profile->num_phases; i++)
+    {
+        if( strcmp( profile->phases[ i ].name, name ) == 0 )
+        {
+            break;
+        }
+    }
+    if( i == profile->num_phases )
+    {
+        if( i == BUILD_MAX_PHASES )
+        {
+            return;
+        }
+        memset( &profile->phases[ i ], 0, sizeof( ifq_build_phase_t ) );
+        profile->phases[ i ].name = name;
+        profile->num_phases++;
+    }
+
+    profile->current = &profile->phases[ i ];
+    profile->current->runs++;
+    profile->wall_start = profile_clock( CLOCK_MONOTONIC );
+    profile->cpu_start = profile_clock( CLOCK_PROCESS_CPUTIME_ID );
+    profile->bytes_start = profile->fastq_file->stats.inflated_bytes;
+    profile->last_progress = profile->wall_start;
+    IFQ_PROBE1( build_phase_start, name );
+
+    if( profile->options->callback != NULL )
+    {
+        profile->options->callback( profile->options->callback_data, IFQ_BUILD_PHASE_START, profile->current, 0, 0 );
+    }
+}
+
+/**
+ * Reports the progress of the current phase, at most every
+ * BUILD_PROGRESS_SECONDS.
+ */
+static void
+profile_progress(build_profile_t *profile, uint64_t done, uint64_t total)
+{
+    if( profile->options->callback == NULL || profile->current == NULL )
+    {
+        return;
+    }
+
+    double now = profile_clock( CLOCK_MONOTONIC );
+    if( now - profile->last_progress >= BUILD_PROGRESS_SECONDS )
+    {
+        profile->last_progress = now;
+        profile->options->callback( profile->options->callback_data, IFQ_BUILD_PROGRESS, profile->current, done, total );
+    }
+}
+
+/**
+ * Receives the construction steps of cmph.
+ */
+static void
+profile_cmph_phase(void *data, const char *phase)
+{
+    profile_start_phase( (build_profile_t *) data, phase );
+}
+
+/**
+ * Writes a string as a JSON string literal.
+ */
+static void
+write_json_string(FILE *file, const char *value)
+{
+    fputc( '"', file );
+    for(; *value != '\0'; value++)
+    {
+        unsigned char c = (unsigned char) *value;
+        if( c == '"' || c == '\\' )
+        {
+            fprintf( file, "\\%c", c );
+        }
+        else if( c < 0x20 )
+        {
+            fprintf( file, "\\u%04x", c );
+        }
+        else
+        {
+            fputc( c, file );
+        }
+    }
+    fputc( '"', file );
+}
+
+/**
+ * Writes the measurements of the phases and their totals as JSON.
+ *
+ * @param profile The measurements.
+ * @param fastq_path Path of the fastq file that was indexed.
+ * @param num_records Number of records in the fastq file.
+ * @param status Result of the build.
+ * @param path Path of the JSON file.
+ *
+ * @return 1 if successful, 0 otherwise.
+ */
+static int
+write_profile(const build_profile_t *profile, const char *fastq_path, size_t num_records, ifq_codes_t status, const char *path)
+{
+    FILE *file = fopen( path, "w" );
+    if( file == NULL )
+    {
+        return 0;
+    }
+
+    ifq_build_phase_t total;
+    memset( &total, 0, sizeof( ifq_build_phase_t ) );
+    size_t i;
+    for(i = 0; i < profile->num_phases; i++)
+    {
+        /* The phases never overlap, the steps of cmph end the hash phase */
+        const ifq_build_phase_t *phase = &profile->phases[ i ];
+        total.wall_seconds += phase->wall_seconds;
+        total.cpu_seconds += phase->cpu_seconds;
+        total.bytes_decompressed += phase->bytes_decompressed;
+        total.peak_rss_kb = phase->peak_rss_kb > total.peak_rss_kb ? phase->peak_rss_kb : total.peak_rss_kb;
+    }
+
+    fprintf( file, "{\n  \"fastq\": " );
+    write_json_string( file, fastq_path );
+    fprintf( file, ",\n  \"ok\": %s,\n  \"records\": %zu,\n", status == IFQ_OK ? "true" : "false", num_records );
+    fprintf( file, "  \"algorithm\": \"%s\",\n  \"hash\": \"%s\",\n", cmph_names[ profile->options->algorithm ],
+             cmph_hash_names[ profile->options->hash ] );
+    fprintf( file, "  \"wall_seconds\": %.6f,\n  \"cpu_seconds\": %.6f,\n  \"peak_rss_kb\": %llu,\n  \"bytes_decompressed\": %llu,\n",
+             total.wall_seconds, total.cpu_seconds, (unsigned long long) total.peak_rss_kb,
+             (unsigned long long) total.bytes_decompressed );
+    fprintf( file, "  \"phases\": [" );
+    for(i = 0; i < profile->num_phases; i++)
+    {
+        const ifq_build_phase_t *phase = &profile->phases[ i ];
+        fprintf( file, "%s\n    { \"name\": ", i > 0 ? "," : "" );
+        write_json_string( file, phase->name );
+        fprintf( file, ", \"runs\": %u, \"wall_seconds\": %.6f, \"cpu_seconds\": %.6f, \"peak_rss_kb\": %llu, \"bytes_decompressed\": %llu }",
+                 phase->runs, phase->wall_seconds, phase->cpu_seconds, (unsigned long long) phase->peak_rss_kb,
+                 (unsigned long long) phase->bytes_decompressed );
+    }
+    fprintf( file, "\n  ]\n}\n" );
+
+    return fclose( file ) == 0;
 }
 
-size_t count_fastq_sequences(BGZF *fastq_file)
+/**
+ * Counts the number of records in a fastq file, every record
+ * is assumed to span exactly four non-empty lines.
+ *
+ * @param fastq_file The fastq file.
+ * @param profile Receives the progress of the count.
+ *
+ * @return The number of records.
+ */
+size_t count_fastq_sequences(BGZF *fastq_file, build_profile_t *profile)
 {
     bgzf_seek( fastq_file, 0, SEEK_SET );
 
-    cmph_uint32 count = 0;
+    count_lines_fn_t count_lines = choose_count_lines( );
+    size_t lines = 0;
+    char previous = '\n';
     while( 1 )
     {
         char buffer[ BUFSIZ ];
@@ -102,33 +513,36 @@ size_t count_fastq_sequences(BGZF *fastq_file)
             break;
         }
 
-        int i;
-        for(i = 0; i < bytes_read; i++)
-        {
-            if( buffer[ i ] == '@' )
-            {
-                count++;
-            }
-        }
+        lines += count_lines( buffer, (size_t) bytes_read, &previous );
+        profile_progress( profile, (uint64_t) bgzf_tell_compressed( fastq_file ), profile->fastq_size );
+    }
+    if( previous != '\n' )
+    {
+        lines++;
     }
 
     bgzf_seek( fastq_file, 0, SEEK_SET );
-    return count;
+    return ( lines + 3 ) / 4;
 }
 
 int key_fastq_read(void *data, char **key, cmph_uint32 *keylen)
 {
     BGZF *fp = (BGZF *) data;
 
-    char c;
+    int c;
     *keylen = 0;
     /* Find header start */
     while( ( c = bgzf_getc( fp ) ) != '@' && c >= 0 )
     { }
 
     *key = NULL;
-    if( read_one_line( key, keylen, fp ) == 1 )
+    if( read_one_line( key, keylen, fp ) > 0 )
     {
+        /* Sequence, separator and quality lines */
+        skip_one_line( fp );
+        skip_one_line( fp );
+        skip_one_line( fp );
+
         return (int) *keylen;
     }
     else
@@ -149,12 +563,12 @@ void key_fastq_rewind(void *data)
 }
 
 cmph_io_adapter_t *
-cmph_io_fastq_adapter(BGZF *fastq_file)
+cmph_io_fastq_adapter(BGZF *fastq_file, build_profile_t *profile)
 {
     cmph_io_adapter_t * key_source = (cmph_io_adapter_t *) malloc( sizeof( cmph_io_adapter_t ) );
 
     key_source->data = (void *) fastq_file;
-    key_source->nkeys = count_fastq_sequences( fastq_file );
+    key_source->nkeys = count_fastq_sequences( fastq_file, profile );
     key_source->read = key_fastq_read;
     key_source->dispose = key_fastq_dispose;
     key_source->rewind = key_fastq_rewind;
@@ -171,220 +585,1714 @@ cmph_io_fastq_adapter(BGZF *fastq_file)
 };
 
 void
-populate_index(uint64_t *table, cmph_t *hash, BGZF *fastq_file)
+populate_index(ifq_entry_t *table, uint32_t *fingerprints, cmph_uint32 keys_per_bin, cmph_t *hash, BGZF *fastq_file,
+               build_profile_t *profile)
 {
+    char *accession = NULL;
+    uint64_t num_records = 0;
     while( 1 )
     {
         /* Find @ */
-        char c;
+        int c;
         while( ( c = bgzf_getc( fastq_file ) ) != '@' && c >= 0 )
         {
         }
-        
-        long pos = bgzf_tell( fastq_file );
-        if( pos == -1 )
+        if( c < 0 )
         {
             break;
         }
+        
+        /* Record starts after the @, save pos */
+        uint64_t pos = bgzf_tell( fastq_file );
 
-        char *accession = NULL;
         cmph_uint32 accession_length;
-        if( read_one_line( &accession, &accession_length, fastq_file ) != 1 )
+        int length = read_one_line( &accession, &accession_length, fastq_file );
+        if( length <= 0 )
         {
             break;
         }
 
-        /* Next char is sequence, save pos */
-        unsigned int id = cmph_search( hash, accession, accession_length );
-        table[ id ] = (uint64_t) pos;
+        /* Sequence, separator and quality lines */
+        length += skip_one_line( fastq_file );
+        length += skip_one_line( fastq_file );
+        length += skip_one_line( fastq_file );
+
+        /* Take the first free entry in the bin of the accession */
+        size_t id = (size_t) cmph_search( hash, accession, accession_length ) * keys_per_bin;
+        size_t last = id + keys_per_bin - 1;
+        while( table[ id ].length != 0 && id < last )
+        {
+            id++;
+        }
+
+        table[ id ].offset = pos;
+        table[ id ].length = (uint32_t) length;
+        table[ id ].span = (uint32_t) ( bgzf_tell_compressed( fastq_file ) - ( pos >> 16 ) );
+        fingerprints[ id ] = ifq_fingerprint( accession, accession_length );
+
+        if( ( ++num_records & 0xffff ) == 0 )
+        {
+            profile_progress( profile, num_records, profile->num_records );
+        }
     }
+
+    free( accession );
 }
 
-int create_index(BGZF *fastq_file, cmph_t *hash, char *seek_path)
+/**
+ * Writes the index file, it contains the packed hash function,
+ * the lookup table, the fingerprints and the given metadata.
+ *
+ * @param fastq_file The fastq file positioned at the start.
+ * @param hash The hash function of the accessions.
+ * @param keys_per_bin Maximum number of accessions per hash value.
+ * @param metadata Metadata text, key=value lines.
+ * @param index_path Path of the index file.
+ * @param profile Receives the progress of the lookup table.
+ *
+ * @return 1 if successful, 0 otherwise.
+ */
+int create_index(BGZF *fastq_file, cmph_t *hash, cmph_uint32 keys_per_bin, const char *metadata, char *index_path,
+                 build_profile_t *profile)
 {
-    int fd = open( seek_path, O_CREAT | O_RDWR, 0644 );
+    uint64_t num_entries = (uint64_t) cmph_size( hash ) * keys_per_bin;
+    ifq_header_t header;
+    ifq_section_t sections[ 4 ];
+
+    sections[ 0 ].type = IFQ_SECTION_HASH;
+    sections[ 0 ].size = cmph_packed_size( hash );
+    sections[ 1 ].type = IFQ_SECTION_TABLE;
+    sections[ 1 ].size = sizeof( ifq_entry_t ) * num_entries;
+    sections[ 2 ].type = IFQ_SECTION_FINGERPRINT;
+    sections[ 2 ].size = sizeof( uint32_t ) * num_entries;
+    sections[ 3 ].type = IFQ_SECTION_METADATA;
+    sections[ 3 ].size = strlen( metadata );
+    if( sections[ 0 ].size == 0 )
+    {
+        return 0;
+    }
+
+    uint64_t file_size = ifq_layout_sections( &header, sections, 4 );
+
+    int fd = open( index_path, O_CREAT | O_TRUNC | O_RDWR, 0644 );
     if( fd == -1 )
     {
         return 0;
     }
 
-    off_t file_size = sizeof( uint64_t ) * cmph_size( hash );
-    if( ftruncate( fd, file_size ) == -1 )
+    if( ftruncate( fd, (off_t) file_size ) == -1 )
     {
+        close( fd );
         return 0;
     }
 
-    uint64_t *table = (uint64_t *) mmap( NULL, file_size, PROT_READ | PROT_WRITE, MAP_FILE | MAP_SHARED, fd, 0 );
-    if( table == MAP_FAILED )
+    char *data = (char *) mmap( NULL, file_size, PROT_READ | PROT_WRITE, MAP_FILE | MAP_SHARED, fd, 0 );
+    if( data == MAP_FAILED )
     {
+        close( fd );
         return 0;
     }
 
-    populate_index( table, hash, fastq_file );
+    cmph_pack( hash, data + sections[ 0 ].offset );
+    populate_index( (ifq_entry_t *) ( data + sections[ 1 ].offset ),
+                    (uint32_t *) ( data + sections[ 2 ].offset ),
+                    keys_per_bin, hash, fastq_file, profile );
+    memcpy( data + sections[ 3 ].offset, metadata, sections[ 3 ].size );
+    ifq_seal_sections( data, &header, sections );
 
-    munmap( table, file_size );
+    munmap( data, file_size );
     close( fd );
 
     return 1;
 }
 
-ifq_codes_t ifq_create_index(char *fastq_path, char *index_prefix)
+void
+ifq_default_options(ifq_options_t *options)
 {
-    char *hash_path = concatenate( index_prefix, ".hsh" );
-    char *seek_path = concatenate( index_prefix, ".lup" );
-    ifq_codes_t ret = IFQ_OK;
-    
-    /* Open output files */
-    BGZF *fastq_file = bgzf_open( fastq_path, "r" );
-    if( fastq_file == NULL )
-    {
-        ret = IFQ_BAD_FASTQ;
-        goto index_fastq_fail;
-    }
-    
-    FILE *hash_file = fopen( hash_path, "w" );
-    if( hash_file == NULL )
-    {
-        ret = IFQ_BAD_PREFIX;
-        goto index_prefix_fail;
-    }
+    options->algorithm = CMPH_CHD;
+    options->hash = CMPH_HASH_JENKINS;
+    options->b = 0;
+    options->keys_per_bin = 0;
+    options->graph_size = 0.0;
+    options->tmp_dir = NULL;
+    options->callback = NULL;
+    options->callback_data = NULL;
+    options->profile_path = NULL;
+}
 
-    /* Create hash function */
-    cmph_io_adapter_t *source = cmph_io_fastq_adapter( fastq_file );
-    if( source == NULL )
+CMPH_ALGO
+ifq_parse_algorithm(const char *name)
+{
+    int i;
+    for(i = 0; i < CMPH_COUNT; i++)
     {
-        ret = IFQ_BAD_HASH;
-        goto index_prefix_fail;
+        if( strcmp( name, cmph_names[ i ] ) == 0 )
+        {
+            return (CMPH_ALGO) i;
+        }
     }
 
-    cmph_config_t *config = cmph_config_new( source );
-    cmph_config_set_algo( config, CMPH_CHD );
-    cmph_config_set_mphf_fd( config, hash_file );
-    cmph_t *hash = cmph_new( config );
-    if( hash == NULL )
-    {
-        ret = IFQ_BAD_HASH;
-        goto index_hash_fail;
-    }
+    return CMPH_COUNT;
+}
 
-    /* Create the file index using the hash */
-    bgzf_seek( fastq_file, 0, SEEK_SET );
-    if( create_index( fastq_file, hash, seek_path ) != 1 )
+CMPH_HASH
+ifq_parse_hash(const char *name)
+{
+    int i;
+    for(i = 0; i < CMPH_HASH_COUNT; i++)
     {
-        ret = IFQ_BAD_INDEX;
-        goto index_create_fail;
+        if( strcmp( name, cmph_hash_names[ i ] ) == 0 )
+        {
+            return (CMPH_HASH) i;
+        }
     }
-index_fastq_fail:
-    free( hash_path );
-    free( seek_path );
 
-index_create_fail:
-    cmph_config_destroy( config );
+    return CMPH_HASH_COUNT;
+}
+
+/**
+ * Makes every hash function of the algorithm use the given one.
+ *
+ * @param config The configuration, its algorithm must be set.
+ * @param hash The hash function.
+ */
+void
+set_hash(cmph_config_t *config, CMPH_HASH hash)
+{
+    /* BRZ uses the most, three */
+    CMPH_HASH hashes[ 4 ] = { hash, hash, hash, CMPH_HASH_COUNT };
+    cmph_config_set_hashfuncs( config, hashes );
+}
+
+/**
+ * BRZ writes most of the hash function to its output file while
+ * it is built, so it must be read back before it can be packed.
+ *
+ * @param hash A hash function built by BRZ.
+ * @param hash_file The output file given to cmph_config_set_mphf_fd.
+ *
+ * @return The complete hash function, or NULL on failure. The
+ *         given hash is destroyed.
+ */
+cmph_t *
+reload_hash(cmph_t *hash, FILE *hash_file)
+{
     cmph_dump( hash, hash_file );
     cmph_destroy( hash );
-    free( source );
-
-index_hash_fail:
-    fclose( hash_file );
 
-index_prefix_fail:
-    bgzf_close( fastq_file );
+    fflush( hash_file );
+    rewind( hash_file );
 
-    return ret;
+    return cmph_load( hash_file );
 }
 
-ifq_codes_t
-ifq_open_index(char *fastq_path, char *index_prefix, ifq_index_t *index)
+ifq_codes_t ifq_create_index(char *fastq_path, char *index_prefix)
 {
-    char *hash_path = concatenate( index_prefix, ".hsh" );
-    char *lookup_path = concatenate( index_prefix, ".lup" );
+    ifq_options_t options;
+    ifq_default_options( &options );
 
-    ifq_codes_t ret = IFQ_OK;
+    return ifq_create_index_with_options( fastq_path, index_prefix, &options );
+}
 
-    index->fastq_file = bgzf_open( fastq_path , "r" );
-    if( index->fastq_file == NULL )
-    {
-        ret = IFQ_BAD_FASTQ;
+/**
+ * Returns the parameters that cmph builds the hash function with, it
+ * replaces values that are out of range for the algorithm, such as the
+ * default 0, with its own defaults.
+ *
+ * @param algorithm The algorithm of the hash function.
+ * @param b The given b, the bucket size of CHD and CHD_PH, the bits
+ *          per key of BDZ or the bits per bucket of BRZ.
+ * @param graph_size The given graph size or load factor.
+ * @param effective_b Receives the b that is used, 0 if the algorithm
+ *                    has none.
+ * @param effective_graph_size Receives the graph size that is used.
+ */
+static void
+effective_parameters(CMPH_ALGO algorithm, cmph_uint32 b, double graph_size, cmph_uint32 *effective_b, double *effective_graph_size)
+{
+    *effective_b = 0;
+    *effective_graph_size = graph_size;
+    switch( algorithm )
+    {
+        case CMPH_CHM:
+            *effective_graph_size = graph_size == 0 ? 2.09 : graph_size;
+            break;
+        case CMPH_BMZ:
+        case CMPH_BMZ8:
+            *effective_graph_size = graph_size == 0 ? 1.15 : graph_size;
+            break;
+        case CMPH_BRZ:
+            *effective_b = b <= 64 || b >= 175 ? 128 : b;
+            /* Below 2 the buckets are built with BMZ8, from 2 with FCH */
+            if( graph_size < 2.0 )
+            {
+                *effective_graph_size = graph_size == 0 ? 1.0 : graph_size;
+            }
+            else
+            {
+                *effective_graph_size = graph_size <= 2.0 ? 2.6 : graph_size;
+            }
+            break;
+        case CMPH_FCH:
+            *effective_graph_size = graph_size <= 2.0 ? 2.6 : graph_size;
+            break;
+        case CMPH_BDZ:
+            *effective_b = b <= 2 || b > 10 ? 7 : b;
+            *effective_graph_size = graph_size == 0 ? 1.23 : graph_size;
+            break;
+        case CMPH_BDZ_PH:
+            *effective_graph_size = graph_size == 0 ? 1.23 : graph_size;
+            break;
+        case CMPH_CHD_PH:
+        case CMPH_CHD:
+            *effective_b = b < 1 || b >= 15 ? 4 : b;
+            *effective_graph_size = graph_size < 0.5 ? 0.5 : graph_size >= 0.99 ? 0.99 : graph_size;
+            break;
+        default:
+            break;
+    }
+}
+
+ifq_codes_t ifq_create_index_with_options(char *fastq_path, char *index_prefix, const ifq_options_t *options)
+{
+    char *index_path = concatenate( index_prefix, IFQ_INDEX_EXTENSION );
+    ifq_codes_t ret = IFQ_OK;
+    cmph_io_adapter_t *source = NULL;
+    cmph_config_t *config = NULL;
+    cmph_t *hash = NULL;
+    FILE *hash_file = NULL;
+    BGZF *fastq_file = NULL;
+    build_profile_t profile;
+    memset( &profile, 0, sizeof( build_profile_t ) );
+    profile.options = options;
+
+    /* Only CHD_PH supports more than one key per bin, up to 127, each
+     * bin then gets keys_per_bin entries in the lookup table. BMZ8 holds
+     * at most 256 keys, too few for any real fastq file */
+    cmph_uint32 keys_per_bin = options->keys_per_bin > 1 ? options->keys_per_bin : 1;
+    if( options->algorithm >= CMPH_COUNT || options->hash >= CMPH_HASH_COUNT ||
+        options->algorithm == CMPH_BMZ8 ||
+        ( keys_per_bin > 1 && ( options->algorithm != CMPH_CHD_PH || keys_per_bin >= 128 ) ) )
+    {
+        ret = IFQ_BAD_HASH;
+        goto index_done;
+    }
+    
+    /* Open input file */
+    fastq_file = bgzf_open( fastq_path, "r" );
+    if( fastq_file == NULL )
+    {
+        ret = IFQ_BAD_FASTQ;
+        goto index_done;
+    }
+
+    profile.fastq_file = fastq_file;
+    struct stat sb;
+    if( fstat( fastq_file->file_descriptor, &sb ) == 0 )
+    {
+        profile.fastq_size = (uint64_t) sb.st_size;
+    }
+
+    /* Create hash function */
+    profile_start_phase( &profile, "count" );
+    source = cmph_io_fastq_adapter( fastq_file, &profile );
+    profile_start_phase( &profile, "hash" );
+    if( source == NULL )
+    {
+        ret = IFQ_BAD_HASH;
+        goto index_done;
+    }
+
+    config = cmph_config_new( source );
+    cmph_config_set_algo( config, options->algorithm );
+    set_hash( config, options->hash );
+    cmph_config_set_b( config, options->b );
+    cmph_config_set_keys_per_bin( config, keys_per_bin );
+    cmph_config_set_graphsize( config, options->graph_size );
+    cmph_config_set_phase_callback( config, profile_cmph_phase, &profile );
+    if( options->algorithm == CMPH_BRZ )
+    {
+        hash_file = tmpfile( );
+        if( hash_file == NULL )
+        {
+            ret = IFQ_BAD_HASH;
+            goto index_done;
+        }
+        cmph_config_set_mphf_fd( config, hash_file );
+        if( options->tmp_dir != NULL )
+        {
+            cmph_config_set_tmp_dir( config, (cmph_uint8 *) options->tmp_dir );
+        }
+    }
+
+    hash = cmph_new( config );
+    if( hash != NULL && options->algorithm == CMPH_BRZ )
+    {
+        hash = reload_hash( hash, hash_file );
+    }
+    if( hash == NULL )
+    {
+        ret = IFQ_BAD_HASH;
+        goto index_done;
+    }
+
+    cmph_uint32 b;
+    double graph_size;
+    effective_parameters( options->algorithm, options->b, options->graph_size, &b, &graph_size );
+
+    char metadata[ 1024 ];
+    snprintf( metadata, sizeof( metadata ),
+              "records=%u\nalgorithm=%s\nhash=%s\nb=%u\nkeys_per_bin=%u\ngraph_size=%g\n",
+              source->nkeys, cmph_names[ options->algorithm ], cmph_hash_names[ options->hash ],
+              b, keys_per_bin, graph_size );
+
+    /* Create the file index using the hash */
+    profile_start_phase( &profile, "populate" );
+    profile.num_records = source->nkeys;
+    bgzf_seek( fastq_file, 0, SEEK_SET );
+    if( create_index( fastq_file, hash, keys_per_bin, metadata, index_path, &profile ) != 1 )
+    {
+        ret = IFQ_BAD_PREFIX;
+        goto index_done;
+    }
+
+index_done:
+    profile_end_phase( &profile );
+    if( options->profile_path != NULL && fastq_file != NULL &&
+        write_profile( &profile, fastq_path, source != NULL ? source->nkeys : 0, ret, options->profile_path ) != 1 && ret == IFQ_OK )
+    {
+        ret = IFQ_BAD_PREFIX;
+    }
+    if( hash != NULL )
+    {
+        cmph_destroy( hash );
+    }
+    if( config != NULL )
+    {
+        cmph_config_destroy( config );
+    }
+    if( hash_file != NULL )
+    {
+        fclose( hash_file );
+    }
+    free( source );
+    if( fastq_file != NULL )
+    {
+        bgzf_close( fastq_file );
+    }
+    free( index_path );
+
+    return ret;
+}
+
+/**
+ * Settings tried by ifq_tune_options, keys per bin above one
+ * are only tried with CHD_PH.
+ */
+static const cmph_uint32 tune_b[] = { 2, 3, 4, 5, 6, 7, 8 };
+static const double tune_load_factor[] = { 0.5, 0.7, 0.8, 0.9, 0.99 };
+static const cmph_uint32 tune_keys_per_bin[] = { 1, 2, 4, 8 };
+
+#define TUNE_LENGTH( a ) ( sizeof( a ) / sizeof( a[ 0 ] ) )
+
+/**
+ * A setting is abandoned after this many failed trials, or if it
+ * takes this many times longer to build than the fastest one.
+ */
+#define TUNE_MAX_ITERATIONS 1
+#define TUNE_SLOW_BUILD 20.0
+
+/**
+ * Number of times every accession of the sample is looked up.
+ */
+#define TUNE_LOOKUP_ROUNDS 4
+
+/**
+ * Keeps the compiler from removing the timed lookups.
+ */
+static volatile size_t tune_found;
+
+/**
+ * Reads the first accessions of the fastq file.
+ *
+ * @param fastq_file The fastq file positioned at the start.
+ * @param sample_size Maximum number of accessions to read.
+ * @param num_keys The number of accessions read is stored here.
+ *
+ * @return A malloc:ed array of malloc:ed accessions.
+ */
+static char **
+read_sample(BGZF *fastq_file, size_t sample_size, cmph_uint32 *num_keys)
+{
+    char **keys = (char **) malloc( sizeof( char * ) * sample_size );
+    cmph_uint32 key_length;
+
+    *num_keys = 0;
+    while( *num_keys < sample_size && key_fastq_read( fastq_file, &keys[ *num_keys ], &key_length ) >= 0 )
+    {
+        (*num_keys)++;
+    }
+
+    return keys;
+}
+
+/**
+ * Builds a hash function for the sample with the given options
+ * and measures it.
+ *
+ * @param keys The sample.
+ * @param num_keys Number of accessions in the sample.
+ * @param result Holds the options, the measurements are stored here.
+ */
+static void
+measure_options(char **keys, cmph_uint32 num_keys, ifq_tune_result_t *result)
+{
+    const ifq_options_t *options = &result->options;
+    cmph_io_adapter_t *source = cmph_io_vector_adapter( keys, num_keys );
+    cmph_config_t *config = cmph_config_new( source );
+    cmph_config_set_algo( config, options->algorithm );
+    set_hash( config, options->hash );
+    cmph_config_set_b( config, options->b );
+    cmph_config_set_keys_per_bin( config, options->keys_per_bin );
+    cmph_config_set_graphsize( config, options->graph_size );
+    cmph_config_set_max_iterations( config, TUNE_MAX_ITERATIONS );
+
+    double start = profile_clock( CLOCK_MONOTONIC );
+    cmph_t *hash = cmph_new( config );
+    result->build_seconds = profile_clock( CLOCK_MONOTONIC ) - start;
+    cmph_config_destroy( config );
+    cmph_io_vector_adapter_destroy( source );
+
+    if( hash == NULL )
+    {
+        result->build_seconds = 0.0;
+        return;
+    }
+
+    cmph_uint32 packed_size = cmph_packed_size( hash );
+    void *packed = malloc( packed_size );
+    cmph_pack( hash, packed );
+
+    /* Lay out the fingerprints as in the index */
+    size_t num_entries = (size_t) cmph_size( hash ) * options->keys_per_bin;
+    uint32_t *fingerprints = (uint32_t *) calloc( num_entries, sizeof( uint32_t ) );
+    size_t *key_lengths = (size_t *) malloc( sizeof( size_t ) * num_keys );
+    cmph_uint32 i, j;
+    for(i = 0; i < num_keys; i++)
+    {
+        key_lengths[ i ] = strlen( keys[ i ] );
+        size_t id = (size_t) cmph_search( hash, keys[ i ], (cmph_uint32) key_lengths[ i ] ) * options->keys_per_bin;
+        size_t last = id + options->keys_per_bin - 1;
+        while( fingerprints[ id ] != 0 && id < last )
+        {
+            id++;
+        }
+        fingerprints[ id ] = ifq_fingerprint( keys[ i ], key_lengths[ i ] );
+    }
+    cmph_destroy( hash );
+
+    /* Look up every accession a few times and keep the fastest
+     * round, which is the least disturbed by other processes */
+    double lookup_seconds = 0.0;
+    size_t found = 0;
+    for(j = 0; j < TUNE_LOOKUP_ROUNDS; j++)
+    {
+        found = 0;
+        start = profile_clock( CLOCK_MONOTONIC );
+        for(i = 0; i < num_keys; i++)
+        {
+            size_t first = (size_t) cmph_search_packed( packed, keys[ i ], (cmph_uint32) key_lengths[ i ] ) * options->keys_per_bin;
+            uint32_t fingerprint = ifq_fingerprint( keys[ i ], key_lengths[ i ] );
+            size_t id;
+            for(id = first; id < first + options->keys_per_bin; id++)
+            {
+                if( fingerprints[ id ] == fingerprint )
+                {
+                    found++;
+                    break;
+                }
+            }
+        }
+        double round_seconds = profile_clock( CLOCK_MONOTONIC ) - start;
+        if( j == 0 || round_seconds < lookup_seconds )
+        {
+            lookup_seconds = round_seconds;
+        }
+    }
+
+    tune_found = found;
+    result->built = 1;
+    result->bits_per_key = 8.0 * packed_size / num_keys;
+    result->table_bytes_per_key = (double) ( sizeof( ifq_entry_t ) + sizeof( uint32_t ) ) * num_entries / num_keys;
+    result->lookup_ns = 1e9 * lookup_seconds / num_keys;
+
+    free( key_lengths );
+    free( fingerprints );
+    free( packed );
+}
+
+/**
+ * Returns the value of a result that the goal minimizes.
+ */
+static double
+tune_cost(const ifq_tune_result_t *result, ifq_tune_goal_t goal)
+{
+    if( goal == IFQ_TUNE_SIZE )
+    {
+        return result->bits_per_key + 8.0 * result->table_bytes_per_key;
+    }
+    else if( goal == IFQ_TUNE_BUILD )
+    {
+        return result->build_seconds;
+    }
+    else
+    {
+        return result->lookup_ns;
+    }
+}
+
+void
+ifq_default_tune_target(ifq_tune_target_t *target)
+{
+    target->goal = IFQ_TUNE_LOOKUP;
+    target->max_bits_per_key = 0.0;
+    target->max_lookup_ns = 0.0;
+    target->sample_size = 50000;
+}
+
+ifq_codes_t
+ifq_tune_options(char *fastq_path, const ifq_tune_target_t *target, ifq_options_t *options,
+                 ifq_tune_result_t **results, size_t *num_results)
+{
+    if( options->hash >= CMPH_HASH_COUNT )
+    {
+        return IFQ_BAD_HASH;
+    }
+
+    BGZF *fastq_file = bgzf_open( fastq_path, "r" );
+    if( fastq_file == NULL )
+    {
+        return IFQ_BAD_FASTQ;
+    }
+
+    cmph_uint32 num_keys;
+    char **keys = read_sample( fastq_file, target->sample_size, &num_keys );
+    bgzf_close( fastq_file );
+    if( num_keys == 0 )
+    {
+        free( keys );
+        return IFQ_BAD_FASTQ;
+    }
+
+    size_t max_tried = TUNE_LENGTH( tune_b ) * TUNE_LENGTH( tune_load_factor ) * ( TUNE_LENGTH( tune_keys_per_bin ) + 1 );
+    ifq_tune_result_t *tried = (ifq_tune_result_t *) calloc( max_tried, sizeof( ifq_tune_result_t ) );
+    size_t num_tried = 0;
+    double fastest_build = 0.0;
+    size_t b, l, k;
+    for(k = 0; k <= TUNE_LENGTH( tune_keys_per_bin ); k++)
+    {
+        /* Larger buckets and load factors are harder to build, once
+         * a setting fails or is slow the harder ones are skipped */
+        size_t max_load = TUNE_LENGTH( tune_load_factor );
+        for(b = 0; b < TUNE_LENGTH( tune_b ); b++)
+        {
+            for(l = 0; l < max_load; l++)
+            {
+                /* The first pass is CHD, the rest CHD_PH with each number of keys per bin */
+                ifq_tune_result_t *result = &tried[ num_tried++ ];
+                ifq_default_options( &result->options );
+                result->options.hash = options->hash;
+                result->options.algorithm = k == 0 ? CMPH_CHD : CMPH_CHD_PH;
+                result->options.b = tune_b[ b ];
+                result->options.keys_per_bin = k == 0 ? 1 : tune_keys_per_bin[ k - 1 ];
+                result->options.graph_size = tune_load_factor[ l ];
+
+                measure_options( keys, num_keys, result );
+                if( result->built && ( fastest_build == 0.0 || result->build_seconds < fastest_build ) )
+                {
+                    fastest_build = result->build_seconds;
+                }
+                if( !result->built || result->build_seconds > TUNE_SLOW_BUILD * fastest_build )
+                {
+                    max_load = l;
+                    break;
+                }
+            }
+        }
+    }
+
+    ifq_tune_result_t *best = NULL;
+    size_t i;
+    for(i = 0; i < num_tried; i++)
+    {
+        ifq_tune_result_t *result = &tried[ i ];
+        if( !result->built ||
+            ( target->max_bits_per_key > 0.0 && result->bits_per_key > target->max_bits_per_key ) ||
+            ( target->max_lookup_ns > 0.0 && result->lookup_ns > target->max_lookup_ns ) )
+        {
+            continue;
+        }
+
+        if( best == NULL || tune_cost( result, target->goal ) < tune_cost( best, target->goal ) )
+        {
+            best = result;
+        }
+    }
+
+    ifq_codes_t ret = IFQ_BAD_HASH;
+    if( best != NULL )
+    {
+        /* Only the tuned fields, the directory and reporting stay */
+        options->algorithm = best->options.algorithm;
+        options->b = best->options.b;
+        options->keys_per_bin = best->options.keys_per_bin;
+        options->graph_size = best->options.graph_size;
+        ret = IFQ_OK;
+    }
+
+    if( num_results != NULL )
+    {
+        *num_results = num_tried;
+    }
+    if( results != NULL )
+    {
+        *results = tried;
+    }
+    else
+    {
+        free( tried );
+    }
+
+    for(i = 0; i < num_keys; i++)
+    {
+        free( keys[ i ] );
+    }
+    free( keys );
+
+    return ret;
+}
+
+/**
+ * Rounds a size up to a whole number of cache lines.
+ */
+#define PRIVATE_ALIGN( size ) ( ( ( size ) + 63 ) & ~( (size_t) 63 ) )
+
+/**
+ * Brings the sections that the queries read, the hash function, the
+ * lookup table and the fingerprints, into memory according to the
+ * given open flags.
+ *
+ * @param index An index with mapped sections.
+ * @param flags A combination of ifq_open_flags_t.
+ *
+ * @return IFQ_OK if successful, IFQ_BAD_INDEX if the sections could
+ *         not be copied into huge pages, IFQ_BAD_LOCK if they could
+ *         not be locked.
+ */
+ifq_codes_t
+warm_table(ifq_index_t *index, int flags)
+{
+    if( flags & IFQ_OPEN_HUGEPAGES )
+    {
+        size_t fingerprints_size = index->fingerprints != NULL ? sizeof( uint32_t ) * index->num_entries : 0;
+        size_t size = PRIVATE_ALIGN( index->hash_size ) + PRIVATE_ALIGN( index->lookup_size ) + fingerprints_size;
+        char *data = (char *) mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+        if( data == MAP_FAILED )
+        {
+            return IFQ_BAD_INDEX;
+        }
+#ifdef MADV_HUGEPAGE
+        if( madvise( data, size, MADV_HUGEPAGE ) != 0 )
+        {
+            munmap( data, size );
+            return IFQ_BAD_INDEX;
+        }
+#endif
+        char *table = data + PRIVATE_ALIGN( index->hash_size );
+        char *fingerprints = table + PRIVATE_ALIGN( index->lookup_size );
+        memcpy( data, index->hash, index->hash_size );
+        memcpy( table, index->table, index->lookup_size );
+        if( fingerprints_size > 0 )
+        {
+            memcpy( fingerprints, index->fingerprints, fingerprints_size );
+        }
+        if( mprotect( data, size, PROT_READ ) != 0 )
+        {
+            munmap( data, size );
+            return IFQ_BAD_INDEX;
+        }
+
+        index->hash = data;
+        index->table = (ifq_entry_t *) table;
+        if( fingerprints_size > 0 )
+        {
+            index->fingerprints = (uint32_t *) fingerprints;
+        }
+        index->private_data = data;
+        index->private_size = size;
+    }
+    else if( flags & IFQ_OPEN_POPULATE )
+    {
+#ifndef MAP_POPULATE
+        long page_size = sysconf( _SC_PAGESIZE );
+        volatile const char *data = (const char *) index->data;
+        size_t i;
+
+        madvise( index->data, index->data_size, MADV_WILLNEED );
+        for(i = 0; i < index->data_size; i += page_size)
+        {
+            (void) data[ i ];
+        }
+#endif
+    }
+
+    /* The header and metadata are locked along with the sections, they
+     * share their pages and are small */
+    if( flags & IFQ_OPEN_LOCK )
+    {
+        if( mlock( index->data, index->data_size ) != 0 ||
+            ( index->private_data != NULL && mlock( index->private_data, index->private_size ) != 0 ) )
+        {
+            return IFQ_BAD_LOCK;
+        }
+    }
+
+    return IFQ_OK;
+}
+
+ifq_codes_t
+ifq_open_index(char *fastq_path, char *index_prefix, ifq_index_t *index)
+{
+    return ifq_open_index_with_flags( fastq_path, index_prefix, IFQ_OPEN_DEFAULT, index );
+}
+
+ifq_codes_t
+ifq_open_index_with_flags(char *fastq_path, char *index_prefix, int flags, ifq_index_t *index)
+{
+    char *index_path = concatenate( index_prefix, IFQ_INDEX_EXTENSION );
+    const ifq_section_t *section;
+    ifq_codes_t ret = IFQ_OK;
+
+    memset( index, 0, sizeof( ifq_index_t ) );
+    index->index_fd = -1;
+
+    index->fastq_file = bgzf_open( fastq_path , "r" );
+    index->fastq_path = strdup( fastq_path );
+    if( index->fastq_file == NULL || index->fastq_path == NULL )
+    {
+        ret = IFQ_BAD_FASTQ;
         goto index_error;
     }
-    
-    index->hash_file = fopen( hash_path , "r" );
-    if( index->hash_file == NULL )
+
+    index->index_fd = open( index_path, O_RDONLY );
+    if( index->index_fd == -1 )
+    {
+        ret = IFQ_BAD_PREFIX;
+        goto index_error;
+    }
+    
+    struct stat sb;
+    if( fstat( index->index_fd, &sb ) != 0 || sb.st_size < (off_t) sizeof( ifq_header_t ) )
+    {
+        ret = IFQ_BAD_INDEX;
+        goto index_error;
+    }
+    index->data_size = (size_t) sb.st_size;
+
+    int map_flags = MAP_FILE | MAP_SHARED;
+#ifdef MAP_POPULATE
+    if( flags & IFQ_OPEN_POPULATE )
+    {
+        map_flags |= MAP_POPULATE;
+    }
+#endif
+
+    index->data = mmap( NULL, index->data_size, PROT_READ, map_flags, index->index_fd, 0 );
+    if( index->data == MAP_FAILED )
+    {
+        index->data = NULL;
+        ret = IFQ_BAD_INDEX;
+        goto index_error;
+    }
+
+    if( ifq_check_header( index->data, index->data_size ) != 1 ||
+        ( ( flags & IFQ_OPEN_VERIFY ) && ifq_check_sections( index->data ) != 1 ) )
+    {
+        ret = IFQ_BAD_INDEX;
+        goto index_error;
+    }
+
+    /* Required sections */
+    section = ifq_find_section( index->data, IFQ_SECTION_HASH );
+    if( section == NULL || section->size == 0 )
+    {
+        ret = IFQ_BAD_HASH;
+        goto index_error;
+    }
+    index->hash = (char *) index->data + section->offset;
+    index->hash_size = section->size;
+
+    section = ifq_find_section( index->data, IFQ_SECTION_TABLE );
+    if( section == NULL || section->size == 0 || section->size % sizeof( ifq_entry_t ) != 0 )
+    {
+        ret = IFQ_BAD_INDEX;
+        goto index_error;
+    }
+    index->table = (ifq_entry_t *) ( (char *) index->data + section->offset );
+    index->lookup_size = section->size;
+    index->num_entries = section->size / sizeof( ifq_entry_t );
+
+    /* Optional sections */
+    section = ifq_find_section( index->data, IFQ_SECTION_FINGERPRINT );
+    if( section != NULL && section->size == sizeof( uint32_t ) * index->num_entries )
+    {
+        index->fingerprints = (uint32_t *) ( (char *) index->data + section->offset );
+    }
+
+    section = ifq_find_section( index->data, IFQ_SECTION_METADATA );
+    if( section != NULL )
+    {
+        index->metadata = (char *) index->data + section->offset;
+        index->metadata_size = section->size;
+    }
+
+    char keys_per_bin[ 16 ];
+    index->keys_per_bin = 1;
+    if( ifq_get_metadata( index, "keys_per_bin", keys_per_bin, sizeof( keys_per_bin ) ) == 1 )
+    {
+        index->keys_per_bin = (cmph_uint32) atoi( keys_per_bin );
+    }
+    if( index->keys_per_bin == 0 || index->num_entries % index->keys_per_bin != 0 )
+    {
+        ret = IFQ_BAD_INDEX;
+        goto index_error;
+    }
+
+    ret = warm_table( index, flags );
+
+#ifdef IFQ_TIMING
+    if( ret == IFQ_OK && ( flags & IFQ_OPEN_TIMING ) )
+    {
+        /* Without memory the queries are still answered, only not timed */
+        index->histograms = (ifq_histogram_t *) calloc( IFQ_NUM_STAGES, sizeof( ifq_histogram_t ) );
+    }
+#endif
+
+index_error: 
+    free( index_path );
+    if( ret != IFQ_OK )
+    {
+        ifq_destroy_index( index );
+    }
+
+    return ret;
+}
+
+void
+ifq_destroy_index(ifq_index_t *index)
+{
+    if( index != NULL )
+    {
+        if( !index->shared )
+        {
+            if( index->private_data != NULL )
+            {
+                munmap( index->private_data, index->private_size );
+            }
+            if( index->data != NULL )
+            {
+                munmap( index->data, index->data_size );
+            }
+            if( index->index_fd != -1 )
+            {
+                close( index->index_fd );
+            }
+            ifq_stop_trace( index );
+        }
+        if( index->fastq_file != NULL )
+        {
+            bgzf_close( index->fastq_file );
+        }
+        free( index->histograms );
+        free( index->fastq_path );
+        memset( index, 0, sizeof( ifq_index_t ) );
+        index->index_fd = -1;
+    }
+}
+
+ifq_codes_t
+ifq_open_reader(const ifq_index_t *index, ifq_index_t *reader)
+{
+    *reader = *index;
+    reader->shared = 1;
+    reader->index_fd = -1;
+    reader->histograms = NULL;
+    reader->num_queries = 0;
+    reader->num_found = 0;
+    reader->fastq_file = bgzf_open( index->fastq_path, "r" );
+    reader->fastq_path = strdup( index->fastq_path );
+    if( reader->fastq_file == NULL || reader->fastq_path == NULL )
+    {
+        ifq_destroy_index( reader );
+        return IFQ_BAD_FASTQ;
+    }
+    bgzf_set_cache_size( reader->fastq_file, index->fastq_file->cache_size );
+
+    if( index->histograms != NULL )
+    {
+        /* As for the index, without memory the queries are not timed */
+        reader->histograms = (ifq_histogram_t *) calloc( IFQ_NUM_STAGES, sizeof( ifq_histogram_t ) );
+    }
+
+    return IFQ_OK;
+}
+
+int
+ifq_get_metadata(ifq_index_t *index, const char *key, char *value, size_t value_size)
+{
+    size_t key_length = strlen( key );
+    const char *line = index->metadata;
+    const char *end = index->metadata + index->metadata_size;
+
+    while( line != NULL && line < end )
+    {
+        const char *line_end = memchr( line, '\n', end - line );
+        if( line_end == NULL )
+        {
+            line_end = end;
+        }
+
+        if( (size_t) ( line_end - line ) > key_length && strncmp( line, key, key_length ) == 0 && line[ key_length ] == '=' )
+        {
+            const char *start = line + key_length + 1;
+            size_t length = line_end - start;
+            if( value_size == 0 || length >= value_size )
+            {
+                return 0;
+            }
+            memcpy( value, start, length );
+            value[ length ] = '\0';
+
+            return 1;
+        }
+
+        line = line_end + 1;
+    }
+
+    return 0;
+}
+
+void
+ifq_get_stats(ifq_index_t *index, ifq_stats_t *stats)
+{
+    memset( stats, 0, sizeof( ifq_stats_t ) );
+    stats->queries = index->num_queries;
+    stats->records_returned = index->num_found;
+    stats->not_found = index->num_queries - index->num_found;
+    stats->table_bytes = index->lookup_size;
+    stats->table_entries = index->num_entries;
+
+    if( index->fastq_file != NULL )
+    {
+        const bgzf_stats_t *io = &index->fastq_file->stats;
+        stats->compressed_bytes_read = (uint64_t) io->compressed_bytes;
+        stats->blocks_inflated = (uint64_t) io->blocks_inflated;
+        stats->cache_hits = (uint64_t) io->cache_hits;
+        stats->cache_misses = (uint64_t) io->cache_misses;
+        stats->cache_evictions = (uint64_t) io->cache_evictions;
+    }
+}
+
+void
+ifq_reset_stats(ifq_index_t *index)
+{
+    index->num_queries = 0;
+    index->num_found = 0;
+    bgzf_reset_stats( index->fastq_file );
+}
+
+static const char *stage_names[ IFQ_NUM_STAGES ] = { "hash", "table", "seek", "inflate", "parse", "total" };
+
+#ifdef IFQ_TIMING
+/**
+ * Returns the time of a monotonic clock in nanoseconds.
+ */
+static uint64_t
+timer_now()
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * Returns the bucket of a value, values below 2^IFQ_HISTOGRAM_SUB_BITS
+ * have their own bucket and larger values share one with the values
+ * that agree in their IFQ_HISTOGRAM_SUB_BITS highest bits.
+ */
+static size_t
+histogram_bucket(uint64_t value)
+{
+    if( value < ( 1 << IFQ_HISTOGRAM_SUB_BITS ) )
+    {
+        return (size_t) value;
+    }
+
+    int shift = 63 - __builtin_clzll( value ) - ( IFQ_HISTOGRAM_SUB_BITS - 1 );
+    size_t bucket = (size_t) shift * ( 1 << ( IFQ_HISTOGRAM_SUB_BITS - 1 ) ) + (size_t) ( value >> shift );
+
+    return bucket < IFQ_HISTOGRAM_BUCKETS ? bucket : IFQ_HISTOGRAM_BUCKETS - 1;
+}
+
+/**
+ * Adds a duration to the histogram of a stage.
+ */
+static void
+record_duration(ifq_index_t *index, ifq_stage_t stage, uint64_t duration)
+{
+    ifq_histogram_t *histogram = &index->histograms[ stage ];
+    histogram->count++;
+    histogram->total_ns += duration;
+    if( duration > histogram->max_ns )
+    {
+        histogram->max_ns = duration;
+    }
+    histogram->counts[ histogram_bucket( duration ) ]++;
+}
+
+/* The clock is only read for indices that are timed, and not at all
+ * when the library is built without IFQ_TIMING */
+#define IFQ_TIMER_NOW( index ) ( ( index )->histograms != NULL ? timer_now( ) : 0 )
+#define IFQ_RECORD( index, stage, duration ) \
+    do { if( ( index )->histograms != NULL ) record_duration( ( index ), ( stage ), ( duration ) ); } while( 0 )
+#define IFQ_INFLATE_NS( index ) ( ( index )->fastq_file->inflate_ns )
+#else
+#define IFQ_TIMER_NOW( index ) ( (uint64_t) 0 )
+#define IFQ_RECORD( index, stage, duration ) ( (void) ( duration ) )
+#define IFQ_INFLATE_NS( index ) ( (int64_t) 0 )
+#endif
+
+const ifq_histogram_t *
+ifq_get_histogram(ifq_index_t *index, ifq_stage_t stage)
+{
+    if( index->histograms == NULL || stage < 0 || stage >= IFQ_NUM_STAGES )
+    {
+        return NULL;
+    }
+
+    return &index->histograms[ stage ];
+}
+
+void
+ifq_reset_histograms(ifq_index_t *index)
+{
+    if( index->histograms != NULL )
+    {
+        memset( index->histograms, 0, sizeof( ifq_histogram_t ) * IFQ_NUM_STAGES );
+    }
+}
+
+const char *
+ifq_stage_name(ifq_stage_t stage)
+{
+    if( stage < 0 || stage >= IFQ_NUM_STAGES )
     {
-        ret = IFQ_BAD_PREFIX;
-        goto index_error;
+        return NULL;
     }
 
-    index->hash = cmph_load( index->hash_file );
-    if( index->hash == NULL )
+    return stage_names[ stage ];
+}
+
+uint64_t
+ifq_histogram_bucket_ns(size_t bucket)
+{
+    const size_t sub_buckets = 1 << ( IFQ_HISTOGRAM_SUB_BITS - 1 );
+    if( bucket < 2 * sub_buckets )
     {
-        ret = IFQ_BAD_HASH;
-        goto index_error;
+        return (uint64_t) bucket;
     }
 
-    index->lookup_fd = open( lookup_path, O_RDWR );
-    if( index->lookup_fd == -1 )
+    return (uint64_t) ( bucket % sub_buckets + sub_buckets ) << ( bucket / sub_buckets - 1 );
+}
+
+uint64_t
+ifq_histogram_quantile(const ifq_histogram_t *histogram, double quantile)
+{
+    if( histogram == NULL || histogram->count == 0 )
     {
-        ret = IFQ_BAD_PREFIX;
-        goto index_error;
+        return 0;
     }
-    
-    struct stat sb;
-    fstat( index->lookup_fd, &sb );
-    index->lookup_size = sb.st_size;
 
-    index->table = (uint64_t *) mmap( NULL, index->lookup_size, PROT_READ, MAP_FILE | MAP_SHARED, index->lookup_fd, 0 );
-    if( index->table == MAP_FAILED )
+    /* The rank of the value, the values of a bucket are reported
+     * as the largest value of the bucket like HdrHistogram does */
+    uint64_t rank = (uint64_t) ( quantile * (double) histogram->count + 0.5 );
+    if( rank < 1 )
     {
-        ret = IFQ_BAD_INDEX;
-        goto index_error;
+        rank = 1;
     }
 
-index_error: 
-    free( hash_path );
-    free( lookup_path );
+    uint64_t seen = 0;
+    size_t i;
+    for(i = 0; i < IFQ_HISTOGRAM_BUCKETS - 1; i++)
+    {
+        seen += histogram->counts[ i ];
+        if( seen >= rank )
+        {
+            uint64_t highest = ifq_histogram_bucket_ns( i + 1 ) - 1;
+            return highest < histogram->max_ns ? highest : histogram->max_ns;
+        }
+    }
 
-    return ret;
+    return histogram->max_ns;
 }
 
-void
-ifq_destroy_index(ifq_index_t *index)
+/**
+ * Makes sure that the record buffer can hold at least
+ * size bytes.
+ *
+ * @param record The record.
+ * @param size The required size in bytes.
+ *
+ * @return 1 if successful, 0 otherwise.
+ */
+int
+reserve_record(ifq_record_t *record, size_t size)
 {
-    if( index != NULL )
+    if( record->buffer_size >= size )
+    {
+        return 1;
+    }
+
+    char *buffer = (char *) realloc( record->buffer, size );
+    if( buffer == NULL )
+    {
+        return 0;
+    }
+    record->buffer = buffer;
+    record->buffer_size = size;
+
+    return 1;
+}
+
+/**
+ * Splits the raw record in the record buffer into its
+ * name, sequence and quality lines.
+ *
+ * @param record The record, the buffer holds length bytes
+ *               followed by a terminating null.
+ * @param length Length of the raw record.
+ *
+ * @return 1 if the record has four lines, 0 otherwise.
+ */
+int
+split_record(ifq_record_t *record, size_t length)
+{
+    char *lines[ 4 ];
+    int num_lines = 1;
+    char *line_end = record->buffer;
+    char *end = record->buffer + length;
+
+    // memchr has its own vector kernels for each processor
+    lines[ 0 ] = record->buffer;
+    while( ( line_end = memchr( line_end, '\n', end - line_end ) ) != NULL )
+    {
+        *line_end++ = '\0';
+        if( num_lines < 4 )
+        {
+            lines[ num_lines++ ] = line_end;
+        }
+    }
+
+    if( num_lines < 4 )
+    {
+        return 0;
+    }
+
+    record->name = lines[ 0 ];
+    record->sequence = lines[ 1 ];
+    record->quality = lines[ 3 ];
+
+    return 1;
+}
+
+/**
+ * Reads the record of an entry in the lookup table.
+ *
+ * @param index The index.
+ * @param entry An entry in the lookup table of the index.
+ * @param record The record is stored here.
+ *
+ * @return 1 if successful, 0 otherwise.
+ */
+int
+read_entry(ifq_index_t *index, ifq_entry_t *entry, ifq_record_t *record)
+{
+    if( entry->length == 0 || reserve_record( record, (size_t) entry->length + 1 ) != 1 )
+    {
+        return 0;
+    }
+
+    // Read the whole record at once
+    uint64_t start = IFQ_TIMER_NOW( index );
+    int64_t inflate_ns = IFQ_INFLATE_NS( index );
+    int length = bgzf_read_range( index->fastq_file, entry->offset, entry->span, record->buffer, entry->length );
+    uint64_t read = IFQ_TIMER_NOW( index );
+    if( length < 0 || (uint32_t) length != entry->length )
+    {
+        return 0;
+    }
+    record->buffer[ length ] = '\0';
+
+    int ok = split_record( record, length );
+
+    inflate_ns = IFQ_INFLATE_NS( index ) - inflate_ns;
+    IFQ_RECORD( index, IFQ_STAGE_SEEK, read - start - (uint64_t) inflate_ns );
+    IFQ_RECORD( index, IFQ_STAGE_INFLATE, (uint64_t) inflate_ns );
+    IFQ_RECORD( index, IFQ_STAGE_PARSE, IFQ_TIMER_NOW( index ) - read );
+
+    return ok;
+}
+
+/**
+ * Logs a read of a query to the trace of the index.
+ *
+ * @param index The index, its trace must be started.
+ * @param fingerprint Fingerprint of the accession of the query.
+ * @param slot The entry that was read, or IFQ_TRACE_NO_SLOT if the
+ *             query read none.
+ * @param found Whether the query returned the record.
+ */
+static void
+trace_read(ifq_index_t *index, uint32_t fingerprint, size_t slot, int found)
+{
+    ifq_trace_record_t trace;
+    memset( &trace, 0, sizeof( ifq_trace_record_t ) );
+    trace.fingerprint = fingerprint;
+    trace.slot = (uint32_t) slot;
+    if( slot != IFQ_TRACE_NO_SLOT )
+    {
+        trace.offset = index->table[ slot ].offset;
+        trace.span = index->table[ slot ].span;
+    }
+    trace.flags = found ? IFQ_TRACE_FOUND : 0;
+
+    fwrite( &trace, sizeof( ifq_trace_record_t ), 1, index->trace );
+}
+
+ifq_codes_t
+ifq_start_trace(ifq_index_t *index, const char *path)
+{
+    ifq_stop_trace( index );
+
+    FILE *trace = fopen( path, "wb" );
+    if( trace == NULL )
+    {
+        return IFQ_BAD_TRACE;
+    }
+
+    ifq_trace_header_t header;
+    ifq_init_trace_header( &header, index->num_entries );
+    if( fwrite( &header, sizeof( ifq_trace_header_t ), 1, trace ) != 1 )
+    {
+        fclose( trace );
+        return IFQ_BAD_TRACE;
+    }
+    index->trace = trace;
+
+    return IFQ_OK;
+}
+
+ifq_codes_t
+ifq_stop_trace(ifq_index_t *index)
+{
+    if( index->trace == NULL )
+    {
+        return IFQ_OK;
+    }
+
+    int failed = ferror( index->trace );
+    failed |= fclose( index->trace ) != 0;
+    index->trace = NULL;
+
+    return failed ? IFQ_BAD_TRACE : IFQ_OK;
+}
+
+ifq_codes_t
+ifq_load_trace(const char *path, ifq_trace_header_t *header, ifq_trace_record_t **records, size_t *num_records)
+{
+    ifq_codes_t ret = IFQ_BAD_TRACE;
+    *records = NULL;
+    *num_records = 0;
+
+    FILE *trace = fopen( path, "rb" );
+    if( trace == NULL )
+    {
+        return IFQ_BAD_TRACE;
+    }
+
+    struct stat sb;
+    if( fread( header, sizeof( ifq_trace_header_t ), 1, trace ) != 1 || ifq_check_trace_header( header ) != 1 ||
+        fstat( fileno( trace ), &sb ) != 0 )
+    {
+        goto trace_done;
+    }
+
+    /* A trace that was cut short loses its partial last record */
+    size_t count = ( (size_t) sb.st_size - sizeof( ifq_trace_header_t ) ) / sizeof( ifq_trace_record_t );
+    *records = (ifq_trace_record_t *) malloc( sizeof( ifq_trace_record_t ) * ( count + 1 ) );
+    if( *records == NULL || fread( *records, sizeof( ifq_trace_record_t ), count, trace ) != count )
     {
-        cmph_destroy( index->hash );
-        munmap( index->table, index->lookup_size );
-        fclose( index->hash_file );
-        bgzf_close( index->fastq_file );
-        close( index->lookup_fd );
+        free( *records );
+        *records = NULL;
+        goto trace_done;
     }
+    *num_records = count;
+    ret = IFQ_OK;
+
+trace_done:
+    fclose( trace );
+    return ret;
 }
 
 ifq_codes_t
 ifq_query_index(ifq_index_t *index, char *query, ifq_record_t *record)
 {
+    ifq_codes_t ret = IFQ_NOT_FOUND;
+    uint64_t start = IFQ_TIMER_NOW( index );
+    uint64_t reading = 0, end;
+    IFQ_PROBE1( query_start, query );
+
     // Find key
-    unsigned int id = cmph_search( index->hash, query, (cmph_uint32) strlen( query ) );
-    uint64_t pos = index->table[ id ];
-    if( bgzf_seek( index->fastq_file, pos, SEEK_SET ) < 0 )
+    size_t query_length = strlen( query );
+    size_t first = (size_t) cmph_search_packed( index->hash, query, (cmph_uint32) query_length ) * index->keys_per_bin;
+    uint64_t hashed = IFQ_TIMER_NOW( index );
+    IFQ_RECORD( index, IFQ_STAGE_HASH, hashed - start );
+    uint32_t fingerprint = ifq_fingerprint( query, query_length );
+    int num_reads = 0;
+    if( first >= index->num_entries )
     {
-        return IFQ_NOT_FOUND;
+        goto query_done;
     }
 
-    cmph_uint32 length;
-    read_one_line( &record->name, &length, index->fastq_file );
-    if( strncmp( record->name, query, length ) == 0 )
+    // Check each entry in the bin, there is only one unless
+    // the hash function maps several keys to each value
+    size_t i;
+    for(i = first; i < first + index->keys_per_bin; i++)
     {
-        read_one_line( &record->sequence, &length, index->fastq_file );
-        read_one_line( &record->quality, &length, index->fastq_file );
-        read_one_line( &record->quality, &length, index->fastq_file );
+        if( index->fingerprints != NULL && index->fingerprints[ i ] != fingerprint )
+        {
+            continue;
+        }
+
+        // Copied so that a page fault on the table counts as a table read
+        ifq_entry_t entry = index->table[ i ];
+        uint64_t read_start = IFQ_TIMER_NOW( index );
+        int found = read_entry( index, &entry, record ) == 1 && strcmp( record->name, query ) == 0;
+        reading += IFQ_TIMER_NOW( index ) - read_start;
+        num_reads++;
+        if( index->trace != NULL )
+        {
+            trace_read( index, fingerprint, i, found );
+        }
+        if( found )
+        {
+            ret = IFQ_OK;
+            break;
+        }
     }
-    else
+
+query_done:
+    index->num_queries++;
+    index->num_found += ret == IFQ_OK;
+    end = IFQ_TIMER_NOW( index );
+    IFQ_RECORD( index, IFQ_STAGE_TABLE, end - hashed - reading );
+    IFQ_RECORD( index, IFQ_STAGE_TOTAL, end - start );
+    IFQ_PROBE2( query_done, query, ret );
+    if( index->trace != NULL && num_reads == 0 )
+    {
+        trace_read( index, fingerprint, IFQ_TRACE_NO_SLOT, 0 );
+    }
+
+    return ret;
+}
+
+ifq_codes_t
+ifq_read_slot(ifq_index_t *index, size_t slot, ifq_record_t *record)
+{
+    if( slot >= index->num_entries )
     {
         return IFQ_NOT_FOUND;
     }
 
-    return IFQ_OK;
+    ifq_entry_t entry = index->table[ slot ];
+    return read_entry( index, &entry, record ) == 1 ? IFQ_OK : IFQ_NOT_FOUND;
+}
+
+/**
+ * Number of queries that are hashed, prefetched and resolved to
+ * an entry together by ifq_query_many, bounds its memory use.
+ */
+#define QUERY_MANY_CHUNK 4096
+
+#if defined(__GNUC__)
+#define IFQ_PREFETCH( addr ) __builtin_prefetch( ( addr ), 0, 3 )
+#else
+#define IFQ_PREFETCH( addr ) ( (void) ( addr ) )
+#endif
+
+/**
+ * A query of ifq_query_many together with the first entry of its
+ * bin whose fingerprint matches.
+ */
+typedef struct pending_read
+{
+    uint64_t offset;
+    size_t query;
+    size_t entry;
+} pending_read_t;
+
+static int
+compare_pending_reads(const void *a, const void *b)
+{
+    uint64_t offset_a = ( (const pending_read_t *) a )->offset;
+    uint64_t offset_b = ( (const pending_read_t *) b )->offset;
+    return ( offset_a > offset_b ) - ( offset_a < offset_b );
+}
+
+/**
+ * Finds the entries of a chunk of queries, the bins of all queries
+ * are prefetched before any of them is compared.
+ *
+ * @return The number of queries with a candidate entry, which are
+ *         stored in pending.
+ */
+static size_t
+find_entries(ifq_index_t *index, char **queries, size_t num_queries, ifq_codes_t *results,
+             const char **keys, cmph_uint32 *lengths, cmph_uint32 *values, pending_read_t *pending)
+{
+    size_t i, j, num_pending = 0;
+    for(i = 0; i < num_queries; i++)
+    {
+        keys[ i ] = queries[ i ];
+        lengths[ i ] = (cmph_uint32) strlen( queries[ i ] );
+    }
+    cmph_search_many_packed( index->hash, (cmph_uint32) num_queries, keys, lengths, values );
+
+    for(i = 0; i < num_queries; i++)
+    {
+        size_t first = (size_t) values[ i ] * index->keys_per_bin;
+        if( first < index->num_entries )
+        {
+            IFQ_PREFETCH( &index->table[ first ] );
+            if( index->fingerprints != NULL )
+            {
+                IFQ_PREFETCH( &index->fingerprints[ first ] );
+            }
+        }
+    }
+
+    for(i = 0; i < num_queries; i++)
+    {
+        size_t first = (size_t) values[ i ] * index->keys_per_bin;
+        results[ i ] = IFQ_NOT_FOUND;
+        if( first >= index->num_entries )
+        {
+            continue;
+        }
+
+        uint32_t fingerprint = ifq_fingerprint( queries[ i ], lengths[ i ] );
+        for(j = first; j < first + index->keys_per_bin; j++)
+        {
+            if( index->fingerprints == NULL || index->fingerprints[ j ] == fingerprint )
+            {
+                pending[ num_pending ].offset = index->table[ j ].offset;
+                pending[ num_pending ].query = i;
+                pending[ num_pending ].entry = j;
+                num_pending++;
+                break;
+            }
+        }
+    }
+
+    return num_pending;
+}
+
+/**
+ * Logs the queries of a chunk of ifq_query_many that read no
+ * record to the trace of the index, the hash values of the chunk
+ * are overwritten.
+ */
+static void
+trace_unread(ifq_index_t *index, char **queries, size_t num_queries, const cmph_uint32 *lengths, cmph_uint32 *values,
+             const pending_read_t *pending, size_t num_pending)
+{
+    size_t i;
+    for(i = 0; i < num_pending; i++)
+    {
+        values[ pending[ i ].query ] = IFQ_TRACE_NO_SLOT;
+    }
+
+    for(i = 0; i < num_queries; i++)
+    {
+        if( values[ i ] != IFQ_TRACE_NO_SLOT )
+        {
+            trace_read( index, ifq_fingerprint( queries[ i ], lengths[ i ] ), IFQ_TRACE_NO_SLOT, 0 );
+        }
+    }
+}
+
+size_t
+ifq_query_many(ifq_index_t *index, char **queries, size_t num_queries, ifq_record_t **records, ifq_codes_t *results)
+{
+    size_t i, j, start, count, num_found = 0;
+    const char **keys = (const char **) malloc( sizeof( char * ) * QUERY_MANY_CHUNK );
+    cmph_uint32 *lengths = (cmph_uint32 *) malloc( sizeof( cmph_uint32 ) * QUERY_MANY_CHUNK );
+    cmph_uint32 *values = (cmph_uint32 *) malloc( sizeof( cmph_uint32 ) * QUERY_MANY_CHUNK );
+    pending_read_t *pending = (pending_read_t *) malloc( sizeof( pending_read_t ) * QUERY_MANY_CHUNK );
+    IFQ_PROBE2( query_many_start, queries, num_queries );
+    if( keys == NULL || lengths == NULL || values == NULL || pending == NULL )
+    {
+        /* Still answer the queries, only slower */
+        for(i = 0; i < num_queries; i++)
+        {
+            results[ i ] = ifq_query_index( index, queries[ i ], records[ i ] );
+            num_found += results[ i ] == IFQ_OK;
+        }
+        goto cleanup;
+    }
+
+    for(start = 0; start < num_queries; start += count)
+    {
+        count = num_queries - start < QUERY_MANY_CHUNK ? num_queries - start : QUERY_MANY_CHUNK;
+        size_t num_pending = find_entries( index, queries + start, count, results + start,
+                                           keys, lengths, values, pending );
+
+        /* Read the records in file order, so that records sharing a
+         * block are decompressed once and the file is read forwards */
+        qsort( pending, num_pending, sizeof( pending_read_t ), compare_pending_reads );
+        for(i = 0; i < num_pending; i++)
+        {
+            size_t query = start + pending[ i ].query;
+            size_t first = (size_t) values[ pending[ i ].query ] * index->keys_per_bin;
+            uint32_t fingerprint = index->fingerprints != NULL ? index->fingerprints[ pending[ i ].entry ] : 0;
+
+            /* Fingerprints can collide, then the later entries of the bin are checked */
+            for(j = pending[ i ].entry; j < first + index->keys_per_bin; j++)
+            {
+                if( index->fingerprints != NULL && index->fingerprints[ j ] != fingerprint )
+                {
+                    continue;
+                }
+
+                int found = read_entry( index, &index->table[ j ], records[ query ] ) == 1 &&
+                            strcmp( records[ query ]->name, queries[ query ] ) == 0;
+                if( index->trace != NULL )
+                {
+                    trace_read( index, ifq_fingerprint( queries[ query ], lengths[ pending[ i ].query ] ), j, found );
+                }
+                if( found )
+                {
+                    results[ query ] = IFQ_OK;
+                    num_found++;
+                    break;
+                }
+            }
+        }
+
+        if( index->trace != NULL )
+        {
+            trace_unread( index, queries + start, count, lengths, values, pending, num_pending );
+        }
+    }
+    index->num_queries += num_queries;
+    index->num_found += num_found;
+
+cleanup:
+    free( keys );
+    free( lengths );
+    free( values );
+    free( pending );
+    IFQ_PROBE2( query_many_done, num_queries, num_found );
+    return num_found;
+}
+
+/**
+ * Reads ahead the pages that hold a range of memory of the index.
+ */
+static void
+advise_pages(const void *address, size_t length, long page_size)
+{
+    uintptr_t first = (uintptr_t) address & ~( (uintptr_t) page_size - 1 );
+    uintptr_t last = (uintptr_t) address + length;
+    madvise( (void *) first, last - first, MADV_WILLNEED );
+}
+
+void
+ifq_prefetch(ifq_index_t *index, char **queries, size_t num_queries)
+{
+    size_t i, j;
+    long page_size = sysconf( _SC_PAGESIZE );
+    size_t *ids = (size_t *) malloc( sizeof( size_t ) * num_queries );
+    uint32_t *fingerprints = (uint32_t *) malloc( sizeof( uint32_t ) * num_queries );
+    if( ids == NULL || fingerprints == NULL )
+    {
+        free( ids );
+        free( fingerprints );
+        return;
+    }
+
+    /* Start reading the lookup table pages in the background, queries
+     * that hash outside the table are not in the index and are skipped */
+    for(i = 0; i < num_queries; i++)
+    {
+        size_t query_length = strlen( queries[ i ] );
+        ids[ i ] = (size_t) cmph_search_packed( index->hash, queries[ i ], (cmph_uint32) query_length ) * index->keys_per_bin;
+        fingerprints[ i ] = ifq_fingerprint( queries[ i ], query_length );
+        if( ids[ i ] >= index->num_entries )
+        {
+            ids[ i ] = SIZE_MAX;
+            continue;
+        }
+
+        advise_pages( &index->table[ ids[ i ] ], sizeof( ifq_entry_t ) * index->keys_per_bin, page_size );
+        if( index->fingerprints != NULL )
+        {
+            advise_pages( &index->fingerprints[ ids[ i ] ], sizeof( uint32_t ) * index->keys_per_bin, page_size );
+        }
+    }
+
+#ifdef POSIX_FADV_WILLNEED
+    /* Then ask for the compressed blocks of the records, reading the
+     * entries faults in the pages that are not in memory yet, which the
+     * caller can afford since it runs ahead of the queries */
+    for(i = 0; i < num_queries; i++)
+    {
+        if( ids[ i ] == SIZE_MAX )
+        {
+            continue;
+        }
+
+        for(j = ids[ i ]; j < ids[ i ] + index->keys_per_bin; j++)
+        {
+            if( index->fingerprints != NULL && index->fingerprints[ j ] != fingerprints[ i ] )
+            {
+                continue;
+            }
+
+            /* A zero length would advise up to the end of the file */
+            ifq_entry_t *entry = &index->table[ j ];
+            if( entry->span == 0 )
+            {
+                continue;
+            }
+            off_t block_address = (off_t) ( entry->offset >> 16 );
+            posix_fadvise( index->fastq_file->file_descriptor, block_address, entry->span, POSIX_FADV_WILLNEED );
+        }
+    }
+#endif
+
+    free( ids );
+    free( fingerprints );
 }
 
 ifq_record_t *
@@ -393,6 +2301,8 @@ ifq_new_record()
     ifq_record_t *record = (ifq_record_t *) malloc( sizeof( ifq_record_t ) );
     if( record != NULL )
     {
+        record->buffer = NULL;
+        record->buffer_size = 0;
         record->name = NULL;
         record->sequence = NULL;
         record->quality = NULL;
@@ -410,17 +2320,7 @@ ifq_destroy_record(ifq_record_t *record)
 {
     if( record != NULL )
     {
-        if( record->name != NULL )
-        {
-            free( record->name );
-        }
-        if( record->sequence != NULL )
-        {
-            free( record->sequence );
-        }
-        if( record->quality != NULL )
-        {
-            free( record->quality );
-        }
+        free( record->buffer );
+        free( record );
     }
 }
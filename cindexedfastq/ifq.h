@@ -3,6 +3,7 @@
 
 #include <cmph.h>
 #include <bgzf.h>
+#include <ifq_format.h>
 
 typedef enum
 {
@@ -34,12 +35,159 @@ typedef enum
     /**
      * Could not find the record that was searched for.
      */
-    IFQ_NOT_FOUND
+    IFQ_NOT_FOUND,
+
+    /**
+     * Unable to lock the index in memory.
+     */
+    IFQ_BAD_LOCK,
+
+    /**
+     * Unable to write or read a query trace, or the trace is
+     * of another index.
+     */
+    IFQ_BAD_TRACE
 } ifq_codes_t;
 
+/**
+ * Flags that control how the lookup table is brought into
+ * memory when an index is opened, they can be combined.
+ */
+typedef enum
+{
+    /**
+     * Map the table lazily, pages are read on first access.
+     */
+    IFQ_OPEN_DEFAULT = 0,
+
+    /**
+     * Read the whole index into memory when opening, so that
+     * no query takes a page fault.
+     */
+    IFQ_OPEN_POPULATE = 1,
+
+    /**
+     * Lock the index in memory so that the hash function, table
+     * and fingerprints are never paged out, requires a sufficient
+     * RLIMIT_MEMLOCK.
+     */
+    IFQ_OPEN_LOCK = 2,
+
+    /**
+     * Copy the hash function, table and fingerprints into private
+     * memory backed by transparent huge pages, which reduces TLB
+     * misses for large tables at the cost of not sharing the pages
+     * between processes.
+     */
+    IFQ_OPEN_HUGEPAGES = 4,
+
+    /**
+     * Check the checksums of all sections of the index file,
+     * this reads the whole file.
+     */
+    IFQ_OPEN_VERIFY = 8,
+
+    /**
+     * Record how long each stage of ifq_query_index takes in
+     * histograms, see ifq_get_histogram. Has no effect unless
+     * the library is built with IFQ_TIMING defined.
+     */
+    IFQ_OPEN_TIMING = 16
+} ifq_open_flags_t;
+
+/**
+ * Stages of a query that are timed with IFQ_OPEN_TIMING.
+ */
+typedef enum
+{
+    /**
+     * Hashing the accession with the perfect hash function.
+     */
+    IFQ_STAGE_HASH,
+
+    /**
+     * Reading the fingerprints and entries of the bin, this is
+     * where the page faults of a lazily mapped table are taken.
+     */
+    IFQ_STAGE_TABLE,
+
+    /**
+     * Seeking in the fastq file and reading the compressed
+     * blocks of the record.
+     */
+    IFQ_STAGE_SEEK,
+
+    /**
+     * Decompressing the blocks that were not cached, zero when
+     * all of them were.
+     */
+    IFQ_STAGE_INFLATE,
+
+    /**
+     * Splitting the record into its lines.
+     */
+    IFQ_STAGE_PARSE,
+
+    /**
+     * The whole query.
+     */
+    IFQ_STAGE_TOTAL,
+
+    IFQ_NUM_STAGES
+} ifq_stage_t;
+
+/**
+ * Values below 2^IFQ_HISTOGRAM_SUB_BITS nanoseconds are counted
+ * exactly, larger values in buckets of 1/16 of their power of two.
+ */
+#define IFQ_HISTOGRAM_SUB_BITS 5
+
+/**
+ * Number of buckets in a histogram, the last one also counts
+ * every value of 2^41 nanoseconds (37 minutes) or more.
+ */
+#define IFQ_HISTOGRAM_BUCKETS 608
+
+/**
+ * A histogram of durations in the style of HdrHistogram, with
+ * a relative precision of about 6% over the whole range.
+ */
+typedef struct ifq_histogram
+{
+    /**
+     * Number of recorded values.
+     */
+    uint64_t count;
+
+    /**
+     * Sum of the recorded values in nanoseconds.
+     */
+    uint64_t total_ns;
+
+    /**
+     * Largest recorded value in nanoseconds.
+     */
+    uint64_t max_ns;
+
+    /**
+     * Number of values in each bucket, see ifq_histogram_bucket_ns.
+     */
+    uint64_t counts[ IFQ_HISTOGRAM_BUCKETS ];
+} ifq_histogram_t;
+
 
 typedef struct ifq_record
 {
+    /**
+     * Holds the whole record, the fields below point into it.
+     */
+    char *buffer;
+
+    /**
+     * Allocated size of the buffer in bytes.
+     */
+    size_t buffer_size;
+
     /**
      * Sequence accession.
      */
@@ -56,12 +204,42 @@ typedef struct ifq_record
     char *quality;
 } ifq_record_t;
 
+/**
+ * An entry in the lookup table, describes where a record
+ * is located in the compressed fastq file.
+ */
+typedef struct ifq_entry
+{
+    /**
+     * Virtual offset of the record, just after the leading '@'.
+     */
+    uint64_t offset;
+
+    /**
+     * Uncompressed length of the record in bytes, up to and
+     * including the newline that ends the quality line.
+     */
+    uint32_t length;
+
+    /**
+     * Number of compressed bytes occupied by the blocks that
+     * hold the record, counted from the block of the offset.
+     */
+    uint32_t span;
+} ifq_entry_t;
+
 typedef struct ifq_index
 {
     /**
-     * Perfect hash function.
+     * Perfect hash function packed by cmph_pack, points
+     * into the mapped index file.
+     */
+    void *hash;
+
+    /**
+     * Size of the packed hash function in bytes.
      */
-    cmph_t *hash;
+    size_t hash_size;
 
     /**
      * Compressed fastq file.
@@ -69,30 +247,334 @@ typedef struct ifq_index
     BGZF *fastq_file;
 
     /**
-     * File that contains the hash function.
+     * Path of the compressed fastq file, readers open it again.
      */
-    FILE *hash_file;
+    char *fastq_path;
 
     /**
-     * File that contains the mapping from hash value
-     * to seek position.
+     * 1 if this is a reader from ifq_open_reader, whose mapping
+     * and trace belong to another index, 0 otherwise.
      */
-    int lookup_fd;
+    int shared;
 
     /**
-     * Mapping from hash value to seek position.
+     * File that contains the index.
      */
-    uint64_t *table;
+    int index_fd;
+
+    /**
+     * The whole index file mapped into memory.
+     */
+    void *data;
+
+    /**
+     * Size of the index file in bytes.
+     */
+    size_t data_size;
+
+    /**
+     * Mapping from hash value to record location.
+     */
+    ifq_entry_t *table;
+
+    /**
+     * Number of entries in the lookup table.
+     */
+    size_t num_entries;
+
+    /**
+     * Number of entries per hash value, the hash function may map
+     * up to this many accessions to the same value.
+     */
+    cmph_uint32 keys_per_bin;
 
     /**
      * Size of the lookup table in bytes.
      */
-    off_t lookup_size;
+    size_t lookup_size;
+
+    /**
+     * The hash function, table and fingerprints copied out of the
+     * index file into private memory, or NULL if they are mapped.
+     */
+    void *private_data;
+
+    /**
+     * Size of the private copy in bytes.
+     */
+    size_t private_size;
+
+    /**
+     * Fingerprint of the accession of every entry, or NULL if
+     * the index has none.
+     */
+    uint32_t *fingerprints;
+
+    /**
+     * Metadata of the index, key=value lines that are not
+     * null terminated.
+     */
+    const char *metadata;
+
+    /**
+     * Size of the metadata in bytes.
+     */
+    size_t metadata_size;
+
+    /**
+     * A histogram for every ifq_stage_t when the index was opened
+     * with IFQ_OPEN_TIMING, NULL otherwise.
+     */
+    ifq_histogram_t *histograms;
+
+    /**
+     * Number of queries since the index was opened or its
+     * stats were reset.
+     */
+    uint64_t num_queries;
+
+    /**
+     * Number of those queries that returned a record.
+     */
+    uint64_t num_found;
+
+    /**
+     * The query trace that the reads are logged to, NULL unless
+     * ifq_start_trace was called.
+     */
+    FILE *trace;
 } ifq_index_t;
 
 /**
- * Create a new index at the given prefix, a .hsh and .lup file
- * will be created with the given prefix.
+ * Counters of an open index, see ifq_get_stats.
+ */
+typedef struct ifq_stats
+{
+    /**
+     * Number of queries by ifq_query_index and ifq_query_many.
+     */
+    uint64_t queries;
+
+    /**
+     * Number of queries that returned a record.
+     */
+    uint64_t records_returned;
+
+    /**
+     * Number of queries whose accession was not in the index.
+     */
+    uint64_t not_found;
+
+    /**
+     * Number of bytes read from the compressed fastq file.
+     */
+    uint64_t compressed_bytes_read;
+
+    /**
+     * Number of blocks that were decompressed.
+     */
+    uint64_t blocks_inflated;
+
+    /**
+     * Number of blocks that were still decompressed from the
+     * previous read or were found in the block cache.
+     */
+    uint64_t cache_hits;
+
+    /**
+     * Number of blocks that had to be decompressed.
+     */
+    uint64_t cache_misses;
+
+    /**
+     * Number of blocks that were evicted from the block cache.
+     */
+    uint64_t cache_evictions;
+
+    /**
+     * Size of the lookup table in bytes.
+     */
+    uint64_t table_bytes;
+
+    /**
+     * Number of entries in the lookup table.
+     */
+    uint64_t table_entries;
+} ifq_stats_t;
+
+/**
+ * Events of an index build, see ifq_build_callback_t.
+ */
+typedef enum
+{
+    /**
+     * A phase starts, phases of CHD_PH that are retried start
+     * once for each attempt.
+     */
+    IFQ_BUILD_PHASE_START,
+
+    /**
+     * A phase ends, its measurements include the new attempt.
+     */
+    IFQ_BUILD_PHASE_END,
+
+    /**
+     * Part of a long phase is done, the count and populate
+     * phases report this every few seconds.
+     */
+    IFQ_BUILD_PROGRESS
+} ifq_build_event_t;
+
+/**
+ * Measurements of a phase of an index build. The phases are
+ * "count" (counting the records), "hash" (reading the accessions
+ * and building the perfect hash function), the steps of CHD and
+ * CHD_PH within it: "mapping", "ordering", "searching" (placing
+ * the buckets), "compressing" and "ranking", and "populate"
+ * (filling in and writing the lookup table).
+ */
+typedef struct ifq_build_phase
+{
+    /**
+     * Name of the phase.
+     */
+    const char *name;
+
+    /**
+     * Number of times the phase was started.
+     */
+    uint32_t runs;
+
+    /**
+     * Elapsed time in the phase.
+     */
+    double wall_seconds;
+
+    /**
+     * Processor time of the process in the phase.
+     */
+    double cpu_seconds;
+
+    /**
+     * Peak resident size of the process in kilobytes when the
+     * phase last ended, it never decreases from phase to phase.
+     */
+    uint64_t peak_rss_kb;
+
+    /**
+     * Number of bytes decompressed from the fastq file in the phase.
+     */
+    uint64_t bytes_decompressed;
+} ifq_build_phase_t;
+
+/**
+ * Receives the events of an index build.
+ *
+ * @param data The callback_data of the options.
+ * @param event What happened.
+ * @param phase The phase that the event belongs to.
+ * @param done For IFQ_BUILD_PROGRESS the amount that is done.
+ * @param total For IFQ_BUILD_PROGRESS the total amount, compressed
+ *              bytes for the count phase and records for populate.
+ */
+typedef void (*ifq_build_callback_t)(void *data, ifq_build_event_t event, const ifq_build_phase_t *phase,
+                                     uint64_t done, uint64_t total);
+
+/**
+ * Options that control how the perfect hash function of an
+ * index is built. The algorithms trade build time, lookup time
+ * and index size against each other, a zero parameter selects
+ * the default of the algorithm.
+ */
+typedef struct ifq_options
+{
+    /**
+     * Algorithm used to build the perfect hash function. BMZ8 is
+     * not supported since it holds at most 256 keys.
+     */
+    CMPH_ALGO algorithm;
+
+    /**
+     * Hash function that the keys are hashed with before the
+     * perfect hash function is applied.
+     */
+    CMPH_HASH hash;
+
+    /**
+     * Average number of keys per bucket for CHD and CHD_PH,
+     * bits per displacement group for BDZ and the maximum
+     * bucket size for BRZ.
+     */
+    cmph_uint32 b;
+
+    /**
+     * Number of keys per bin for CHD_PH, values from 2 to 127 give
+     * a smaller function that maps several keys to each value, the
+     * lookup table then holds this many entries per value. The
+     * other algorithms take only 0 or 1.
+     */
+    cmph_uint32 keys_per_bin;
+
+    /**
+     * Graph size relative to the number of keys for BMZ, CHM,
+     * BDZ and BDZ_PH, bits per key for FCH, the load factor
+     * for CHD and CHD_PH, and for BRZ values below 2 select BMZ8
+     * and above select FCH for the buckets.
+     */
+    double graph_size;
+
+    /**
+     * Directory for the temporary files of BRZ, or NULL for
+     * the default of cmph.
+     */
+    char *tmp_dir;
+
+    /**
+     * Called with the phases and progress of the build, or NULL.
+     */
+    ifq_build_callback_t callback;
+
+    /**
+     * Passed to the callback.
+     */
+    void *callback_data;
+
+    /**
+     * Path of a file that a JSON summary of the phases of the
+     * build is written to, or NULL.
+     */
+    char *profile_path;
+} ifq_options_t;
+
+/**
+ * Fill in the default options, CHD with its default parameters
+ * and the Jenkins hash function.
+ *
+ * @param options The options.
+ */
+void ifq_default_options(ifq_options_t *options);
+
+/**
+ * Find the algorithm with the given name.
+ *
+ * @param name Name of an algorithm as in cmph_names, e.g. "chd".
+ *
+ * @return The algorithm or CMPH_COUNT if there is none.
+ */
+CMPH_ALGO ifq_parse_algorithm(const char *name);
+
+/**
+ * Find the hash function with the given name.
+ *
+ * @param name Name of a hash function as in cmph_hash_names, e.g. "mum".
+ *
+ * @return The hash function or CMPH_HASH_COUNT if there is none.
+ */
+CMPH_HASH ifq_parse_hash(const char *name);
+
+/**
+ * Create a new index at the given prefix, the index is stored
+ * in a single file named prefix.ifq.
  *
  * @param fastq_path Path to the bgzipped fastq file.
  * @apram index_prefix The prefix path of the index.
@@ -103,6 +585,142 @@ typedef struct ifq_index
  */
 ifq_codes_t ifq_create_index(char *fastq_path, char *index_prefix);
 
+/**
+ * Create a new index at the given prefix with the given options,
+ * the parameters that the hash function is built with, after the
+ * defaults of the algorithm are applied, are recorded in the
+ * metadata of the index.
+ *
+ * @param fastq_path Path to the bgzipped fastq file.
+ * @param index_prefix The prefix path of the index.
+ * @param options Options for building the hash function.
+ *
+ * @return IFQ_OK if successful, IFQ_BAD_FASTQ if the fastq file
+ *         could not be opened, IFQ_BAD_HASH if the hash function
+ *         could not be built with the options, IFQ_BAD_PREFIX if
+ *         the index or the profile could not be created.
+ */
+ifq_codes_t ifq_create_index_with_options(char *fastq_path, char *index_prefix, const ifq_options_t *options);
+
+/**
+ * What the tuner should optimize for.
+ */
+typedef enum
+{
+    /**
+     * Smallest lookup time.
+     */
+    IFQ_TUNE_LOOKUP = 0,
+
+    /**
+     * Smallest index, the hash function, lookup table and
+     * fingerprints together.
+     */
+    IFQ_TUNE_SIZE = 1,
+
+    /**
+     * Smallest build time.
+     */
+    IFQ_TUNE_BUILD = 2
+} ifq_tune_goal_t;
+
+/**
+ * Target of the tuner, the best setting for the goal is picked
+ * among those that meet the limits. A limit of zero is ignored.
+ */
+typedef struct ifq_tune_target
+{
+    /**
+     * What to optimize for.
+     */
+    ifq_tune_goal_t goal;
+
+    /**
+     * Maximum size of the hash function in bits per key.
+     */
+    double max_bits_per_key;
+
+    /**
+     * Maximum lookup time in nanoseconds.
+     */
+    double max_lookup_ns;
+
+    /**
+     * Number of accessions from the start of the fastq file
+     * that the settings are measured on.
+     */
+    size_t sample_size;
+} ifq_tune_target_t;
+
+/**
+ * Measurements of one setting tried by the tuner, on the sample.
+ */
+typedef struct ifq_tune_result
+{
+    /**
+     * The setting.
+     */
+    ifq_options_t options;
+
+    /**
+     * 1 if the hash function could be built, otherwise the
+     * measurements are zero.
+     */
+    int built;
+
+    /**
+     * Time to build the hash function in seconds.
+     */
+    double build_seconds;
+
+    /**
+     * Size of the packed hash function in bits per key.
+     */
+    double bits_per_key;
+
+    /**
+     * Size of the lookup table and fingerprints in bytes per key.
+     */
+    double table_bytes_per_key;
+
+    /**
+     * Average time to hash an accession and find it among the
+     * fingerprints of its bin, in nanoseconds.
+     */
+    double lookup_ns;
+} ifq_tune_result_t;
+
+/**
+ * Fill in the default target, the fastest lookup without limits
+ * measured on 50000 accessions.
+ *
+ * @param target The target.
+ */
+void ifq_default_tune_target(ifq_tune_target_t *target);
+
+/**
+ * Find options for ifq_create_index_with_options that meet the
+ * target. CHD and CHD_PH are built on a sample of the accessions
+ * over a grid of b, load factor and keys per bin, and each build
+ * is measured. Lookups are timed on the sample, so they are
+ * faster than on a full index that does not fit in the cache,
+ * but the order between the settings is kept.
+ *
+ * @param fastq_path Path to the bgzipped fastq file.
+ * @param target The target.
+ * @param options The best options are stored here, the hash
+ *                function set in them is used for all settings.
+ * @param results If not NULL, a malloc:ed array with the
+ *                measurements of every setting is stored here.
+ * @param num_results If not NULL, the number of results.
+ *
+ * @return IFQ_OK if successful, IFQ_BAD_FASTQ if the fastq file
+ *         could not be read, IFQ_BAD_HASH if the hash function
+ *         is unknown or no setting meets the target.
+ */
+ifq_codes_t ifq_tune_options(char *fastq_path, const ifq_tune_target_t *target, ifq_options_t *options,
+                             ifq_tune_result_t **results, size_t *num_results);
+
 /**
  * Open an existing index.
  *
@@ -112,10 +730,26 @@ ifq_codes_t ifq_create_index(char *fastq_path, char *index_prefix);
  *
  * @return IFQ_OK if successful, IFQ_BAD_FASTQ if the fastq file
  *         could not be opened, IFQ_BAD_PREFIX if the index could
- *         not be opened.
+ *         not be opened, IFQ_BAD_INDEX if it is not a valid index.
  */
 ifq_codes_t ifq_open_index(char *fastq_path, char *index_prefix, ifq_index_t *index);
 
+/**
+ * Open an existing index and control how the lookup table
+ * is brought into memory.
+ *
+ * @apram fastq_path Path to the bgzipped fastq file.
+ * @param index_prefix The prefix path of the index.
+ * @param flags A combination of ifq_open_flags_t.
+ * @param index The index.
+ *
+ * @return IFQ_OK if successful, IFQ_BAD_FASTQ if the fastq file
+ *         could not be opened, IFQ_BAD_PREFIX if the index could
+ *         not be opened, IFQ_BAD_LOCK if the table could not be
+ *         locked in memory.
+ */
+ifq_codes_t ifq_open_index_with_flags(char *fastq_path, char *index_prefix, int flags, ifq_index_t *index);
+
 /**
  * Close an opened index along with its allocated memory.
  *
@@ -123,6 +757,35 @@ ifq_codes_t ifq_open_index(char *fastq_path, char *index_prefix, ifq_index_t *in
  */
 void ifq_destroy_index(ifq_index_t *index);
 
+/**
+ * Opens another reader of an open index. It shares the mapped
+ * hash function and lookup table with the index, and has its own
+ * handle of the fastq file, counters and histograms, so that
+ * queries on different readers can run in parallel. It logs to
+ * the trace of the index if that was started. Close it with
+ * ifq_destroy_index before the index.
+ *
+ * @param index An opened index.
+ * @param reader The reader.
+ *
+ * @return IFQ_OK if successful, IFQ_BAD_FASTQ if the fastq file
+ *         could not be opened again.
+ */
+ifq_codes_t ifq_open_reader(const ifq_index_t *index, ifq_index_t *reader);
+
+/**
+ * Look up a value in the metadata of the index.
+ *
+ * @param index The index.
+ * @param key The key to look up.
+ * @param value The value will be stored here, null terminated.
+ * @param value_size Size of the value buffer.
+ *
+ * @return 1 if the key was found and the value fit in the
+ *         buffer, 0 otherwise.
+ */
+int ifq_get_metadata(ifq_index_t *index, const char *key, char *value, size_t value_size);
+
 /**
  * Query the index to find the desired fastq record.
  *
@@ -134,6 +797,149 @@ void ifq_destroy_index(ifq_index_t *index);
  */
 ifq_codes_t ifq_query_index(ifq_index_t *index, char *query, ifq_record_t *record);
 
+/**
+ * Reads the record of an entry of the lookup table, as the queries
+ * of a trace are replayed.
+ *
+ * @param index The index.
+ * @param slot The entry of the lookup table.
+ * @param record A record, output will be stored here.
+ *
+ * @return IFQ_OK if successful, IFQ_NOT_FOUND if the entry is
+ *         empty or could not be read.
+ */
+ifq_codes_t ifq_read_slot(ifq_index_t *index, size_t slot, ifq_record_t *record);
+
+/**
+ * Starts logging the queries of an index to a trace file, see
+ * ifq_trace_record_t. A trace that was already started is stopped.
+ *
+ * @param index The index.
+ * @param path Path of the trace file, it is overwritten.
+ *
+ * @return IFQ_OK if successful, IFQ_BAD_TRACE if the trace
+ *         could not be created.
+ */
+ifq_codes_t ifq_start_trace(ifq_index_t *index, const char *path);
+
+/**
+ * Stops logging the queries of an index and closes the trace.
+ *
+ * @param index The index.
+ *
+ * @return IFQ_OK if successful, IFQ_BAD_TRACE if the trace
+ *         could not be written.
+ */
+ifq_codes_t ifq_stop_trace(ifq_index_t *index);
+
+/**
+ * Reads a whole trace into memory.
+ *
+ * @param path Path of the trace file.
+ * @param header The header of the trace is stored here.
+ * @param records The records are stored here, free them with free.
+ * @param num_records The number of records is stored here.
+ *
+ * @return IFQ_OK if successful, IFQ_BAD_TRACE if the trace
+ *         could not be read or is invalid.
+ */
+ifq_codes_t ifq_load_trace(const char *path, ifq_trace_header_t *header, ifq_trace_record_t **records, size_t *num_records);
+
+/**
+ * Query the index for many records at once. The keys are hashed
+ * in groups whose cache misses overlap, and the records are read
+ * in the order they appear in the fastq file rather than in the
+ * order of the queries, which is much faster than calling
+ * ifq_query_index for each of them.
+ *
+ * @param index The index.
+ * @param queries The accessions of the records to find.
+ * @param num_queries The number of accessions.
+ * @param records One record per query, output will be stored here.
+ * @param results Receives IFQ_OK or IFQ_NOT_FOUND for each query.
+ *
+ * @return The number of records that were found.
+ */
+size_t ifq_query_many(ifq_index_t *index, char **queries, size_t num_queries, ifq_record_t **records, ifq_codes_t *results);
+
+/**
+ * Hint that the given accessions will be queried soon. The pages
+ * of the lookup table and fingerprints that hold them are read ahead,
+ * and the kernel is asked to read ahead the compressed blocks of the
+ * records, so that later calls to ifq_query_index do not stall on
+ * disk. The call itself may wait for the index pages.
+ *
+ * @param index The index.
+ * @param queries The accessions that will be queried.
+ * @param num_queries The number of accessions.
+ */
+void ifq_prefetch(ifq_index_t *index, char **queries, size_t num_queries);
+
+/**
+ * Returns the counters of an index. The query counters are kept
+ * since the index was opened, the I/O and cache counters since
+ * the fastq file was opened, both until ifq_reset_stats.
+ *
+ * @param index The index.
+ * @param stats The counters are stored here.
+ */
+void ifq_get_stats(ifq_index_t *index, ifq_stats_t *stats);
+
+/**
+ * Clears the query, I/O and cache counters of an index.
+ *
+ * @param index The index.
+ */
+void ifq_reset_stats(ifq_index_t *index);
+
+/**
+ * Returns the histogram of a stage of the queries on an index.
+ * Stages that read records also count the reads of ifq_query_many.
+ *
+ * @param index The index.
+ * @param stage The stage.
+ *
+ * @return The histogram, or NULL if the index was not opened with
+ *         IFQ_OPEN_TIMING or the library was built without it.
+ */
+const ifq_histogram_t *ifq_get_histogram(ifq_index_t *index, ifq_stage_t stage);
+
+/**
+ * Clears the histograms of an index.
+ *
+ * @param index The index.
+ */
+void ifq_reset_histograms(ifq_index_t *index);
+
+/**
+ * Returns the name of a stage, e.g. "inflate".
+ *
+ * @param stage The stage.
+ *
+ * @return The name, or NULL for an unknown stage.
+ */
+const char *ifq_stage_name(ifq_stage_t stage);
+
+/**
+ * Returns the smallest value that is counted in a bucket.
+ *
+ * @param bucket Index of the bucket.
+ *
+ * @return The value in nanoseconds.
+ */
+uint64_t ifq_histogram_bucket_ns(size_t bucket);
+
+/**
+ * Returns the value below which the given fraction of the
+ * recorded values lie, to the precision of the buckets.
+ *
+ * @param histogram The histogram.
+ * @param quantile The fraction, between 0 and 1.
+ *
+ * @return The value in nanoseconds, or 0 if the histogram is empty.
+ */
+uint64_t ifq_histogram_quantile(const ifq_histogram_t *histogram, double quantile);
+
 /**
  * Create a new fastq record.
  *
@@ -0,0 +1,200 @@
+#include <string.h>
+#include <zlib.h>
+
+#include <ifq_format.h>
+
+/**
+ * Rounds the given offset up to the next section boundary.
+ *
+ * @param offset An offset in the index file.
+ *
+ * @return The aligned offset.
+ */
+static uint64_t
+align_section(uint64_t offset)
+{
+    return ( offset + IFQ_SECTION_ALIGNMENT - 1 ) & ~( (uint64_t) IFQ_SECTION_ALIGNMENT - 1 );
+}
+
+/**
+ * Computes the checksum of the header and section table.
+ *
+ * @param header The header, followed in memory by the section table.
+ * @param sections The section table.
+ *
+ * @return The checksum.
+ */
+static uint32_t
+header_crc(const ifq_header_t *header, const ifq_section_t *sections)
+{
+    ifq_header_t copy = *header;
+    copy.crc = 0;
+
+    uLong crc = crc32( 0L, Z_NULL, 0 );
+    crc = crc32( crc, (const Bytef *) &copy, sizeof( ifq_header_t ) );
+    crc = crc32( crc, (const Bytef *) sections, sizeof( ifq_section_t ) * header->num_sections );
+
+    return (uint32_t) crc;
+}
+
+/**
+ * Computes the checksum of a block of data in pieces that
+ * fit in the length type of zlib.
+ *
+ * @param data The data.
+ * @param size Size of the data in bytes.
+ *
+ * @return The checksum.
+ */
+static uint32_t
+data_crc(const unsigned char *data, uint64_t size)
+{
+    uLong crc = crc32( 0L, Z_NULL, 0 );
+    while( size > 0 )
+    {
+        uInt length = size > ( 1U << 30 ) ? ( 1U << 30 ) : (uInt) size;
+        crc = crc32( crc, data, length );
+        data += length;
+        size -= length;
+    }
+
+    return (uint32_t) crc;
+}
+
+uint64_t
+ifq_layout_sections(ifq_header_t *header, ifq_section_t *sections, uint32_t num_sections)
+{
+    uint32_t i;
+    uint64_t offset = sizeof( ifq_header_t ) + sizeof( ifq_section_t ) * num_sections;
+
+    for(i = 0; i < num_sections; i++)
+    {
+        offset = align_section( offset );
+        sections[ i ].offset = offset;
+        sections[ i ].crc = 0;
+        offset += sections[ i ].size;
+    }
+
+    memset( header, 0, sizeof( ifq_header_t ) );
+    memcpy( header->magic, IFQ_MAGIC, IFQ_MAGIC_LENGTH );
+    header->version = IFQ_VERSION;
+    header->num_sections = num_sections;
+    header->file_size = offset;
+
+    return offset;
+}
+
+void
+ifq_seal_sections(void *data, ifq_header_t *header, ifq_section_t *sections)
+{
+    uint32_t i;
+    for(i = 0; i < header->num_sections; i++)
+    {
+        sections[ i ].crc = data_crc( (unsigned char *) data + sections[ i ].offset, sections[ i ].size );
+    }
+    header->crc = header_crc( header, sections );
+
+    memcpy( data, header, sizeof( ifq_header_t ) );
+    memcpy( (char *) data + sizeof( ifq_header_t ), sections, sizeof( ifq_section_t ) * header->num_sections );
+}
+
+int
+ifq_check_header(const void *data, uint64_t size)
+{
+    const ifq_header_t *header = (const ifq_header_t *) data;
+    if( size < sizeof( ifq_header_t ) ||
+        memcmp( header->magic, IFQ_MAGIC, IFQ_MAGIC_LENGTH ) != 0 ||
+        header->version != IFQ_VERSION ||
+        header->num_sections > IFQ_MAX_SECTIONS ||
+        header->file_size != size ||
+        size < sizeof( ifq_header_t ) + sizeof( ifq_section_t ) * header->num_sections )
+    {
+        return 0;
+    }
+
+    const ifq_section_t *sections = (const ifq_section_t *) ( header + 1 );
+    if( header_crc( header, sections ) != header->crc )
+    {
+        return 0;
+    }
+
+    uint32_t i;
+    for(i = 0; i < header->num_sections; i++)
+    {
+        if( sections[ i ].offset > size || sections[ i ].size > size - sections[ i ].offset )
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+int
+ifq_check_sections(const void *data)
+{
+    const ifq_header_t *header = (const ifq_header_t *) data;
+    const ifq_section_t *sections = (const ifq_section_t *) ( header + 1 );
+
+    uint32_t i;
+    for(i = 0; i < header->num_sections; i++)
+    {
+        if( data_crc( (const unsigned char *) data + sections[ i ].offset, sections[ i ].size ) != sections[ i ].crc )
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+const ifq_section_t *
+ifq_find_section(const void *data, uint32_t type)
+{
+    const ifq_header_t *header = (const ifq_header_t *) data;
+    const ifq_section_t *sections = (const ifq_section_t *) ( header + 1 );
+
+    uint32_t i;
+    for(i = 0; i < header->num_sections; i++)
+    {
+        if( sections[ i ].type == type )
+        {
+            return &sections[ i ];
+        }
+    }
+
+    return NULL;
+}
+
+uint32_t
+ifq_fingerprint(const char *key, size_t length)
+{
+    /* 32-bit FNV-1a, independent of the hash used by cmph */
+    uint32_t hash = 2166136261U;
+    size_t i;
+    for(i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char) key[ i ];
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+void
+ifq_init_trace_header(ifq_trace_header_t *header, uint64_t num_entries)
+{
+    memset( header, 0, sizeof( ifq_trace_header_t ) );
+    memcpy( header->magic, IFQ_TRACE_MAGIC, IFQ_MAGIC_LENGTH );
+    header->version = IFQ_TRACE_VERSION;
+    header->record_size = sizeof( ifq_trace_record_t );
+    header->num_entries = num_entries;
+}
+
+int
+ifq_check_trace_header(const ifq_trace_header_t *header)
+{
+    return memcmp( header->magic, IFQ_TRACE_MAGIC, IFQ_MAGIC_LENGTH ) == 0 &&
+           header->version == IFQ_TRACE_VERSION &&
+           header->record_size == sizeof( ifq_trace_record_t );
+}
@@ -0,0 +1,264 @@
+#ifndef __IFQ_FORMAT_H__
+#define __IFQ_FORMAT_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * An index is stored in a single file that starts with a header
+ * followed by a table of sections. Every section starts at a
+ * multiple of IFQ_SECTION_ALIGNMENT so that it can be used directly
+ * from a mapping of the whole file. Readers skip sections with
+ * types they do not know, so new sections can be added without
+ * changing the version, which is only increased when existing
+ * sections change layout. Integers are stored in the byte order
+ * of the machine that created the index.
+ */
+#define IFQ_MAGIC "IFQINDEX"
+#define IFQ_MAGIC_LENGTH 8
+#define IFQ_VERSION 1
+#define IFQ_SECTION_ALIGNMENT 4096
+#define IFQ_MAX_SECTIONS 64
+
+/**
+ * Extension of the index file that is appended to the prefix.
+ */
+#define IFQ_INDEX_EXTENSION ".ifq"
+
+typedef enum
+{
+    /**
+     * The perfect hash function packed by cmph_pack.
+     */
+    IFQ_SECTION_HASH = 1,
+
+    /**
+     * An ifq_entry_t for every hash value.
+     */
+    IFQ_SECTION_TABLE = 2,
+
+    /**
+     * A 32-bit fingerprint of the accession for every hash value,
+     * used to reject missing accessions without reading the fastq.
+     */
+    IFQ_SECTION_FINGERPRINT = 3,
+
+    /**
+     * Text with one key=value pair per line.
+     */
+    IFQ_SECTION_METADATA = 4
+} ifq_section_type_t;
+
+typedef struct ifq_header
+{
+    /**
+     * Always IFQ_MAGIC.
+     */
+    char magic[ IFQ_MAGIC_LENGTH ];
+
+    /**
+     * Version of the layout, IFQ_VERSION.
+     */
+    uint32_t version;
+
+    /**
+     * Number of entries in the section table.
+     */
+    uint32_t num_sections;
+
+    /**
+     * Total size of the file in bytes.
+     */
+    uint64_t file_size;
+
+    /**
+     * crc32 of the header and section table, computed with
+     * this field set to zero.
+     */
+    uint32_t crc;
+
+    /**
+     * Always zero.
+     */
+    uint32_t reserved;
+} ifq_header_t;
+
+typedef struct ifq_section
+{
+    /**
+     * One of ifq_section_type_t.
+     */
+    uint32_t type;
+
+    /**
+     * crc32 of the contents of the section.
+     */
+    uint32_t crc;
+
+    /**
+     * Offset of the section from the start of the file.
+     */
+    uint64_t offset;
+
+    /**
+     * Size of the section in bytes.
+     */
+    uint64_t size;
+} ifq_section_t;
+
+/**
+ * Fills in the header and section table of a new index and
+ * assigns aligned offsets to the sections.
+ *
+ * @param header The header to fill in.
+ * @param sections Section table, the type and size of each
+ *                 section must be set.
+ * @param num_sections Number of sections.
+ *
+ * @return The total size of the index file in bytes.
+ */
+uint64_t ifq_layout_sections(ifq_header_t *header, ifq_section_t *sections, uint32_t num_sections);
+
+/**
+ * Copies the header and section table to the start of a mapped
+ * index file, whose sections have been written, and computes all
+ * checksums.
+ *
+ * @param data The mapped index file.
+ * @param header The header returned by ifq_layout_sections.
+ * @param sections The section table.
+ */
+void ifq_seal_sections(void *data, ifq_header_t *header, ifq_section_t *sections);
+
+/**
+ * Checks the magic, version, header checksum and that all sections
+ * lie within the file.
+ *
+ * @param data The mapped index file.
+ * @param size Size of the file in bytes.
+ *
+ * @return 1 if the header is valid, 0 otherwise.
+ */
+int ifq_check_header(const void *data, uint64_t size);
+
+/**
+ * Checks the checksum of every section, this reads the whole file.
+ *
+ * @param data The mapped index file with a valid header.
+ *
+ * @return 1 if all sections are intact, 0 otherwise.
+ */
+int ifq_check_sections(const void *data);
+
+/**
+ * Finds the first section with the given type.
+ *
+ * @param data The mapped index file with a valid header.
+ * @param type One of ifq_section_type_t.
+ *
+ * @return The section or NULL if there is none.
+ */
+const ifq_section_t *ifq_find_section(const void *data, uint32_t type);
+
+/**
+ * Computes the fingerprint of an accession that is stored in the
+ * IFQ_SECTION_FINGERPRINT section.
+ *
+ * @param key The accession.
+ * @param length Length of the accession.
+ *
+ * @return The fingerprint.
+ */
+uint32_t ifq_fingerprint(const char *key, size_t length);
+
+/**
+ * A query trace is a header followed by one ifq_trace_record_t for
+ * every record that a query read, in the order of the reads, and one
+ * for every query that read none. It holds no accessions, only their
+ * fingerprints. Integers are stored in the byte order of the machine
+ * that wrote the trace.
+ */
+#define IFQ_TRACE_MAGIC "IFQTRACE"
+#define IFQ_TRACE_VERSION 1
+
+/**
+ * Slot of a query that did not read any record.
+ */
+#define IFQ_TRACE_NO_SLOT UINT32_MAX
+
+/**
+ * Flag of a record that the query returned.
+ */
+#define IFQ_TRACE_FOUND 1
+
+typedef struct ifq_trace_header
+{
+    /**
+     * Always IFQ_TRACE_MAGIC.
+     */
+    char magic[ IFQ_MAGIC_LENGTH ];
+
+    /**
+     * Version of the layout, IFQ_TRACE_VERSION.
+     */
+    uint32_t version;
+
+    /**
+     * Size of each record, sizeof( ifq_trace_record_t ).
+     */
+    uint32_t record_size;
+
+    /**
+     * Number of entries in the lookup table of the traced index,
+     * a replay checks that it has the same.
+     */
+    uint64_t num_entries;
+} ifq_trace_header_t;
+
+typedef struct ifq_trace_record
+{
+    /**
+     * Fingerprint of the accession, see ifq_fingerprint.
+     */
+    uint32_t fingerprint;
+
+    /**
+     * Entry of the lookup table that was read, or IFQ_TRACE_NO_SLOT.
+     */
+    uint32_t slot;
+
+    /**
+     * Virtual file offset of the record, the block address is in
+     * the upper 48 bits.
+     */
+    uint64_t offset;
+
+    /**
+     * Number of compressed bytes in the blocks of the record.
+     */
+    uint32_t span;
+
+    /**
+     * IFQ_TRACE_FOUND if the query returned this record.
+     */
+    uint32_t flags;
+} ifq_trace_record_t;
+
+/**
+ * Fills in the header of a new trace.
+ *
+ * @param header The header.
+ * @param num_entries Number of entries in the lookup table of the index.
+ */
+void ifq_init_trace_header(ifq_trace_header_t *header, uint64_t num_entries);
+
+/**
+ * Checks the magic, version and record size of a trace.
+ *
+ * @param header The header.
+ *
+ * @return 1 if the header is valid, 0 otherwise.
+ */
+int ifq_check_trace_header(const ifq_trace_header_t *header);
+
+#endif /* End of __IFQ_FORMAT_H__ */
@@ -1,14 +1,184 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <ifq.h>
 
+void usage()
+{
+    printf( "Usage: indexfastq [-a algorithm] [-H hash] [-b b] [-k keys_per_bin] [-c graph_size] [-t tmp_dir]\n" );
+    printf( "                  [-T lookup|size|build] [-m max_bits_per_key] [-l max_lookup_ns] [-s sample_size]\n" );
+    printf( "                  [-v] [-P profile.json] fastq outputprefix\n" );
+    printf( "Algorithms: bmz, chm, brz, fch, bdz, bdz_ph, chd_ph, chd (default)\n" );
+    printf( "Hash functions: jenkins (default), mum\n" );
+    printf( "With -T the CHD parameters are tuned on a sample for the goal within the limits.\n" );
+    printf( "With -v the phases of the build are reported, -P writes them as JSON.\n" );
+}
+
+/**
+ * Prints the phases and progress of the build.
+ */
+void report_build(void *data, ifq_build_event_t event, const ifq_build_phase_t *phase, uint64_t done, uint64_t total)
+{
+    if( event == IFQ_BUILD_PHASE_START )
+    {
+        fprintf( stderr, "%s: started\n", phase->name );
+    }
+    else if( event == IFQ_BUILD_PROGRESS && total > 0 )
+    {
+        fprintf( stderr, "%s: %.1f%%\n", phase->name, 100.0 * (double) done / (double) total );
+    }
+    else if( event == IFQ_BUILD_PHASE_END )
+    {
+        fprintf( stderr, "%s: %.2f s wall, %.2f s cpu, %llu kB peak rss, %llu bytes decompressed\n", phase->name,
+                 phase->wall_seconds, phase->cpu_seconds, (unsigned long long) phase->peak_rss_kb,
+                 (unsigned long long) phase->bytes_decompressed );
+    }
+}
+
+/**
+ * Tunes the options for the target and prints the measurements.
+ *
+ * @return 1 if successful, 0 otherwise.
+ */
+int tune(char *fastq_path, const ifq_tune_target_t *target, ifq_options_t *options)
+{
+    ifq_tune_result_t *results = NULL;
+    size_t num_results = 0;
+    ifq_codes_t status = ifq_tune_options( fastq_path, target, options, &results, &num_results );
+    if( status == IFQ_BAD_FASTQ )
+    {
+        printf( "Failed to read the fastq file\n" );
+        return 0;
+    }
+
+    printf( "algorithm\tb\tkeys_per_bin\tload_factor\tbuild_s\tbits_per_key\ttable_bytes_per_key\tlookup_ns\n" );
+    size_t i;
+    for(i = 0; i < num_results; i++)
+    {
+        ifq_tune_result_t *r = &results[ i ];
+        if( r->built )
+        {
+            printf( "%s\t%u\t%u\t%.2f\t%.4f\t%.3f\t%.2f\t%.1f\n", cmph_names[ r->options.algorithm ], r->options.b,
+                    r->options.keys_per_bin, r->options.graph_size, r->build_seconds, r->bits_per_key,
+                    r->table_bytes_per_key, r->lookup_ns );
+        }
+    }
+    free( results );
+
+    if( status != IFQ_OK )
+    {
+        printf( "No setting meets the target\n" );
+        return 0;
+    }
+
+    printf( "Selected %s b=%u keys_per_bin=%u load_factor=%.2f\n", cmph_names[ options->algorithm ], options->b,
+            options->keys_per_bin, options->graph_size );
+
+    return 1;
+}
+
 int main(int argc, char **argv)
 {
-    if( argc != 3 )
+    ifq_options_t options;
+    ifq_default_options( &options );
+    ifq_tune_target_t target;
+    ifq_default_tune_target( &target );
+    int tuning = 0;
+
+    int opt;
+    while( ( opt = getopt( argc, argv, "a:H:b:k:c:t:T:m:l:s:vP:" ) ) != -1 )
+    {
+        switch( opt )
+        {
+            case 'a':
+                options.algorithm = ifq_parse_algorithm( optarg );
+                if( options.algorithm == CMPH_COUNT )
+                {
+                    printf( "Unknown algorithm: %s\n", optarg );
+                    exit( 1 );
+                }
+                if( options.algorithm == CMPH_BMZ8 )
+                {
+                    printf( "bmz8 holds at most 256 records, use bmz instead\n" );
+                    exit( 1 );
+                }
+                break;
+            case 'H':
+                options.hash = ifq_parse_hash( optarg );
+                if( options.hash == CMPH_HASH_COUNT )
+                {
+                    printf( "Unknown hash function: %s\n", optarg );
+                    exit( 1 );
+                }
+                break;
+            case 'b':
+                options.b = (cmph_uint32) atoi( optarg );
+                break;
+            case 'k':
+                options.keys_per_bin = (cmph_uint32) atoi( optarg );
+                break;
+            case 'c':
+                options.graph_size = atof( optarg );
+                break;
+            case 't':
+                options.tmp_dir = optarg;
+                break;
+            case 'T':
+                tuning = 1;
+                if( strcmp( optarg, "lookup" ) == 0 )
+                {
+                    target.goal = IFQ_TUNE_LOOKUP;
+                }
+                else if( strcmp( optarg, "size" ) == 0 )
+                {
+                    target.goal = IFQ_TUNE_SIZE;
+                }
+                else if( strcmp( optarg, "build" ) == 0 )
+                {
+                    target.goal = IFQ_TUNE_BUILD;
+                }
+                else
+                {
+                    printf( "Unknown tuning goal: %s\n", optarg );
+                    exit( 1 );
+                }
+                break;
+            case 'm':
+                target.max_bits_per_key = atof( optarg );
+                break;
+            case 'l':
+                target.max_lookup_ns = atof( optarg );
+                break;
+            case 's':
+                target.sample_size = (size_t) atol( optarg );
+                break;
+            case 'v':
+                options.callback = report_build;
+                break;
+            case 'P':
+                options.profile_path = optarg;
+                break;
+            default:
+                usage( );
+                exit( 1 );
+        }
+    }
+
+    if( argc - optind != 2 )
     {
-        printf( "Usage: indexfastq fastq outputprefix\n" );
+        usage( );
         exit( 1 );
     }
 
-    if( ifq_create_index( argv[ 1 ], argv[ 2 ] ) != IFQ_OK )
+    if( tuning )
+    {
+        if( !tune( argv[ optind ], &target, &options ) )
+        {
+            return 1;
+        }
+    }
+
+    if( ifq_create_index_with_options( argv[ optind ], argv[ optind + 1 ], &options ) != IFQ_OK )
     {
         printf( "Failed to create index\n" );
         return 1;
@@ -29,8 +29,21 @@
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#ifdef BGZF_TIMING
+#include <time.h>
+#endif
 #include "bgzf.h"
 
+// Static tracepoints of the reads, a nop instruction each unless a tracer attaches
+#ifdef BGZF_USDT
+#include <sys/sdt.h>
+#define BGZF_PROBE1(name, a) DTRACE_PROBE1(bgzf, name, a)
+#define BGZF_PROBE2(name, a, b) DTRACE_PROBE2(bgzf, name, a, b)
+#else
+#define BGZF_PROBE1(name, a) do { } while (0)
+#define BGZF_PROBE2(name, a, b) do { } while (0)
+#endif
+
 #include "khash.h"
 typedef struct {
     int size;
@@ -191,6 +204,10 @@ open_write(int fd, int compress_level) // compress_level==-1 for the default lev
     fp->block_offset = 0;
     fp->block_length = 0;
     fp->error = NULL;
+    fp->range_block = NULL;
+    fp->range_block_size = 0;
+    fp->inflate_ns = 0;
+    memset(&fp->stats, 0, sizeof(bgzf_stats_t));
     return fp;
 }
 
@@ -357,15 +374,16 @@ deflate_block(BGZF* fp, int block_length)
 
 static
 int
-inflate_block(BGZF* fp, int block_length)
+inflate_block_zlib(BGZF* fp, const bgzf_byte_t* block, int block_length)
 {
-    // Inflate the block in fp->compressed_block into fp->uncompressed_block
+    // Inflate the given compressed block into fp->uncompressed_block
 
     z_stream zs;
     int status;
+    fp->stats.blocks_inflated++;
     zs.zalloc = NULL;
     zs.zfree = NULL;
-    zs.next_in = fp->compressed_block + 18;
+    zs.next_in = (Bytef*)block + 18;
     zs.avail_in = block_length - 16;
     zs.next_out = fp->uncompressed_block;
     zs.avail_out = fp->uncompressed_block_size;
@@ -386,9 +404,47 @@ inflate_block(BGZF* fp, int block_length)
         report_error(fp, "inflate failed");
         return -1;
     }
+    fp->stats.inflated_bytes += zs.total_out;
     return zs.total_out;
 }
 
+#ifdef BGZF_TIMING
+static
+int64_t
+timing_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+#endif
+
+static
+int
+inflate_block_from(BGZF* fp, const bgzf_byte_t* block, int block_length)
+{
+    int count;
+    BGZF_PROBE1(inflate_start, block_length);
+#ifdef BGZF_TIMING
+    // Count the time spent in zlib for callers that break down their latency
+    int64_t start = timing_now();
+    count = inflate_block_zlib(fp, block, block_length);
+    fp->inflate_ns += timing_now() - start;
+#else
+    count = inflate_block_zlib(fp, block, block_length);
+#endif
+    BGZF_PROBE2(inflate_done, block_length, count);
+    return count;
+}
+
+static
+int
+inflate_block(BGZF* fp, int block_length)
+{
+    // Inflate the block in fp->compressed_block into fp->uncompressed_block
+    return inflate_block_from(fp, fp->compressed_block, block_length);
+}
+
 static
 int
 check_header(const bgzf_byte_t* header)
@@ -419,11 +475,18 @@ static int load_block_from_cache(BGZF *fp, int64_t block_address)
     cache_t *p;
     khash_t(cache) *h = (khash_t(cache)*)fp->cache;
     k = kh_get(cache, h, block_address);
-    if (k == kh_end(h)) return 0;
+    if (k == kh_end(h)) {
+        fp->stats.cache_misses++;
+        BGZF_PROBE1(cache_miss, block_address);
+        return 0;
+    }
+    fp->stats.cache_hits++;
+    BGZF_PROBE1(cache_hit, block_address);
     p = &kh_val(h, k);
     if (fp->block_length != 0) fp->block_offset = 0;
     fp->block_address = block_address;
     fp->block_length = p->size;
+    fp->block_end = p->end_offset;
     memcpy(fp->uncompressed_block, p->block, MAX_BLOCK_SIZE);
 #ifdef _USE_KNETFILE
     knet_seek(fp->x.fpr, p->end_offset, SEEK_SET);
@@ -447,8 +510,10 @@ static void cache_block(BGZF *fp, int size)
         for (k = kh_begin(h); k < kh_end(h); ++k)
             if (kh_exist(h, k)) break;
         if (k < kh_end(h)) {
+            BGZF_PROBE1(cache_evict, kh_key(h, k));
             free(kh_val(h, k).block);
             kh_del(cache, h, k);
+            fp->stats.cache_evictions++;
         }
     }
     k = kh_put(cache, h, fp->block_address, &ret);
@@ -501,6 +566,8 @@ bgzf_read_block(BGZF* fp)
         return -1;
     }
     size += count;
+    fp->stats.compressed_bytes += size;
+    BGZF_PROBE2(block_read, block_address, size);
     count = inflate_block(fp, block_length);
     if (count < 0) return -1;
     if (fp->block_length != 0) {
@@ -509,6 +576,7 @@ bgzf_read_block(BGZF* fp)
     }
     fp->block_address = block_address;
     fp->block_length = count;
+    fp->block_end = block_address + size;
     cache_block(fp, size);
     return 0;
 }
@@ -557,6 +625,124 @@ bgzf_read(BGZF* fp, void* data, int length)
     return bytes_read;
 }
 
+int64_t bgzf_tell_compressed(BGZF *fp)
+{
+#ifdef _USE_KNETFILE
+    return knet_tell(fp->x.fpr);
+#else
+    return ftello(fp->file);
+#endif
+}
+
+int
+bgzf_read_range(BGZF* fp, int64_t pos, int span, void* data, int length)
+{
+    int64_t block_address = (pos >> 16) & 0xFFFFFFFFFFFFLL;
+    int block_offset = pos & 0xFFFF;
+    int count, consumed = 0, fetched = -1, bytes_read = 0;
+    bgzf_byte_t* output = data;
+
+    if (fp->open_mode != 'r') {
+        report_error(fp, "file not open for reading");
+        return -1;
+    }
+    if (length <= 0 || span <= 0) {
+        return 0;
+    }
+
+    while (consumed < span && bytes_read < length) {
+        int64_t address = block_address + consumed;
+        int block_length, copy_length;
+        if (fp->block_length > 0 && fp->block_address == address) {
+            // Still decompressed from the previous read, as happens when
+            // records are read in file order
+            fp->stats.cache_hits++;
+            BGZF_PROBE1(cache_hit, address);
+            block_length = (int)(fp->block_end - address);
+        } else if (load_block_from_cache(fp, address)) {
+            block_length = (int)(fp->block_end - address);
+        } else {
+            bgzf_byte_t* block;
+            if (fetched < 0) {
+                // Only the blocks from the first one that must be inflated
+                // are read, in one read
+                int remaining = span - consumed;
+                if (fp->range_block_size < remaining) {
+                    void* range_block = realloc(fp->range_block, remaining);
+                    if (range_block == NULL) {
+                        report_error(fp, "out of memory");
+                        return -1;
+                    }
+                    fp->range_block = range_block;
+                    fp->range_block_size = remaining;
+                }
+#ifdef _USE_KNETFILE
+                if (knet_seek(fp->x.fpr, address, SEEK_SET) != 0) {
+#else
+                if (fseeko(fp->file, address, SEEK_SET) != 0) {
+#endif
+                    report_error(fp, "seek failed");
+                    return -1;
+                }
+#ifdef _USE_KNETFILE
+                count = knet_read(fp->x.fpr, fp->range_block, remaining);
+#else
+                count = fread(fp->range_block, 1, remaining, fp->file);
+#endif
+                if (count != remaining) {
+                    report_error(fp, "read failed");
+                    return -1;
+                }
+                fp->stats.compressed_bytes += count;
+                BGZF_PROBE2(block_read, address, remaining);
+                fetched = consumed;
+            }
+            block = (bgzf_byte_t*)fp->range_block + consumed - fetched;
+            if (span - consumed < BLOCK_HEADER_LENGTH || !check_header(block)) {
+                report_error(fp, "invalid block header");
+                return -1;
+            }
+            block_length = unpackInt16((uint8_t*)&block[16]) + 1;
+            if (consumed + block_length > span) {
+                report_error(fp, "block exceeds range");
+                return -1;
+            }
+            count = inflate_block_from(fp, block, block_length);
+            if (count < 0) return -1;
+            fp->block_address = address;
+            fp->block_length = count;
+            fp->block_end = address + block_length;
+            cache_block(fp, block_length);
+        }
+        consumed += block_length;
+
+        copy_length = bgzf_min(length - bytes_read, fp->block_length - block_offset);
+        if (copy_length > 0) {
+            memcpy(output + bytes_read, (bgzf_byte_t*)fp->uncompressed_block + block_offset, copy_length);
+            bytes_read += copy_length;
+            block_offset += copy_length;
+        }
+        fp->block_offset = block_offset;
+        block_offset = 0;
+    }
+
+    // Leave the file positioned just after the current block, a block
+    // loaded from the cache has already moved it there
+    if (fetched < 0 || consumed != span) {
+#ifdef _USE_KNETFILE
+        knet_seek(fp->x.fpr, block_address + consumed, SEEK_SET);
+#else
+        fseeko(fp->file, block_address + consumed, SEEK_SET);
+#endif
+    }
+    if (fp->block_offset >= fp->block_length) {
+        fp->block_address = block_address + consumed;
+        fp->block_offset = 0;
+        fp->block_length = 0;
+    }
+    return bytes_read;
+}
+
 int bgzf_flush(BGZF* fp)
 {
     while (fp->block_offset > 0) {
@@ -648,6 +834,7 @@ int bgzf_close(BGZF* fp)
     }
     free(fp->uncompressed_block);
     free(fp->compressed_block);
+    free(fp->range_block);
     free_cache(fp);
     free(fp);
     return 0;
@@ -658,6 +845,11 @@ void bgzf_set_cache_size(BGZF *fp, int cache_size)
     if (fp) fp->cache_size = cache_size;
 }
 
+void bgzf_reset_stats(BGZF *fp)
+{
+    if (fp) memset(&fp->stats, 0, sizeof(bgzf_stats_t));
+}
+
 int bgzf_check_EOF(BGZF *fp)
 {
     static uint8_t magic[28] = "\037\213\010\4\0\0\0\0\0\377\6\0\102\103\2\0\033\0\3\0\0\0\0\0\0\0\0\0";
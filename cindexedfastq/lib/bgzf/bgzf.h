@@ -29,6 +29,15 @@
 
 //typedef int8_t bool;
 
+typedef struct {
+    int64_t compressed_bytes; // read from the file
+    int64_t blocks_inflated;
+    int64_t inflated_bytes; // decompressed data produced by the inflated blocks
+    int64_t cache_hits; // blocks that were still decompressed or in the cache
+    int64_t cache_misses;
+    int64_t cache_evictions;
+} bgzf_stats_t;
+
 typedef struct {
     int file_descriptor;
     char open_mode;  // 'r' or 'w'
@@ -48,9 +57,14 @@ typedef struct {
     int64_t block_address;
     int block_length;
     int block_offset;
+    int64_t block_end; // compressed end of the current block
     int cache_size;
     const char* error;
     void *cache; // a pointer to a hash table
+    void *range_block; // compressed blocks fetched by bgzf_read_range
+    int range_block_size;
+    int64_t inflate_ns; // time spent inflating blocks, only counted with BGZF_TIMING
+    bgzf_stats_t stats; // counted since the file was opened or the stats were reset
 } BGZF;
 
 #ifdef __cplusplus
@@ -113,6 +127,23 @@ int bgzf_write(BGZF* fp, const void* data, int length);
  */
 int64_t bgzf_seek(BGZF* fp, int64_t pos, int where);
 
+/*
+ * Return the offset in the compressed file just past the last block
+ * that was read, i.e. where the next block starts.
+ */
+int64_t bgzf_tell_compressed(BGZF *fp);
+
+/*
+ * Read length bytes starting at the virtual file pointer pos, where the
+ * blocks holding them are known to occupy span compressed bytes starting
+ * at the block address of pos. Blocks that are still decompressed or in
+ * the cache are not read again, the remaining blocks are fetched with a
+ * single read and each is copied into data with one memcpy.
+ * Returns the number of bytes actually read.
+ * Returns -1 on error.
+ */
+int bgzf_read_range(BGZF *fp, int64_t pos, int span, void *data, int length);
+
 /*
  * Set the cache size. Zero to disable. By default, caching is
  * disabled. The recommended cache size for frequent random access is
@@ -120,6 +151,11 @@ int64_t bgzf_seek(BGZF* fp, int64_t pos, int where);
  */
 void bgzf_set_cache_size(BGZF *fp, int cache_size);
 
+/*
+ * Clear the I/O and cache counters in fp->stats.
+ */
+void bgzf_reset_stats(BGZF *fp);
+
 int bgzf_check_EOF(BGZF *fp);
 int bgzf_read_block(BGZF* fp);
 int bgzf_flush(BGZF* fp);
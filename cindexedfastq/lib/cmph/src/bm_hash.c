@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmph.h"
+#include "cmph_benchmark.h"
+#include "hash.h"
+
+// Generates Illumina style read names, 40-60 bytes long
+char** illumina_names_vector_new(cmph_uint32 size) {
+  cmph_uint32 i = 0;
+  char** vec = (char**)malloc(sizeof(char*)*size);
+  srandom(42);
+  for (i = 0; i < size; ++i) {
+    char name[128];
+    snprintf(name, sizeof(name), "HWI-ST%04ld:%ld:C%07ldACXX:%ld:%ld:%ld:%ld 1:N:0:%06ld",
+             random() % 10000, random() % 1000, random() % 10000000,
+             random() % 8 + 1, random() % 3000 + 1101, random() % 20000, random() % 200000,
+             random() % 1000000);
+    vec[i] = strdup(name);
+  }
+  return vec;
+}
+
+static cmph_uint32 g_names_len = 0;
+static char** g_names = NULL;
+static cmph_uint32* g_lengths = NULL;
+static cmph_t* g_mphf[CMPH_HASH_COUNT];
+static volatile cmph_uint32 g_sink = 0;
+
+void bm_hash(CMPH_HASH hashfunc, int iters) {
+  int i = 0;
+  cmph_uint32 hashes[3];
+  hash_state_t* state = hash_state_new(hashfunc, g_names_len);
+  for (i = 0; i < iters; ++i) {
+    cmph_uint32 pos = i % g_names_len;
+    hash_vector(state, g_names[pos], g_lengths[pos], hashes);
+    g_sink += hashes[0] ^ hashes[1] ^ hashes[2];
+  }
+  hash_state_destroy(state);
+}
+
+void bm_hash_many(CMPH_HASH hashfunc, int iters) {
+  int i = 0;
+  cmph_uint32* hashes = (cmph_uint32*)malloc(3*sizeof(cmph_uint32)*g_names_len);
+  hash_state_t* state = hash_state_new(hashfunc, g_names_len);
+  for (i = 0; i < iters; i += g_names_len) {
+    cmph_uint32 count = iters - i < (int)g_names_len ? iters - i : g_names_len;
+    hash_vector_many(state, count, (const char**)g_names, g_lengths, hashes);
+    g_sink += hashes[3*count - 1];
+  }
+  hash_state_destroy(state);
+  free(hashes);
+}
+
+void bm_create(CMPH_HASH hashfunc, int iters) {
+  CMPH_HASH hashfuncs[] = { hashfunc, CMPH_HASH_COUNT };
+  cmph_io_adapter_t* source = cmph_io_vector_adapter(g_names, iters);
+  cmph_config_t* config = cmph_config_new(source);
+  cmph_config_set_algo(config, CMPH_CHD);
+  cmph_config_set_hashfuncs(config, hashfuncs);
+  g_mphf[hashfunc] = cmph_new(config);
+  if (!g_mphf[hashfunc]) {
+    fprintf(stderr, "Failed to create mphf with hash function %s\n", cmph_hash_names[hashfunc]);
+    exit(-1);
+  }
+  cmph_config_destroy(config);
+  cmph_io_vector_adapter_destroy(source);
+}
+
+void bm_search(CMPH_HASH hashfunc, int iters) {
+  int i = 0;
+  cmph_t* mphf = g_mphf[hashfunc];
+  void* packed = malloc(cmph_packed_size(mphf));
+  cmph_pack(mphf, packed);
+  for (i = 0; i < iters; ++i) {
+    cmph_uint32 pos = i % g_names_len;
+    g_sink += cmph_search_packed(packed, g_names[pos], g_lengths[pos]);
+  }
+  free(packed);
+}
+
+void bm_search_many(CMPH_HASH hashfunc, int iters) {
+  int i = 0;
+  cmph_t* mphf = g_mphf[hashfunc];
+  void* packed = malloc(cmph_packed_size(mphf));
+  cmph_uint32* values = (cmph_uint32*)malloc(sizeof(cmph_uint32)*g_names_len);
+  cmph_pack(mphf, packed);
+  for (i = 0; i < iters; i += g_names_len) {
+    cmph_uint32 count = iters - i < (int)g_names_len ? iters - i : g_names_len;
+    cmph_search_many_packed(packed, count, (const char**)g_names, g_lengths, values);
+    g_sink += values[count - 1];
+  }
+  free(values);
+  free(packed);
+}
+
+#define DECLARE_HASH(hashfunc) \
+  void bm_hash_ ## hashfunc(int iters) { bm_hash(hashfunc, iters); } \
+  void bm_hash_many_ ## hashfunc(int iters) { bm_hash_many(hashfunc, iters); } \
+  void bm_create_ ## hashfunc(int iters) { bm_create(hashfunc, iters); } \
+  void bm_search_ ## hashfunc(int iters) { bm_search(hashfunc, iters); } \
+  void bm_search_many_ ## hashfunc(int iters) { bm_search_many(hashfunc, iters); }
+
+DECLARE_HASH(CMPH_HASH_JENKINS);
+DECLARE_HASH(CMPH_HASH_MUM);
+
+int main(int argc, char** argv) {
+  cmph_uint32 i = 0;
+  g_names_len = 1000 * 1000;
+  g_names = illumina_names_vector_new(g_names_len);
+  g_lengths = (cmph_uint32*)malloc(sizeof(cmph_uint32)*g_names_len);
+  for (i = 0; i < g_names_len; ++i) g_lengths[i] = (cmph_uint32)strlen(g_names[i]);
+
+  BM_REGISTER(bm_hash_CMPH_HASH_JENKINS, 10 * 1000 * 1000);
+  BM_REGISTER(bm_hash_CMPH_HASH_MUM, 10 * 1000 * 1000);
+  BM_REGISTER(bm_hash_many_CMPH_HASH_JENKINS, 10 * 1000 * 1000);
+  BM_REGISTER(bm_hash_many_CMPH_HASH_MUM, 10 * 1000 * 1000);
+  BM_REGISTER(bm_create_CMPH_HASH_JENKINS, 1000 * 1000);
+  BM_REGISTER(bm_create_CMPH_HASH_MUM, 1000 * 1000);
+  BM_REGISTER(bm_search_CMPH_HASH_JENKINS, 10 * 1000 * 1000);
+  BM_REGISTER(bm_search_CMPH_HASH_MUM, 10 * 1000 * 1000);
+  BM_REGISTER(bm_search_many_CMPH_HASH_JENKINS, 10 * 1000 * 1000);
+  BM_REGISTER(bm_search_many_CMPH_HASH_MUM, 10 * 1000 * 1000);
+  run_benchmarks(argc, argv);
+
+  for (i = 0; i < CMPH_HASH_COUNT; ++i) if (g_mphf[i]) cmph_destroy(g_mphf[i]);
+  for (i = 0; i < g_names_len; ++i) free(g_names[i]);
+  free(g_names);
+  free(g_lengths);
+  return 0;
+}
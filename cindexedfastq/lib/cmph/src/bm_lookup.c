@@ -0,0 +1,283 @@
+// Microbenchmarks of the parts of a CHD lookup: the hash function, the
+// CHD_PH search, and the rank and select structures under it. Each runs
+// on a working set that fits in the L1 cache, in the last level cache
+// and in neither, to tell kernel changes from memory effects.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cmph.h"
+#include "cmph_benchmark.h"
+#include "chd_ph.h"
+#include "compressed_rank.h"
+#include "hash.h"
+#include "select.h"
+
+typedef enum { BM_L1, BM_LLC, BM_DRAM, BM_LEVEL_COUNT } bm_level_t;
+static const char* bm_level_names[] = { "L1", "LLC", "DRAM" };
+static size_t g_sizes[BM_LEVEL_COUNT];
+
+// Structures are built once with at most this many bytes, and copied
+// until the copies fill the working set. Lookups go to a random copy,
+// which touches memory like one large structure but builds much faster.
+#define BM_BASE_SIZE (1 << 20)
+
+typedef struct {
+  char* data;
+  size_t stride;
+  cmph_uint32 copies;
+} bm_copies_t;
+
+static bm_copies_t g_copies;
+static hash_state_t* g_state = NULL;
+static cmph_uint32* g_offsets = NULL;
+static cmph_uint32* g_lengths = NULL;
+static cmph_uint32 g_n = 0;
+static select_t* g_selects = NULL;
+static volatile cmph_uint32 g_sink = 0;
+
+static void bm_copies_new(const void* base, size_t size, size_t target) {
+  cmph_uint32 i;
+  g_copies.stride = (size + 63) & ~(size_t)63;
+  g_copies.copies = target > size ? (cmph_uint32)(target / size) : 1;
+  g_copies.data = (char*)malloc(g_copies.stride * g_copies.copies);
+  if (!g_copies.data) {
+    fprintf(stderr, "Failed to allocate %zu bytes\n", g_copies.stride * g_copies.copies);
+    exit(-1);
+  }
+  for (i = 0; i < g_copies.copies; ++i) memcpy(g_copies.data + i * g_copies.stride, base, size);
+  fprintf(stderr, "%u copies of %zu bytes\n", g_copies.copies, size);
+}
+
+// xorshift64, the high half picks an element and the low half a copy
+static inline cmph_uint64 bm_next(cmph_uint64* x) {
+  *x ^= *x << 13;
+  *x ^= *x >> 7;
+  *x ^= *x << 17;
+  return *x;
+}
+
+static inline cmph_uint32 bm_below(cmph_uint32 r, cmph_uint32 n) {
+  return (cmph_uint32)(((cmph_uint64)r * n) >> 32);
+}
+
+static inline char* bm_copy(cmph_uint64 r) {
+  return g_copies.data + bm_below((cmph_uint32)r, g_copies.copies) * g_copies.stride;
+}
+
+// An invertible mix, keys made from distinct numbers are distinct
+static inline cmph_uint64 bm_key(cmph_uint64 i) {
+  i = (i ^ (i >> 31)) * 0x7fb5d329728ea185ULL;
+  i = (i ^ (i >> 27)) * 0x81dadef4bc2dd44dULL;
+  return i ^ (i >> 33);
+}
+
+static size_t bm_base_size(bm_level_t level) {
+  return g_sizes[level] < BM_BASE_SIZE ? g_sizes[level] : BM_BASE_SIZE;
+}
+
+static void bm_teardown(int iters) {
+  free(g_selects);
+  g_selects = NULL;
+  if (g_state) hash_state_destroy(g_state);
+  g_state = NULL;
+  free(g_copies.data);
+  free(g_offsets);
+  free(g_lengths);
+  memset(&g_copies, 0, sizeof(g_copies));
+  g_offsets = g_lengths = NULL;
+}
+
+// Illumina style read names, about 50 bytes each
+static void bm_setup_hash(bm_level_t level, CMPH_HASH hashfunc) {
+  size_t size = bm_base_size(level), used = 0;
+  char* names = (char*)malloc(size + 128);
+  cmph_uint32 i = 0;
+  g_offsets = (cmph_uint32*)malloc(sizeof(cmph_uint32) * (size / 32 + 1));
+  g_lengths = (cmph_uint32*)malloc(sizeof(cmph_uint32) * (size / 32 + 1));
+  srandom(42);
+  while (used + 64 <= size) {
+    int len = snprintf(names + used, 128, "HWI-ST%04ld:%ld:C%07ldACXX:%ld:%ld:%ld:%ld",
+                       random() % 10000, random() % 1000, random() % 10000000, random() % 8 + 1,
+                       random() % 3000 + 1101, random() % 20000, random() % 200000);
+    g_offsets[i] = (cmph_uint32)used;
+    g_lengths[i++] = (cmph_uint32)len;
+    used += len;
+  }
+  g_n = i;
+  bm_copies_new(names, used, g_sizes[level]);
+  free(names);
+  g_state = hash_state_new(hashfunc, g_n);
+}
+
+static void bm_setup_chd_ph(bm_level_t level) {
+  // Without the rank of CHD, CHD_PH takes about a bit per key
+  cmph_uint32 n = (cmph_uint32)(bm_base_size(level) * 8), i;
+  cmph_uint64* keys = (cmph_uint64*)malloc(sizeof(cmph_uint64) * n);
+  cmph_io_adapter_t* source;
+  cmph_config_t* config;
+  cmph_t* mphf;
+  void* packed;
+  for (i = 0; i < n; ++i) keys[i] = bm_key(i);
+  source = cmph_io_struct_vector_adapter(keys, sizeof(cmph_uint64), 0, sizeof(cmph_uint64), n);
+  config = cmph_config_new(source);
+  cmph_config_set_algo(config, CMPH_CHD_PH);
+  mphf = cmph_new(config);
+  if (!mphf) {
+    fprintf(stderr, "Failed to create CHD_PH for %u keys\n", n);
+    exit(-1);
+  }
+  packed = malloc(chd_ph_packed_size(mphf));
+  chd_ph_pack(mphf, packed);
+  bm_copies_new(packed, chd_ph_packed_size(mphf), g_sizes[level]);
+  g_n = n;
+  free(packed);
+  cmph_destroy(mphf);
+  cmph_config_destroy(config);
+  cmph_io_struct_vector_adapter_destroy(source);
+  free(keys);
+}
+
+// Sorted values with gaps of 1 to 199, as the unused bins that CHD ranks
+static void bm_setup_rank(bm_level_t level) {
+  cmph_uint32 n = (cmph_uint32)(bm_base_size(level) / 2), i, v = 0;
+  cmph_uint32* vals = (cmph_uint32*)malloc(sizeof(cmph_uint32) * n);
+  compressed_rank_t cr;
+  void* packed;
+  srandom(42);
+  for (i = 0; i < n; ++i) vals[i] = v += 1 + random() % 199;
+  compressed_rank_init(&cr);
+  compressed_rank_generate(&cr, vals, n);
+  packed = malloc(compressed_rank_packed_size(&cr));
+  compressed_rank_pack(&cr, packed);
+  bm_copies_new(packed, compressed_rank_packed_size(&cr), g_sizes[level]);
+  g_n = v + 1;
+  free(packed);
+  compressed_rank_destroy(&cr);
+  free(vals);
+}
+
+static int bm_cmp(const void* a, const void* b) {
+  cmph_uint32 x = *(const cmph_uint32*)a, y = *(const cmph_uint32*)b;
+  return (x > y) - (x < y);
+}
+
+// n ones among 2n bits, as in the compressed sequences of CHD_PH
+static void bm_setup_select(bm_level_t level) {
+  cmph_uint32 n = (cmph_uint32)(bm_base_size(level) * 8 / 9 * 2), i;
+  cmph_uint32* vals = (cmph_uint32*)malloc(sizeof(cmph_uint32) * n);
+  size_t bits_size, table_size;
+  char* base;
+  select_t sel;
+  srandom(42);
+  for (i = 0; i < n; ++i) vals[i] = (cmph_uint32)(random() % (n + 1));
+  qsort(vals, n, sizeof(cmph_uint32), bm_cmp);
+  select_init(&sel);
+  select_generate(&sel, vals, n, n);
+  bits_size = ((2 * (size_t)n + 31) >> 5) * sizeof(cmph_uint32);
+  table_size = ((n >> 7) + 1) * sizeof(cmph_uint32);
+  base = (char*)malloc(bits_size + table_size);
+  memcpy(base, sel.bits_vec, bits_size);
+  memcpy(base + bits_size, sel.select_table, table_size);
+  bm_copies_new(base, bits_size + table_size, g_sizes[level]);
+  // Every copy has its own select_t that points into it
+  g_selects = (select_t*)malloc(sizeof(select_t) * g_copies.copies);
+  for (i = 0; i < g_copies.copies; ++i) {
+    char* copy = g_copies.data + i * g_copies.stride;
+    g_selects[i] = sel;
+    g_selects[i].bits_vec = (cmph_uint32*)copy;
+    g_selects[i].select_table = (cmph_uint32*)(copy + bits_size);
+  }
+  g_n = n;
+  select_destroy(&sel);
+  free(base);
+  free(vals);
+}
+
+void bm_hash_vector(int iters) {
+  cmph_uint64 x = 88172645463325252ULL;
+  cmph_uint32 hashes[3];
+  int i;
+  for (i = 0; i < iters; ++i) {
+    cmph_uint64 r = bm_next(&x);
+    cmph_uint32 k = bm_below((cmph_uint32)(r >> 32), g_n);
+    hash_vector(g_state, bm_copy(r) + g_offsets[k], g_lengths[k], hashes);
+    g_sink += hashes[0] ^ hashes[1] ^ hashes[2];
+  }
+}
+
+void bm_chd_ph_search_packed(int iters) {
+  cmph_uint64 x = 88172645463325252ULL;
+  int i;
+  for (i = 0; i < iters; ++i) {
+    cmph_uint64 r = bm_next(&x);
+    cmph_uint64 key = bm_key(bm_below((cmph_uint32)(r >> 32), g_n));
+    g_sink += chd_ph_search_packed(bm_copy(r), (const char*)&key, sizeof(key));
+  }
+}
+
+void bm_compressed_rank_query_packed(int iters) {
+  cmph_uint64 x = 88172645463325252ULL;
+  int i;
+  for (i = 0; i < iters; ++i) {
+    cmph_uint64 r = bm_next(&x);
+    g_sink += compressed_rank_query_packed(bm_copy(r), bm_below((cmph_uint32)(r >> 32), g_n));
+  }
+}
+
+void bm_select_query(int iters) {
+  cmph_uint64 x = 88172645463325252ULL;
+  int i;
+  for (i = 0; i < iters; ++i) {
+    cmph_uint64 r = bm_next(&x);
+    select_t* sel = &g_selects[bm_below((cmph_uint32)r, g_copies.copies)];
+    g_sink += select_query(sel, bm_below((cmph_uint32)(r >> 32), g_n));
+  }
+}
+
+#define DECLARE_LEVEL(level) \
+  void bm_setup_jenkins_ ## level(int iters) { bm_setup_hash(level, CMPH_HASH_JENKINS); } \
+  void bm_setup_mum_ ## level(int iters) { bm_setup_hash(level, CMPH_HASH_MUM); } \
+  void bm_setup_chd_ph_ ## level(int iters) { bm_setup_chd_ph(level); } \
+  void bm_setup_rank_ ## level(int iters) { bm_setup_rank(level); } \
+  void bm_setup_select_ ## level(int iters) { bm_setup_select(level); } \
+  void bm_hash_vector_jenkins_ ## level(int iters) { bm_hash_vector(iters); } \
+  void bm_hash_vector_mum_ ## level(int iters) { bm_hash_vector(iters); } \
+  void bm_chd_ph_search_packed_ ## level(int iters) { bm_chd_ph_search_packed(iters); } \
+  void bm_compressed_rank_query_packed_ ## level(int iters) { bm_compressed_rank_query_packed(iters); } \
+  void bm_select_query_ ## level(int iters) { bm_select_query(iters); }
+
+DECLARE_LEVEL(BM_L1);
+DECLARE_LEVEL(BM_LLC);
+DECLARE_LEVEL(BM_DRAM);
+
+#define REGISTER_LEVEL(level) \
+  BM_REGISTER_FIXTURE(bm_hash_vector_jenkins_ ## level, bm_setup_jenkins_ ## level, bm_teardown, 10 * 1000 * 1000); \
+  BM_REGISTER_FIXTURE(bm_hash_vector_mum_ ## level, bm_setup_mum_ ## level, bm_teardown, 10 * 1000 * 1000); \
+  BM_REGISTER_FIXTURE(bm_chd_ph_search_packed_ ## level, bm_setup_chd_ph_ ## level, bm_teardown, 10 * 1000 * 1000); \
+  BM_REGISTER_FIXTURE(bm_compressed_rank_query_packed_ ## level, bm_setup_rank_ ## level, bm_teardown, 10 * 1000 * 1000); \
+  BM_REGISTER_FIXTURE(bm_select_query_ ## level, bm_setup_select_ ## level, bm_teardown, 10 * 1000 * 1000)
+
+int main(int argc, char** argv) {
+  long l1 = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+  long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+  if (llc <= 0) llc = sysconf(_SC_LEVEL2_CACHE_SIZE);
+  if (l1 <= 0) l1 = 32 * 1024;
+  if (llc <= 0) llc = 8 * 1024 * 1024;
+  // Half the L1 cache, a quarter of the last level cache, and four
+  // times it but at most 1GB
+  g_sizes[BM_L1] = (size_t)l1 / 2;
+  g_sizes[BM_LLC] = (size_t)llc / 4;
+  g_sizes[BM_DRAM] = (size_t)llc * 4 < (1UL << 30) ? (size_t)llc * 4 : (1UL << 30);
+  fprintf(stderr, "Working sets: %s %zu, %s %zu, %s %zu bytes\n",
+          bm_level_names[BM_L1], g_sizes[BM_L1], bm_level_names[BM_LLC], g_sizes[BM_LLC],
+          bm_level_names[BM_DRAM], g_sizes[BM_DRAM]);
+
+  REGISTER_LEVEL(BM_L1);
+  REGISTER_LEVEL(BM_LLC);
+  REGISTER_LEVEL(BM_DRAM);
+  run_benchmarks(argc, argv);
+  return 0;
+}
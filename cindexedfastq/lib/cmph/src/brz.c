@@ -749,7 +749,7 @@ void brz_pack(cmph_t *mphf, void *packed_mphf)
 	ptr += sizeof(data->k);
 
 	// packing c
-	*((cmph_uint64 *)ptr) = (cmph_uint64)data->c;
+	memcpy(ptr, &(data->c), sizeof(data->c));
 	ptr += sizeof(data->c);
 
 	// packing h1 type
@@ -778,12 +778,14 @@ void brz_pack(cmph_t *mphf, void *packed_mphf)
 
 	cmph_uint8 * g_i = (cmph_uint8 *) (g_is_ptr + data->k);
 
+	// g_is are stored as offsets from the start of the table so that
+	// the packed mphf can be relocated, e.g. mapped from a file
 	for(i = 0; i < data->k; i++)
 	{
 		#if defined (__ia64) || defined (__x86_64__)
-			*g_is_ptr++ = (cmph_uint64)g_i;
+			*g_is_ptr++ = (cmph_uint64)(g_i - ptr);
 		#else
-			*g_is_ptr++ = (cmph_uint32)g_i;
+			*g_is_ptr++ = (cmph_uint32)(g_i - ptr);
 		#endif
 		// packing h1[i]
 		hash_state_pack(data->h1[i], g_i);
@@ -864,7 +866,8 @@ static cmph_uint32 brz_bmz8_search_packed(cmph_uint32 *packed_mphf, const char *
 
 	register cmph_uint32 k = *packed_mphf++;
 
-	register double c = (double)(*((cmph_uint64*)packed_mphf));
+	double c;
+	memcpy(&c, packed_mphf, sizeof(c));
 	packed_mphf += 2;
 
 	register CMPH_HASH h1_type = (CMPH_HASH)*packed_mphf++;
@@ -891,7 +894,7 @@ static cmph_uint32 brz_bmz8_search_packed(cmph_uint32 *packed_mphf, const char *
 		register cmph_uint32 * g_is_ptr = packed_mphf;
 	#endif
 
-	register cmph_uint8 * h1_ptr = (cmph_uint8 *) g_is_ptr[h0];
+	register cmph_uint8 * h1_ptr = (cmph_uint8 *) g_is_ptr + g_is_ptr[h0];
 
 	register cmph_uint8 * h2_ptr = h1_ptr + hash_state_packed_size(h1_type);
 
@@ -918,7 +921,8 @@ static cmph_uint32 brz_fch_search_packed(cmph_uint32 *packed_mphf, const char *k
 
 	register cmph_uint32 k = *packed_mphf++;
 
-	register double c = (double)(*((cmph_uint64*)packed_mphf));
+	double c;
+	memcpy(&c, packed_mphf, sizeof(c));
 	packed_mphf += 2;
 
 	register CMPH_HASH h1_type = (CMPH_HASH)*packed_mphf++;
@@ -947,7 +951,7 @@ static cmph_uint32 brz_fch_search_packed(cmph_uint32 *packed_mphf, const char *k
 		register cmph_uint32 * g_is_ptr = packed_mphf;
 	#endif
 
-	register cmph_uint8 * h1_ptr = (cmph_uint8 *) g_is_ptr[h0];
+	register cmph_uint8 * h1_ptr = (cmph_uint8 *) g_is_ptr + g_is_ptr[h0];
 
 	register cmph_uint8 * h2_ptr = h1_ptr + hash_state_packed_size(h1_type);
 
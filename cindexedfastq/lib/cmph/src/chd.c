@@ -61,6 +61,13 @@ void chd_config_set_keys_per_bin(cmph_config_t *mph, cmph_uint32 keys_per_bin)
 }
 
 
+void chd_config_set_max_iterations(cmph_config_t *mph, cmph_uint32 max_iterations)
+{
+	chd_config_data_t *data = (chd_config_data_t *) mph->data;
+	cmph_config_set_max_iterations(data->chd_ph, max_iterations);
+}
+
+
 cmph_t *chd_new(cmph_config_t *mph, double c)
 {
 	DEBUGP("Creating new chd");
@@ -87,6 +94,7 @@ cmph_t *chd_new(cmph_config_t *mph, double c)
 	#endif
 
 	cmph_config_set_verbosity(chd->chd_ph, mph->verbosity);
+	cmph_config_set_phase_callback(chd->chd_ph, mph->phase_callback, mph->phase_data);
 	cmph_config_set_graphsize(chd->chd_ph, c);
 
 	if (mph->verbosity)
@@ -113,6 +121,7 @@ cmph_t *chd_new(cmph_config_t *mph, double c)
 	cmph_destroy(chd_phf);
 
 
+	CMPH_PHASE(mph, "ranking");
 	if (mph->verbosity)
 	{
 		fprintf(stderr, "Compressing the range of the resulting CHD_PH perfect hash function\n");
@@ -233,6 +242,37 @@ cmph_uint32 chd_search(cmph_t *mphf, const char *key, cmph_uint32 keylen)
 	return _chd_search(chd->packed_chd_phf, chd->packed_cr, key, keylen);
 }
 
+static void _chd_search_many(void * packed_chd_phf, void * packed_cr, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 *values)
+{
+	register cmph_uint32 start, count, i;
+
+	for(start = 0; start < nkeys; start += count)
+	{
+		count = nkeys - start < CHD_SEARCH_MANY_BATCH ? nkeys - start : CHD_SEARCH_MANY_BATCH;
+		cmph_search_many_packed(packed_chd_phf, count, keys + start, keylens + start, values + start);
+
+		// same staging as for the displacements: select table, bit vector, then the rank itself
+		for(i = start; i < start + count; i++)
+		{
+			compressed_rank_prefetch_packed(packed_cr, values[i]);
+		}
+		for(i = start; i < start + count; i++)
+		{
+			compressed_rank_prefetch_bits_packed(packed_cr, values[i]);
+		}
+		for(i = start; i < start + count; i++)
+		{
+			values[i] -= compressed_rank_query_packed(packed_cr, values[i]);
+		}
+	}
+}
+
+void chd_search_many(cmph_t *mphf, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 *values)
+{
+	register chd_data_t * chd = (chd_data_t *)mphf->data;
+	_chd_search_many(chd->packed_chd_phf, chd->packed_cr, nkeys, keys, keylens, values);
+}
+
 void chd_pack(cmph_t *mphf, void *packed_mphf)
 {
 	chd_data_t *data = (chd_data_t *)mphf->data;
@@ -268,3 +308,11 @@ cmph_uint32 chd_search_packed(void *packed_mphf, const char *key, cmph_uint32 ke
 	register cmph_uint8 * packed_chd_phf = ((cmph_uint8 *) ptr) + packed_cr_size + sizeof(cmph_uint32);
 	return _chd_search(packed_chd_phf, ptr, key, keylen);
 }
+
+void chd_search_many_packed(void *packed_mphf, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 *values)
+{
+	register cmph_uint32 * ptr = (cmph_uint32 *)packed_mphf;
+	register cmph_uint32 packed_cr_size = *ptr++;
+	register cmph_uint8 * packed_chd_phf = ((cmph_uint8 *) ptr) + packed_cr_size + sizeof(cmph_uint32);
+	_chd_search_many(packed_chd_phf, ptr, nkeys, keys, keylens, values);
+}
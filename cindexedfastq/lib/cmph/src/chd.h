@@ -23,6 +23,13 @@ void chd_config_set_keys_per_bin(cmph_config_t *mph, cmph_uint32 keys_per_bin);
  *  \param keys_per_bucket value for the number of keys per bucket 
  */
 void chd_config_set_b(cmph_config_t *mph, cmph_uint32 keys_per_bucket);
+
+/** \fn void chd_config_set_max_iterations(cmph_config_t *mph, cmph_uint32 max_iterations);
+ *  \brief Allows to set the number of mapping and searching trials before giving up.
+ *  \param mph pointer to the configuration structure
+ *  \param max_iterations maximum number of trials, 0 selects the default of 100
+ */
+void chd_config_set_max_iterations(cmph_config_t *mph, cmph_uint32 max_iterations);
 void chd_config_destroy(cmph_config_t *mph);
 
 
@@ -56,4 +63,20 @@ cmph_uint32 chd_packed_size(cmph_t *mphf);
  */
 cmph_uint32 chd_search_packed(void *packed_mphf, const char *key, cmph_uint32 keylen);
 
+/** void chd_search_many(cmph_t *mphf, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 *values);
+ *  \brief Searches nkeys keys at once, overlapping the cache misses of a group of keys:
+ *  the displacements of the group are prefetched and decoded first, then its rank structures.
+ *  \param mphf pointer to the mphf
+ *  \param nkeys number of keys
+ *  \param keys keys to be hashed
+ *  \param keylens key lengths in bytes
+ *  \param values receives the mphf value of every key
+ */
+void chd_search_many(cmph_t *mphf, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 *values);
+
+/** void chd_search_many_packed(void *packed_mphf, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 *values);
+ *  \brief Same as chd_search_many() for a packed mphf.
+ */
+void chd_search_many_packed(void *packed_mphf, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 *values);
+
 #endif
@@ -16,6 +16,9 @@
 //#define DEBUG
 #include "debug.h"
 
+// number of keys read and hashed together by chd_ph_mapping
+#define CHD_PH_MAPPING_GROUP 64
+
 // NO_ELEMENT is equivalent to null pointer
 #ifndef NO_ELEMENT
 #define NO_ELEMENT UINT_MAX
@@ -158,6 +161,7 @@ chd_ph_config_data_t *chd_ph_config_new(void)
 	chd_ph->use_h = 1;
 	chd_ph->keys_per_bin = 1;
 	chd_ph->keys_per_bucket = 4;
+	chd_ph->max_iterations = 100;
 	chd_ph->occup_table = 0;
 
 	return chd_ph;
@@ -202,6 +206,17 @@ void chd_ph_config_set_b(cmph_config_t *mph, cmph_uint32 keys_per_bucket)
 }
 
 
+void chd_ph_config_set_max_iterations(cmph_config_t *mph, cmph_uint32 max_iterations)
+{
+	assert(mph);
+	chd_ph_config_data_t *chd_ph = (chd_ph_config_data_t *)mph->data;
+	if(max_iterations == 0)
+	{
+	    max_iterations = 100;
+	}
+	chd_ph->max_iterations = max_iterations;
+}
+
 void chd_ph_config_set_keys_per_bin(cmph_config_t *mph, cmph_uint32 keys_per_bin)
 {
 	assert(mph);
@@ -215,11 +230,11 @@ void chd_ph_config_set_keys_per_bin(cmph_config_t *mph, cmph_uint32 keys_per_bin
 
 cmph_uint8 chd_ph_mapping(cmph_config_t *mph, chd_ph_bucket_t * buckets, chd_ph_item_t * items, cmph_uint32 *max_bucket_size)
 {
-	register cmph_uint32 i = 0, g = 0;
-	cmph_uint32 hl[3];
+	register cmph_uint32 i = 0, g = 0, j, count;
+	cmph_uint32 hl[3 * CHD_PH_MAPPING_GROUP];
 	chd_ph_config_data_t *chd_ph = (chd_ph_config_data_t *)mph->data;
-	char * key = NULL;
-	cmph_uint32 keylen = 0;
+	char * keys[CHD_PH_MAPPING_GROUP];
+	cmph_uint32 keylens[CHD_PH_MAPPING_GROUP];
 	chd_ph_map_item_t * map_item;
 	chd_ph_map_item_t * map_items = (chd_ph_map_item_t *)malloc(chd_ph->m*sizeof(chd_ph_map_item_t));
 	register cmph_uint32 mapping_iterations = 1000;
@@ -234,27 +249,35 @@ cmph_uint8 chd_ph_mapping(cmph_config_t *mph, chd_ph_bucket_t * buckets, chd_ph_
 
 		mph->key_source->rewind(mph->key_source->data);
 
-		for(i = 0; i < chd_ph->m; i++)
+		for(i = 0; i < chd_ph->m; i += count)
 		{
-			mph->key_source->read(mph->key_source->data, &key, &keylen);
-			hash_vector(chd_ph->hl, key, keylen, hl);
-
-			map_item = (map_items + i);
+			// keys are hashed a group at a time so that hashes of similar keys can share vector lanes
+			count = chd_ph->m - i < CHD_PH_MAPPING_GROUP ? chd_ph->m - i : CHD_PH_MAPPING_GROUP;
+			for(j = 0; j < count; j++)
+			{
+				mph->key_source->read(mph->key_source->data, &keys[j], &keylens[j]);
+			}
+			hash_vector_many(chd_ph->hl, count, (const char **)keys, keylens, hl);
 
-			g = hl[0] % chd_ph->nbuckets;
-			map_item->f = hl[1] % chd_ph->n;
-			map_item->h = hl[2] % (chd_ph->n - 1) + 1;
-			map_item->bucket_num=g;
-			mph->key_source->dispose(mph->key_source->data, key, keylen);
-// 			if(buckets[g].size == (chd_ph->keys_per_bucket << 2))
-// 			{
-// 				DEBUGP("BUCKET = %u -- SIZE = %u -- MAXIMUM SIZE = %u\n", g, buckets[g].size, (chd_ph->keys_per_bucket << 2));
-// 				goto error;
-// 			}
-			buckets[g].size++;
-			if(buckets[g].size > *max_bucket_size)
+			for(j = 0; j < count; j++)
 			{
-				  *max_bucket_size = buckets[g].size;
+				map_item = (map_items + i + j);
+
+				g = hl[3 * j] % chd_ph->nbuckets;
+				map_item->f = hl[3 * j + 1] % chd_ph->n;
+				map_item->h = hl[3 * j + 2] % (chd_ph->n - 1) + 1;
+				map_item->bucket_num=g;
+				mph->key_source->dispose(mph->key_source->data, keys[j], keylens[j]);
+// 				if(buckets[g].size == (chd_ph->keys_per_bucket << 2))
+// 				{
+// 					DEBUGP("BUCKET = %u -- SIZE = %u -- MAXIMUM SIZE = %u\n", g, buckets[g].size, (chd_ph->keys_per_bucket << 2));
+// 					goto error;
+// 				}
+				buckets[g].size++;
+				if(buckets[g].size > *max_bucket_size)
+				{
+					  *max_bucket_size = buckets[g].size;
+				}
 			}
 		}
 		buckets[0].items_list = 0;
@@ -628,7 +651,7 @@ cmph_t *chd_ph_new(cmph_config_t *mph, double c)
 	register double load_factor = c;
 	register cmph_uint8 searching_success = 0;
 	register cmph_uint32 max_probes = 1 << 20; // default value for max_probes
-	register cmph_uint32 iterations = 100;
+	register cmph_uint32 iterations = chd_ph->max_iterations;
 	chd_ph_bucket_t * buckets = NULL;
 	chd_ph_item_t * items = NULL;
 	register cmph_uint8 failure = 0;
@@ -702,6 +725,7 @@ cmph_t *chd_ph_new(cmph_config_t *mph, double c)
 	while(1)
 	{
 		iterations --;
+		CMPH_PHASE(mph, "mapping");
 		if (mph->verbosity)
 		{
 			fprintf(stderr, "Starting mapping step for mph creation of %u keys with %u bins\n", chd_ph->m, chd_ph->n);
@@ -717,6 +741,7 @@ cmph_t *chd_ph_new(cmph_config_t *mph, double c)
 			goto cleanup;
 		}
 
+		CMPH_PHASE(mph, "ordering");
 		if (mph->verbosity)
 		{
 			fprintf(stderr, "Starting ordering step\n");
@@ -728,6 +753,7 @@ cmph_t *chd_ph_new(cmph_config_t *mph, double c)
 
         	sorted_lists = chd_ph_ordering(&buckets, &items, chd_ph->nbuckets, chd_ph->m, max_bucket_size);
 
+		CMPH_PHASE(mph, "searching");
 		if (mph->verbosity)
 		{
 			fprintf(stderr, "Starting searching step\n");
@@ -765,6 +791,7 @@ cmph_t *chd_ph_new(cmph_config_t *mph, double c)
 	}
 	#endif
 
+	CMPH_PHASE(mph, "compressing");
 	if (mph->verbosity)
 	{
 		fprintf(stderr, "Starting compressing step\n");
@@ -983,3 +1010,45 @@ cmph_uint32 chd_ph_search_packed(void *packed_mphf, const char *key, cmph_uint32
 	position = (cmph_uint32)((f + ((cmph_uint64 )h)*probe0_num + probe1_num) % n);
 	return position;
 }
+
+void chd_ph_search_many_packed(void *packed_mphf, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 *values)
+{
+	register CMPH_HASH hl_type  = (CMPH_HASH)*(cmph_uint32 *)packed_mphf;
+	register cmph_uint8 *hl_ptr = (cmph_uint8 *)(packed_mphf) + 4;
+
+	register cmph_uint32 * ptr = (cmph_uint32 *)(hl_ptr + hash_state_packed_size(hl_type));
+	register cmph_uint32 n = *ptr++;
+	register cmph_uint32 nbuckets = *ptr++;
+	cmph_uint32 hl[3 * CHD_SEARCH_MANY_BATCH];
+	cmph_uint32 f[CHD_SEARCH_MANY_BATCH], g[CHD_SEARCH_MANY_BATCH], h[CHD_SEARCH_MANY_BATCH];
+
+	register cmph_uint32 disp, probe0_num, probe1_num;
+	register cmph_uint32 start, count, i;
+
+	for(start = 0; start < nkeys; start += count)
+	{
+		count = nkeys - start < CHD_SEARCH_MANY_BATCH ? nkeys - start : CHD_SEARCH_MANY_BATCH;
+
+		// hashing the whole group, each bucket index gives the first cache line to fetch
+		hash_vector_many_packed(hl_ptr, hl_type, count, keys + start, keylens + start, hl);
+		for(i = 0; i < count; i++)
+		{
+			g[i] = hl[3 * i] % nbuckets;
+			f[i] = hl[3 * i + 1] % n;
+			h[i] = hl[3 * i + 2] % (n-1) + 1;
+			compressed_seq_prefetch_packed(ptr, g[i]);
+		}
+		// the select tables are in cache by now, they point to the bit vector bytes
+		for(i = 0; i < count; i++)
+		{
+			compressed_seq_prefetch_bits_packed(ptr, g[i]);
+		}
+		for(i = 0; i < count; i++)
+		{
+			disp = compressed_seq_query_packed(ptr, g[i]);
+			probe0_num = disp % n;
+			probe1_num = disp/n;
+			values[start + i] = (cmph_uint32)((f[i] + ((cmph_uint64 )h[i])*probe0_num + probe1_num) % n);
+		}
+	}
+}
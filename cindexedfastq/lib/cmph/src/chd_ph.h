@@ -23,6 +23,13 @@ void chd_ph_config_set_keys_per_bin(cmph_config_t *mph, cmph_uint32 keys_per_bin
  *  \param keys_per_bucket value for the number of keys per bucket 
  */
 void chd_ph_config_set_b(cmph_config_t *mph, cmph_uint32 keys_per_bucket);
+
+/** \fn void chd_ph_config_set_max_iterations(cmph_config_t *mph, cmph_uint32 max_iterations);
+ *  \brief Allows to set the number of mapping and searching trials before giving up.
+ *  \param mph pointer to the configuration structure
+ *  \param max_iterations maximum number of trials, 0 selects the default of 100
+ */
+void chd_ph_config_set_max_iterations(cmph_config_t *mph, cmph_uint32 max_iterations);
 void chd_ph_config_destroy(cmph_config_t *mph);
 
 
@@ -56,4 +63,18 @@ cmph_uint32 chd_ph_packed_size(cmph_t *mphf);
  */
 cmph_uint32 chd_ph_search_packed(void *packed_mphf, const char *key, cmph_uint32 keylen);
 
+/* Number of keys whose memory accesses are overlapped by the batched searches */
+#define CHD_SEARCH_MANY_BATCH 16
+
+/** void chd_ph_search_many_packed(void *packed_mphf, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 *values);
+ *  \brief Searches nkeys keys at once. Keys are hashed in groups of CHD_SEARCH_MANY_BATCH and the
+ *  displacement words of the whole group are prefetched before any of them is decoded.
+ *  \param  packed_mphf pointer to the packed mphf
+ *  \param nkeys number of keys
+ *  \param keys keys to be hashed
+ *  \param keylens key lengths in bytes
+ *  \param values receives the mphf value of every key
+ */
+void chd_ph_search_many_packed(void *packed_mphf, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 *values);
+
 #endif
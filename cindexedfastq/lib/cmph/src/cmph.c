@@ -16,6 +16,16 @@
 // #define DEBUG
 #include "debug.h"
 
+/* Static tracepoints of the searches, a nop instruction each unless a tracer attaches */
+#ifdef CMPH_USDT
+#include <sys/sdt.h>
+#define CMPH_PROBE1(name, a) DTRACE_PROBE1(cmph, name, a)
+#define CMPH_PROBE2(name, a, b) DTRACE_PROBE2(cmph, name, a, b)
+#else
+#define CMPH_PROBE1(name, a) do { } while (0)
+#define CMPH_PROBE2(name, a, b) do { } while (0)
+#endif
+
 const char *cmph_names[] = {"bmz", "bmz8", "chm", "brz", "fch", "bdz", "bdz_ph", "chd_ph", "chd", NULL };
 
 typedef struct
@@ -421,6 +431,18 @@ void cmph_config_set_keys_per_bin(cmph_config_t *mph, cmph_uint32 keys_per_bin)
 	}
 }
 
+void cmph_config_set_max_iterations(cmph_config_t *mph, cmph_uint32 max_iterations)
+{
+	if (mph->algo == CMPH_CHD_PH)
+	{
+		chd_ph_config_set_max_iterations(mph, max_iterations);
+	}
+	else if (mph->algo == CMPH_CHD)
+	{
+		chd_config_set_max_iterations(mph, max_iterations);
+	}
+}
+
 void cmph_config_set_memory_availability(cmph_config_t *mph, cmph_uint32 memory_availability)
 {
 	if (mph->algo == CMPH_BRZ)
@@ -475,6 +497,12 @@ void cmph_config_set_verbosity(cmph_config_t *mph, cmph_uint32 verbosity)
 	mph->verbosity = verbosity;
 }
 
+void cmph_config_set_phase_callback(cmph_config_t *mph, cmph_phase_callback_t callback, void *data)
+{
+	mph->phase_callback = callback;
+	mph->phase_data = data;
+}
+
 void cmph_config_set_hashfuncs(cmph_config_t *mph, CMPH_HASH *hashfuncs)
 {
 	switch (mph->algo)
@@ -688,6 +716,20 @@ cmph_uint32 cmph_search(cmph_t *mphf, const char *key, cmph_uint32 keylen)
 	return 0;
 }
 
+void cmph_search_many(cmph_t *mphf, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 *values)
+{
+	cmph_uint32 i;
+	if (mphf->algo == CMPH_CHD)
+	{
+		chd_search_many(mphf, nkeys, keys, keylens, values);
+		return;
+	}
+	for (i = 0; i < nkeys; i++)
+	{
+		values[i] = cmph_search(mphf, keys[i], keylens[i]);
+	}
+}
+
 cmph_uint32 cmph_size(cmph_t *mphf)
 {
 	return mphf->size;
@@ -811,14 +853,7 @@ cmph_uint32 cmph_packed_size(cmph_t *mphf)
 	return 0; // FAILURE
 }
 
-/** cmph_uint32 cmph_search(void *packed_mphf, const char *key, cmph_uint32 keylen);
- *  \brief Use the packed mphf to do a search.
- *  \param  packed_mphf pointer to the packed mphf
- *  \param key key to be hashed
- *  \param keylen key legth in bytes
- *  \return The mphf value
- */
-cmph_uint32 cmph_search_packed(void *packed_mphf, const char *key, cmph_uint32 keylen)
+static inline cmph_uint32 search_packed_algo(void *packed_mphf, const char *key, cmph_uint32 keylen)
 {
 	cmph_uint32 *ptr = (cmph_uint32 *)packed_mphf;
 //	fprintf(stderr, "algo:%u\n", *ptr);
@@ -847,3 +882,41 @@ cmph_uint32 cmph_search_packed(void *packed_mphf, const char *key, cmph_uint32 k
 	}
 	return 0; // FAILURE
 }
+
+/** cmph_uint32 cmph_search(void *packed_mphf, const char *key, cmph_uint32 keylen);
+ *  \brief Use the packed mphf to do a search.
+ *  \param  packed_mphf pointer to the packed mphf
+ *  \param key key to be hashed
+ *  \param keylen key legth in bytes
+ *  \return The mphf value
+ */
+cmph_uint32 cmph_search_packed(void *packed_mphf, const char *key, cmph_uint32 keylen)
+{
+	cmph_uint32 value;
+	CMPH_PROBE2(search_start, key, keylen);
+	value = search_packed_algo(packed_mphf, key, keylen);
+	CMPH_PROBE2(search_done, key, value);
+	return value;
+}
+
+void cmph_search_many_packed(void *packed_mphf, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 *values)
+{
+	cmph_uint32 *ptr = (cmph_uint32 *)packed_mphf;
+	cmph_uint32 i;
+	CMPH_PROBE2(search_many_start, keys, nkeys);
+	switch(*ptr)
+	{
+		case CMPH_CHD_PH:
+			chd_ph_search_many_packed(++ptr, nkeys, keys, keylens, values);
+			break;
+		case CMPH_CHD:
+			chd_search_many_packed(++ptr, nkeys, keys, keylens, values);
+			break;
+		default:
+			for (i = 0; i < nkeys; i++)
+			{
+				values[i] = search_packed_algo(packed_mphf, keys[i], keylens[i]);
+			}
+	}
+	CMPH_PROBE2(search_many_done, values, nkeys);
+}
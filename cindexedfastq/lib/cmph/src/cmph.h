@@ -14,6 +14,9 @@ extern "C"
 typedef struct __config_t cmph_config_t;
 typedef struct __cmph_t cmph_t;
 
+/* Called with the name of each construction step as it starts, e.g. "mapping" */
+typedef void (*cmph_phase_callback_t)(void *data, const char *phase);
+
 typedef struct 
 {
         void *data;
@@ -49,12 +52,14 @@ void cmph_io_struct_vector_adapter_destroy(cmph_io_adapter_t * key_source);
 cmph_config_t *cmph_config_new(cmph_io_adapter_t *key_source);
 void cmph_config_set_hashfuncs(cmph_config_t *mph, CMPH_HASH *hashfuncs);
 void cmph_config_set_verbosity(cmph_config_t *mph, cmph_uint32 verbosity);
+void cmph_config_set_phase_callback(cmph_config_t *mph, cmph_phase_callback_t callback, void *data);
 void cmph_config_set_graphsize(cmph_config_t *mph, double c);
 void cmph_config_set_algo(cmph_config_t *mph, CMPH_ALGO algo);
 void cmph_config_set_tmp_dir(cmph_config_t *mph, cmph_uint8 *tmp_dir);
 void cmph_config_set_mphf_fd(cmph_config_t *mph, FILE *mphf_fd);
 void cmph_config_set_b(cmph_config_t *mph, cmph_uint32 b);
 void cmph_config_set_keys_per_bin(cmph_config_t *mph, cmph_uint32 keys_per_bin);
+void cmph_config_set_max_iterations(cmph_config_t *mph, cmph_uint32 max_iterations);
 void cmph_config_set_memory_availability(cmph_config_t *mph, cmph_uint32 memory_availability);
 void cmph_config_destroy(cmph_config_t *mph);
 
@@ -101,6 +106,22 @@ cmph_uint32 cmph_packed_size(cmph_t *mphf);
  */
 cmph_uint32 cmph_search_packed(void *packed_mphf, const char *key, cmph_uint32 keylen);
 
+/** void cmph_search_many(cmph_t *mphf, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 *values);
+ *  \brief Computes the mphf values of nkeys keys. For CHD and CHD_PH the keys are searched in small groups
+ *  whose cache misses overlap, other algorithms search the keys one by one.
+ *  \param mphf pointer to the resulting function
+ *  \param nkeys number of keys
+ *  \param keys keys to be hashed
+ *  \param keylens key lengths in bytes
+ *  \param values receives the mphf value of every key
+ */
+void cmph_search_many(cmph_t *mphf, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 *values);
+
+/** void cmph_search_many_packed(void *packed_mphf, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 *values);
+ *  \brief Same as cmph_search_many() for a packed mphf.
+ */
+void cmph_search_many_packed(void *packed_mphf, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 *values);
+
 // TIMING functions. To use the macro CMPH_TIMING must be defined
 #include "cmph_time.h"
 
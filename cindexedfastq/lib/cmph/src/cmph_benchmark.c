@@ -4,16 +4,23 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <sys/resource.h>
 
 #include "cmph_benchmark.h"
 
 typedef struct {
   const char* name;
+  void (*setup)(int);
   void (*func)(int);
+  void (*teardown)(int);
   int iters;
   struct rusage begin;
   struct rusage end;
+  struct timespec begin_wall;
+  struct timespec end_wall;
+  unsigned long long begin_cycles;
+  unsigned long long end_cycles;
 } benchmark_t;
 
 static benchmark_t* global_benchmarks = NULL;
@@ -63,11 +70,28 @@ int global_benchmarks_length() {
   return length;
 }
 
+// Cycles of the time stamp counter, 0 where there is none
+static unsigned long long bm_cycles() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  return __builtin_ia32_rdtsc();
+#else
+  return 0;
+#endif
+}
+
 void bm_register(const char* name, void (*func)(int), int iters) {
+  bm_register_fixture(name, NULL, func, NULL, iters);
+}
+
+void bm_register_fixture(const char* name, void (*setup)(int), void (*func)(int),
+                         void (*teardown)(int), int iters) {
   benchmark_t benchmark;
   int length = global_benchmarks_length();
+  memset(&benchmark, 0, sizeof(benchmark_t));
   benchmark.name = name;
+  benchmark.setup = setup;
   benchmark.func = func;
+  benchmark.teardown = teardown;
   benchmark.iters = iters;
   assert(!find_benchmark(name));
   global_benchmarks = (benchmark_t *)realloc(
@@ -83,18 +107,24 @@ void bm_start(const char* name) {
 
   benchmark = find_benchmark(name);
   assert(benchmark);
+  if (benchmark->setup) (*benchmark->setup)(benchmark->iters);
   int ret = getrusage(RUSAGE_SELF, &rs);  
   if (ret != 0) {
     perror("rusage failed");    
     exit(-1);
   }
   benchmark->begin = rs;
+  clock_gettime(CLOCK_MONOTONIC, &benchmark->begin_wall);
+  benchmark->begin_cycles = bm_cycles();
   (*benchmark->func)(benchmark->iters);
 }
 
 void bm_end(const char* name) { 
   benchmark_t* benchmark;
   struct rusage rs;
+  unsigned long long cycles = bm_cycles();
+  struct timespec wall;
+  clock_gettime(CLOCK_MONOTONIC, &wall);
 
   int ret = getrusage(RUSAGE_SELF, &rs);  
   if (ret != 0) {
@@ -104,6 +134,9 @@ void bm_end(const char* name) {
 
   benchmark = find_benchmark(name);
   benchmark->end = rs;
+  benchmark->end_wall = wall;
+  benchmark->end_cycles = cycles;
+  if (benchmark->teardown) (*benchmark->teardown)(benchmark->iters);
 
   struct timeval utime;
   timeval_subtract(&utime, &benchmark->end.ru_utime, &benchmark->begin.ru_utime);
@@ -115,14 +148,29 @@ void bm_end(const char* name) {
          utime.tv_sec, (long int)utime.tv_usec);
   printf("System time used: %ld.%06ld\n",
          stime.tv_sec, (long int)stime.tv_usec);
+  if (benchmark->iters > 0) {
+    double ns = (benchmark->end_wall.tv_sec - benchmark->begin_wall.tv_sec) * 1e9 +
+                (benchmark->end_wall.tv_nsec - benchmark->begin_wall.tv_nsec);
+    printf("Time per iter   : %.2f ns\n", ns / benchmark->iters);
+    if (benchmark->end_cycles > benchmark->begin_cycles) {
+      printf("Cycles per iter : %.2f\n",
+             (double)(benchmark->end_cycles - benchmark->begin_cycles) / benchmark->iters);
+    }
+  }
   printf("\n");
 }
  
 void run_benchmarks(int argc, char** argv) {
   benchmark_t* benchmark = global_benchmarks;
   while (benchmark && benchmark->name != NULL) {
-    bm_start(benchmark->name);
-    bm_end(benchmark->name);
+    int i, selected = argc <= 1;
+    for (i = 1; i < argc; ++i) {
+      if (strstr(benchmark->name, argv[i])) selected = 1;
+    }
+    if (selected) {
+      bm_start(benchmark->name);
+      bm_end(benchmark->name);
+    }
     ++benchmark;
   }
 }
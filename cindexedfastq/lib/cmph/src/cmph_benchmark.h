@@ -11,6 +11,18 @@ extern "C"
   
 #define BM_REGISTER(func, iters) bm_register(#func, func, iters)
 void bm_register(const char* name, void (*func)(int), int iters);
+
+// setup and teardown run around func and are not timed, they get the
+// same iteration count. Either may be NULL.
+#define BM_REGISTER_FIXTURE(func, setup, teardown, iters) \
+  bm_register_fixture(#func, setup, func, teardown, iters)
+void bm_register_fixture(const char* name, void (*setup)(int), void (*func)(int),
+                         void (*teardown)(int), int iters);
+
+// Runs the registered benchmarks, or with arguments only those whose
+// name contains one of them. Besides the rusage times every benchmark
+// reports the wall clock time and the time stamp counter cycles per
+// iteration, the counter runs at the nominal frequency of the processor.
 void run_benchmarks(int argc, char** argv);
 
 #ifdef __cplusplus
@@ -0,0 +1,93 @@
+#include "cmph_cpu.h"
+#include <stdlib.h>
+#include <string.h>
+
+//#define DEBUG
+#include "debug.h"
+
+/*
+ * One place to detect the features of the processor, so that a single
+ * build runs the best kernels on every host. The modules with kernels
+ * ask for the features the first time they are used and keep pointers
+ * to the chosen functions, the CMPH_CPU environment variable lowers
+ * the features to compare kernels or to work around a bad host.
+ */
+static const char *cmph_cpu_names[] = { "sse2", "popcnt", "bmi", "bmi2", "avx2", "avx512", NULL };
+
+static const struct
+{
+	const char *name;
+	cmph_uint32 features;
+} cmph_cpu_levels[] = {
+	{ "generic", 0 },
+	{ "x86-64", CMPH_CPU_SSE2 },
+	{ "x86-64-v2", CMPH_CPU_SSE2 | CMPH_CPU_POPCNT },
+	{ "x86-64-v3", CMPH_CPU_SSE2 | CMPH_CPU_POPCNT | CMPH_CPU_BMI | CMPH_CPU_BMI2 | CMPH_CPU_AVX2 },
+	{ "x86-64-v4", CMPH_CPU_SSE2 | CMPH_CPU_POPCNT | CMPH_CPU_BMI | CMPH_CPU_BMI2 | CMPH_CPU_AVX2 | CMPH_CPU_AVX512 },
+	{ NULL, 0 }
+};
+
+static cmph_uint32 cmph_cpu_detected = 0;
+static int cmph_cpu_ready = 0;
+
+static cmph_uint32 cmph_cpu_detect(void)
+{
+	cmph_uint32 features = 0;
+#ifdef CMPH_CPU_X86
+	__builtin_cpu_init();
+	features |= CMPH_CPU_SSE2;
+	if (__builtin_cpu_supports("popcnt")) features |= CMPH_CPU_POPCNT;
+	if (__builtin_cpu_supports("bmi")) features |= CMPH_CPU_BMI;
+	// PDEP takes hundreds of cycles before Zen 3
+	if (__builtin_cpu_supports("bmi2") && !__builtin_cpu_is("znver1") && !__builtin_cpu_is("znver2")) features |= CMPH_CPU_BMI2;
+	if (__builtin_cpu_supports("avx2")) features |= CMPH_CPU_AVX2;
+	if (__builtin_cpu_supports("avx512f")) features |= CMPH_CPU_AVX512;
+#endif
+	return features;
+}
+
+cmph_uint32 cmph_cpu_parse(const char *names)
+{
+	cmph_uint32 features = 0;
+	const char *p = names;
+	while (*p)
+	{
+		size_t len = strcspn(p, ",");
+		cmph_uint32 i;
+		for (i = 0; cmph_cpu_names[i]; i++)
+		{
+			if (strlen(cmph_cpu_names[i]) == len && strncmp(p, cmph_cpu_names[i], len) == 0) features |= 1U << i;
+		}
+		for (i = 0; cmph_cpu_levels[i].name; i++)
+		{
+			if (strlen(cmph_cpu_levels[i].name) == len && strncmp(p, cmph_cpu_levels[i].name, len) == 0) features |= cmph_cpu_levels[i].features;
+		}
+		p += len;
+		if (*p == ',') p++;
+	}
+	return features;
+}
+
+cmph_uint32 cmph_cpu_features(void)
+{
+	if (!cmph_cpu_ready)
+	{
+		const char *env = getenv(CMPH_CPU_ENV);
+		cmph_uint32 features = cmph_cpu_detect();
+		if (env) features &= cmph_cpu_parse(env);
+		DEBUGP("Processor features 0x%x\n", features);
+		cmph_cpu_detected = features;
+		cmph_cpu_ready = 1;
+	}
+	return cmph_cpu_detected;
+}
+
+const char *cmph_cpu_name(cmph_uint32 feature)
+{
+	cmph_uint32 i;
+	for (i = 0; cmph_cpu_names[i]; i++)
+	{
+		if (feature == 1U << i) return cmph_cpu_names[i];
+	}
+	return NULL;
+}
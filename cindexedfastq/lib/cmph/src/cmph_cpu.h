@@ -0,0 +1,45 @@
+#ifndef __CMPH_CPU_H__
+#define __CMPH_CPU_H__
+
+#include "cmph_types.h"
+
+/* Processor features that select the kernels of the hash functions,
+ * rank/select and the fastq scanner. A feature is only reported when
+ * its kernels pay off, BMI2 is not set where PDEP is microcoded. */
+#define CMPH_CPU_SSE2    0x01
+#define CMPH_CPU_POPCNT  0x02
+#define CMPH_CPU_BMI     0x04
+#define CMPH_CPU_BMI2    0x08
+#define CMPH_CPU_AVX2    0x10
+#define CMPH_CPU_AVX512  0x20
+
+/* Environment variable that restricts the features, a comma separated
+ * list of feature names (sse2, popcnt, bmi, bmi2, avx2, avx512) or of
+ * the levels x86-64, x86-64-v2, x86-64-v3 and x86-64-v4. An empty
+ * value or "generic" leaves only the portable kernels. */
+#define CMPH_CPU_ENV "CMPH_CPU"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define CMPH_CPU_X86
+#endif
+
+/** \fn cmph_uint32 cmph_cpu_features(void);
+ *  \brief Returns the features of the processor that the kernels may use, detected on the first call
+ *         and restricted by the CMPH_CPU environment variable.
+ *  \return a combination of the CMPH_CPU_* flags
+ */
+cmph_uint32 cmph_cpu_features(void);
+
+/** \fn cmph_uint32 cmph_cpu_parse(const char *names);
+ *  \brief Parses a list of feature and level names as in the CMPH_CPU environment variable.
+ *  \param names comma separated names, unknown names are ignored
+ *  \return a combination of the CMPH_CPU_* flags
+ */
+cmph_uint32 cmph_cpu_parse(const char *names);
+
+/** \fn const char *cmph_cpu_name(cmph_uint32 feature);
+ *  \brief Returns the name of a single CMPH_CPU_* flag, or NULL.
+ */
+const char *cmph_cpu_name(cmph_uint32 feature);
+
+#endif
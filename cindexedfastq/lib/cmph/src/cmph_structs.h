@@ -12,8 +12,12 @@ struct __config_t
         cmph_uint32 verbosity;
         double c;
         void *data; // algorithm dependent data
+        cmph_phase_callback_t phase_callback; // reports the construction steps, may be NULL
+        void *phase_data;
 };
 
+#define CMPH_PHASE(mph, phase) do { if ((mph)->phase_callback) (mph)->phase_callback((mph)->phase_data, (phase)); } while (0)
+
 /** Hash querying algorithm data
   */
 struct __cmph_t
@@ -317,5 +317,28 @@ cmph_uint32 compressed_rank_query_packed(void * cr_packed, cmph_uint32 idx)
 	return rank;
 }
 
+void compressed_rank_prefetch_packed(void * cr_packed, cmph_uint32 idx)
+{
+	register cmph_uint32 *ptr = (cmph_uint32 *)cr_packed;
+	register cmph_uint32 max_val = ptr[0];
+	register cmph_uint32 val_quot = idx >> ptr[2];
 
+	if(idx > max_val || val_quot == 0)
+	{
+		return;
+	}
+	select_prefetch_packed(ptr + 4, val_quot - 1);
+}
 
+void compressed_rank_prefetch_bits_packed(void * cr_packed, cmph_uint32 idx)
+{
+	register cmph_uint32 *ptr = (cmph_uint32 *)cr_packed;
+	register cmph_uint32 max_val = ptr[0];
+	register cmph_uint32 val_quot = idx >> ptr[2];
+
+	if(idx > max_val || val_quot == 0)
+	{
+		return;
+	}
+	select_prefetch_bits_packed(ptr + 4, val_quot - 1);
+}
@@ -52,4 +52,18 @@ cmph_uint32 compressed_rank_packed_size(compressed_rank_t *cr);
  */
 cmph_uint32 compressed_rank_query_packed(void * cr_packed, cmph_uint32 idx);
 
+/** \fn void compressed_rank_prefetch_packed(void * cr_packed, cmph_uint32 idx);
+ *  \brief First prefetch step for a later @see compressed_rank_query_packed at index idx: the select table entry.
+ *  \param cr_packed is a pointer to a contiguous memory area
+ *  \param idx is the index that will be queried
+ */
+void compressed_rank_prefetch_packed(void * cr_packed, cmph_uint32 idx);
+
+/** \fn void compressed_rank_prefetch_bits_packed(void * cr_packed, cmph_uint32 idx);
+ *  \brief Second prefetch step for index idx, issued after @see compressed_rank_prefetch_packed: the bit vector bytes.
+ *  \param cr_packed is a pointer to a contiguous memory area
+ *  \param idx is the index that will be queried
+ */
+void compressed_rank_prefetch_bits_packed(void * cr_packed, cmph_uint32 idx);
+
 #endif
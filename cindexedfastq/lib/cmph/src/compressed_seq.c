@@ -376,3 +376,21 @@ cmph_uint32 compressed_seq_query_packed(void * cs_packed, cmph_uint32 idx)
 	stored_value = get_bits_at_pos(store_table, enc_idx, enc_length);
 	return stored_value + ((1U << enc_length) - 1U);
 }
+
+void compressed_seq_prefetch_packed(void * cs_packed, cmph_uint32 idx)
+{
+	register cmph_uint32 *ptr = (cmph_uint32 *)cs_packed;
+	register cmph_uint32 rem_r = ptr[1];
+	register cmph_uint32 buflen_sel = ptr[3];
+	register cmph_uint32 * sel_packed = ptr + 4;
+	register cmph_uint32 * length_rems = sel_packed + (buflen_sel >> 2);
+
+	select_prefetch_packed(sel_packed, idx == 0 ? 0 : idx - 1);
+	CMPH_PREFETCH(length_rems + ((idx * rem_r) >> 5));
+}
+
+void compressed_seq_prefetch_bits_packed(void * cs_packed, cmph_uint32 idx)
+{
+	register cmph_uint32 *sel_packed = (cmph_uint32 *)cs_packed + 4;
+	select_prefetch_bits_packed(sel_packed, idx == 0 ? 0 : idx - 1);
+}
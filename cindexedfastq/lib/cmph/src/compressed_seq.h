@@ -81,4 +81,20 @@ cmph_uint32 compressed_seq_packed_size(compressed_seq_t *cs);
  */
 cmph_uint32 compressed_seq_query_packed(void * cs_packed, cmph_uint32 idx);
 
+/** \fn void compressed_seq_prefetch_packed(void * cs_packed, cmph_uint32 idx);
+ *  \brief First prefetch step for a later @see compressed_seq_query_packed at index idx:
+ *  the select table entry and the length remainders.
+ *  \param cs_packed is a pointer to a contiguous memory area
+ *  \param idx is the index that will be queried
+ */
+void compressed_seq_prefetch_packed(void * cs_packed, cmph_uint32 idx);
+
+/** \fn void compressed_seq_prefetch_bits_packed(void * cs_packed, cmph_uint32 idx);
+ *  \brief Second prefetch step for index idx, issued after @see compressed_seq_prefetch_packed:
+ *  the select bit vector bytes that locate the stored value.
+ *  \param cs_packed is a pointer to a contiguous memory area
+ *  \param idx is the index that will be queried
+ */
+void compressed_seq_prefetch_bits_packed(void * cs_packed, cmph_uint32 idx);
+
 #endif
@@ -7,7 +7,7 @@
 //#define DEBUG
 #include "debug.h"
 
-const char *cmph_hash_names[] = { "jenkins", NULL };
+const char *cmph_hash_names[] = { "jenkins", "mum", NULL };
 
 hash_state_t *hash_state_new(CMPH_HASH hashfunc, cmph_uint32 hashsize)
 {
@@ -19,6 +19,9 @@ hash_state_t *hash_state_new(CMPH_HASH hashfunc, cmph_uint32 hashsize)
 			state = (hash_state_t *)jenkins_state_new(hashsize);
 	  		DEBUGP("Jenkins function created\n");
 			break;
+		case CMPH_HASH_MUM:
+			state = (hash_state_t *)mum_state_new(hashsize);
+			break;
 		default:
 			assert(0);
 	}
@@ -31,6 +34,8 @@ cmph_uint32 hash(hash_state_t *state, const char *key, cmph_uint32 keylen)
 	{
 		case CMPH_HASH_JENKINS:
 			return jenkins_hash((jenkins_state_t *)state, key, keylen);
+		case CMPH_HASH_MUM:
+			return mum_hash((mum_state_t *)state, key, keylen);
 		default:
 			assert(0);
 	}
@@ -45,6 +50,29 @@ void hash_vector(hash_state_t *state, const char *key, cmph_uint32 keylen, cmph_
 		case CMPH_HASH_JENKINS:
 			jenkins_hash_vector_((jenkins_state_t *)state, key, keylen, hashes);
 			break;
+		case CMPH_HASH_MUM:
+			mum_hash_vector_((mum_state_t *)state, key, keylen, hashes);
+			break;
+		default:
+			assert(0);
+	}
+}
+
+void hash_vector_many(hash_state_t *state, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 * hashes)
+{
+	cmph_uint32 i;
+	switch (state->hashfunc)
+	{
+		case CMPH_HASH_JENKINS:
+			jenkins_hash_vector_many_((jenkins_state_t *)state, nkeys, keys, keylens, hashes);
+			break;
+		case CMPH_HASH_MUM:
+			// a few multiplications per key, there is nothing to gain from lanes
+			for (i = 0; i < nkeys; i++)
+			{
+				mum_hash_vector_((mum_state_t *)state, keys[i], keylens[i], hashes + 3 * i);
+			}
+			break;
 		default:
 			assert(0);
 	}
@@ -61,6 +89,12 @@ void hash_state_dump(hash_state_t *state, char **buf, cmph_uint32 *buflen)
 			jenkins_state_dump((jenkins_state_t *)state, &algobuf, buflen);
 			if (*buflen == UINT_MAX) {
                 goto cmph_cleanup;
+            }
+			break;
+		case CMPH_HASH_MUM:
+			mum_state_dump((mum_state_t *)state, &algobuf, buflen);
+			if (*buflen == UINT_MAX) {
+                goto cmph_cleanup;
             }
 			break;
 		default:
@@ -85,6 +119,9 @@ hash_state_t * hash_state_copy(hash_state_t *src_state)
 		case CMPH_HASH_JENKINS:
 			dest_state = (hash_state_t *)jenkins_state_copy((jenkins_state_t *)src_state);
 			break;
+		case CMPH_HASH_MUM:
+			dest_state = (hash_state_t *)mum_state_copy((mum_state_t *)src_state);
+			break;
 		default:
 			assert(0);
 	}
@@ -111,6 +148,8 @@ hash_state_t *hash_state_load(const char *buf, cmph_uint32 buflen)
 	{
 		case CMPH_HASH_JENKINS:
 			return (hash_state_t *)jenkins_state_load(buf + offset, buflen - offset);
+		case CMPH_HASH_MUM:
+			return (hash_state_t *)mum_state_load(buf + offset, buflen - offset);
 		default:
 			return NULL;
 	}
@@ -123,6 +162,9 @@ void hash_state_destroy(hash_state_t *state)
 		case CMPH_HASH_JENKINS:
 			jenkins_state_destroy((jenkins_state_t *)state);
 			break;
+		case CMPH_HASH_MUM:
+			mum_state_destroy((mum_state_t *)state);
+			break;
 		default:
 			assert(0);
 	}
@@ -145,6 +187,9 @@ void hash_state_pack(hash_state_t *state, void *hash_packed)
 			// pack the jenkins hash function
 			jenkins_state_pack((jenkins_state_t *)state, hash_packed);
 			break;
+		case CMPH_HASH_MUM:
+			mum_state_pack((mum_state_t *)state, hash_packed);
+			break;
 		default:
 			assert(0);
 	}
@@ -164,6 +209,9 @@ cmph_uint32 hash_state_packed_size(CMPH_HASH hashfunc)
 		case CMPH_HASH_JENKINS:
 			size += jenkins_state_packed_size();
 			break;
+		case CMPH_HASH_MUM:
+			size += mum_state_packed_size();
+			break;
 		default:
 			assert(0);
 	}
@@ -183,6 +231,8 @@ cmph_uint32 hash_packed(void *hash_packed, CMPH_HASH hashfunc, const char *k, cm
 	{
 		case CMPH_HASH_JENKINS:
 			return jenkins_hash_packed(hash_packed, k, keylen);
+		case CMPH_HASH_MUM:
+			return mum_hash_packed(hash_packed, k, keylen);
 		default:
 			assert(0);
 	}
@@ -203,6 +253,36 @@ void hash_vector_packed(void *hash_packed, CMPH_HASH hashfunc, const char *k, cm
 		case CMPH_HASH_JENKINS:
 			jenkins_hash_vector_packed(hash_packed, k, keylen, hashes);
 			break;
+		case CMPH_HASH_MUM:
+			mum_hash_vector_packed(hash_packed, k, keylen, hashes);
+			break;
+		default:
+			assert(0);
+	}
+}
+
+/** \fn hash_vector_many_packed(void *hash_packed, CMPH_HASH hashfunc, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 * hashes)
+ *  \param hash_packed is a pointer to a contiguous memory area
+ *  \param hashfunc is the type of the hash function packed in hash_packed
+ *  \param nkeys is the number of keys
+ *  \param keys are the keys
+ *  \param keylens are the key lengths
+ *  \param hashes is a pointer to a memory large enough to fit 3*nkeys 32-bit integers.
+ */
+void hash_vector_many_packed(void *hash_packed, CMPH_HASH hashfunc, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 * hashes)
+{
+	cmph_uint32 i;
+	switch (hashfunc)
+	{
+		case CMPH_HASH_JENKINS:
+			jenkins_hash_vector_many_packed(hash_packed, nkeys, keys, keylens, hashes);
+			break;
+		case CMPH_HASH_MUM:
+			for (i = 0; i < nkeys; i++)
+			{
+				mum_hash_vector_packed(hash_packed, keys[i], keylens[i], hashes + 3 * i);
+			}
+			break;
 		default:
 			assert(0);
 	}
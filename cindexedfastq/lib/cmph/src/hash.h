@@ -23,6 +23,17 @@ cmph_uint32 hash(hash_state_t *state, const char *key, cmph_uint32 keylen);
  */
 void hash_vector(hash_state_t *state, const char *key, cmph_uint32 keylen, cmph_uint32 * hashes);
 
+/** \fn void hash_vector_many(hash_state_t *state, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 * hashes);
+ *  \brief Same as hash_vector() for nkeys keys at once, the three values of keys[i] go to hashes[3*i] to hashes[3*i+2].
+ *  Jenkins hashes keys of similar length in the lanes of vector registers.
+ *  \param state is a pointer to a hash_state_t structure
+ *  \param nkeys is the number of keys
+ *  \param keys are the keys
+ *  \param keylens are the key lengths
+ *  \param hashes is a pointer to a memory large enough to fit 3*nkeys 32-bit integers.
+ */
+void hash_vector_many(hash_state_t *state, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 * hashes);
+
 void hash_state_dump(hash_state_t *state, char **buf, cmph_uint32 *buflen);
 
 hash_state_t * hash_state_copy(hash_state_t *src_state);
@@ -66,6 +77,17 @@ cmph_uint32 hash_state_packed_size(CMPH_HASH hashfunc);
  */
 void hash_vector_packed(void *hash_packed, CMPH_HASH hashfunc, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
 
+/** \fn hash_vector_many_packed(void *hash_packed, CMPH_HASH hashfunc, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 * hashes);
+ *  \brief Same as hash_vector_many() for a packed hash function.
+ *  \param hash_packed is a pointer to a contiguous memory area
+ *  \param hashfunc is the type of the hash function packed in hash_packed
+ *  \param nkeys is the number of keys
+ *  \param keys are the keys
+ *  \param keylens are the key lengths
+ *  \param hashes is a pointer to a memory large enough to fit 3*nkeys 32-bit integers.
+ */
+void hash_vector_many_packed(void *hash_packed, CMPH_HASH hashfunc, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 * hashes);
+
 
 /** \fn CMPH_HASH hash_get_type(hash_state_t *state);
  *  \param state is a pointer to a hash_state_t structure
@@ -3,10 +3,12 @@
 
 #include "hash.h"
 #include "jenkins_hash.h"
+#include "mum_hash.h"
 union __hash_state_t
 {
 	CMPH_HASH hashfunc;
 	jenkins_state_t jenkins;
+	mum_state_t mum;
 };
 
 #endif
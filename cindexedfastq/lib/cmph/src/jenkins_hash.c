@@ -1,4 +1,5 @@
 #include "jenkins_hash.h"
+#include "cmph_cpu.h"
 #include <stdlib.h>
 #ifdef WIN32
 #define _USE_MATH_DEFINES //For M_LOG2E
@@ -98,6 +99,38 @@ void jenkins_state_destroy(jenkins_state_t *state)
 }
 
 
+/* Adds the last 0 to 11 bytes of a key to the state, all the case statements fall through */
+static inline void __jenkins_tail(const char *k, cmph_uint32 len, cmph_uint32 *a, cmph_uint32 *b, cmph_uint32 *c)
+{
+	switch(len)
+	{
+		case 11:
+			*c +=((cmph_uint32)k[10]<<24);
+		case 10:
+			*c +=((cmph_uint32)k[9]<<16);
+		case 9 :
+			*c +=((cmph_uint32)k[8]<<8);
+			/* the first byte of c is reserved for the length */
+		case 8 :
+			*b +=((cmph_uint32)k[7]<<24);
+		case 7 :
+			*b +=((cmph_uint32)k[6]<<16);
+		case 6 :
+			*b +=((cmph_uint32)k[5]<<8);
+		case 5 :
+			*b +=(cmph_uint8) k[4];
+		case 4 :
+			*a +=((cmph_uint32)k[3]<<24);
+		case 3 :
+			*a +=((cmph_uint32)k[2]<<16);
+		case 2 :
+			*a +=((cmph_uint32)k[1]<<8);
+		case 1 :
+			*a +=(cmph_uint8)k[0];
+			/* case 0: nothing left to add */
+	}
+}
+
 static inline void __jenkins_hash_vector(cmph_uint32 seed, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes)
 {
 	register cmph_uint32 len, length;
@@ -120,35 +153,269 @@ static inline void __jenkins_hash_vector(cmph_uint32 seed, const char *k, cmph_u
 
 	/*------------------------------------- handle the last 11 bytes */
 	hashes[2]  += length;
-	switch(len)              /* all the case statements fall through */
+	__jenkins_tail(k, len, &hashes[0], &hashes[1], &hashes[2]);
+
+	mix(hashes[0],hashes[1],hashes[2]);
+}
+
+/*
+   --------------------------------------------------------------------
+   Hashing many keys at once. Keys with the same number of 12 byte
+   blocks run through the same sequence of mix() calls, so a group of
+   them is hashed in the lanes of a vector register, one key per lane.
+   The lanes hold exactly the words the scalar loop adds, so the
+   results are bit for bit those of __jenkins_hash_vector.
+
+   mix() runs unchanged on GCC vector extension types. The AVX2 and
+   AVX-512 versions are compiled with the target attribute and gather
+   the words of 8 or 16 keys at once, the widest one the processor
+   supports is picked when first used and other processors hash one
+   key at a time.
+   --------------------------------------------------------------------
+ */
+
+/* One word of a 12 byte block, as the scalar loop computes it from possibly signed chars */
+static inline cmph_uint32 __jenkins_word(const char *k)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	cmph_uint32 w;
+	memcpy(&w, k, sizeof(w));
+	if ((w & 0x80808080U) == 0) return w;
+#endif
+	return (cmph_uint32)k[0] +((cmph_uint32)k[1]<<8) +((cmph_uint32)k[2]<<16) +((cmph_uint32)k[3]<<24);
+}
+
+/* Adds the last 0 to 11 bytes of a key like __jenkins_tail, with word loads when none of the bytes has its high bit set */
+static inline void __jenkins_tail_words(const char *k, cmph_uint32 len, cmph_uint32 *a, cmph_uint32 *b, cmph_uint32 *c)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	cmph_uint32 w[3] = { 0, 0, 0 };
+	memcpy(w, k, len);
+	if (((w[0] | w[1] | w[2]) & 0x80808080U) == 0)
 	{
-		case 11:
-			hashes[2] +=((cmph_uint32)k[10]<<24);
-		case 10:
-			hashes[2] +=((cmph_uint32)k[9]<<16);
-		case 9 :
-			hashes[2] +=((cmph_uint32)k[8]<<8);
-			/* the first byte of hashes[2] is reserved for the length */
-		case 8 :
-			hashes[1] +=((cmph_uint32)k[7]<<24);
-		case 7 :
-			hashes[1] +=((cmph_uint32)k[6]<<16);
-		case 6 :
-			hashes[1] +=((cmph_uint32)k[5]<<8);
-		case 5 :
-			hashes[1] +=(cmph_uint8) k[4];
-		case 4 :
-			hashes[0] +=((cmph_uint32)k[3]<<24);
-		case 3 :
-			hashes[0] +=((cmph_uint32)k[2]<<16);
-		case 2 :
-			hashes[0] +=((cmph_uint32)k[1]<<8);
-		case 1 :
-			hashes[0] +=(cmph_uint8)k[0];
-			/* case 0: nothing left to add */
+		*a += w[0]; *b += w[1]; *c += w[2] << 8;
+		return;
 	}
+#endif
+	__jenkins_tail(k, len, a, b, c);
+}
 
-	mix(hashes[0],hashes[1],hashes[2]);
+/* Keys waiting for lanes are kept in this many groups, one per number of blocks */
+#define JENKINS_MANY_GROUPS 4
+
+#ifdef CMPH_CPU_X86
+#define JENKINS_HAS_LANES
+#include <immintrin.h>
+
+typedef cmph_uint32 jenkins_v8_t __attribute__((vector_size(32)));
+typedef cmph_uint32 jenkins_v16_t __attribute__((vector_size(64)));
+
+/* The words of block blk of each lane's key, for blocks with a byte whose high bit is set */
+static inline void __jenkins_lanes_words(const char **keys, const cmph_uint32 *idx, cmph_uint32 lanes, cmph_uint32 blk,
+		cmph_uint32 *wa, cmph_uint32 *wb, cmph_uint32 *wc)
+{
+	cmph_uint32 i;
+	for (i = 0; i < lanes; i++)
+	{
+		const char *k = keys[idx[i]] + 12 * blk;
+		wa[i] = __jenkins_word(k); wb[i] = __jenkins_word(k + 4); wc[i] = __jenkins_word(k + 8);
+	}
+}
+
+/* What the last 0 to 11 bytes and the length of each lane's key add to the state */
+static inline void __jenkins_lanes_tail(const char **keys, const cmph_uint32 *keylens, const cmph_uint32 *idx, cmph_uint32 lanes,
+		cmph_uint32 nblocks, cmph_uint32 *wa, cmph_uint32 *wb, cmph_uint32 *wc)
+{
+	cmph_uint32 i;
+	for (i = 0; i < lanes; i++)
+	{
+		wa[i] = wb[i] = 0; wc[i] = keylens[idx[i]];
+		__jenkins_tail_words(keys[idx[i]] + 12 * nblocks, keylens[idx[i]] - 12 * nblocks, &wa[i], &wb[i], &wc[i]);
+	}
+}
+
+static inline void __jenkins_lanes_store(const cmph_uint32 *idx, cmph_uint32 lanes, const cmph_uint32 *wa, const cmph_uint32 *wb,
+		const cmph_uint32 *wc, cmph_uint32 *hashes)
+{
+	cmph_uint32 i;
+	for (i = 0; i < lanes; i++)
+	{
+		hashes[3 * idx[i]] = wa[i]; hashes[3 * idx[i] + 1] = wb[i]; hashes[3 * idx[i] + 2] = wc[i];
+	}
+}
+
+/* Hashes the 8 keys keys[idx[0..7]] that have nblocks 12 byte blocks each. The
+ * words of a block are gathered straight from the 8 keys with 64-bit addresses */
+__attribute__((target("avx2")))
+static void __jenkins_hash_lanes_avx2(cmph_uint32 seed, const char **keys, const cmph_uint32 *keylens, const cmph_uint32 *idx,
+		cmph_uint32 nblocks, cmph_uint32 *hashes)
+{
+	cmph_uint32 wa[8], wb[8], wc[8];
+	jenkins_v8_t a, b, c, va, vb, vc;
+	cmph_uint32 blk;
+	const __m256i four = _mm256_set1_epi64x(4), twelve = _mm256_set1_epi64x(12);
+	const __m256i high = _mm256_set1_epi32((int)0x80808080U);
+	__m256i p0 = _mm256_i32gather_epi64((const long long *)keys, _mm_loadu_si128((const __m128i *)idx), 8);
+	__m256i p1 = _mm256_i32gather_epi64((const long long *)keys, _mm_loadu_si128((const __m128i *)(idx + 4)), 8);
+
+	a = b = (jenkins_v8_t)_mm256_set1_epi32((int)0x9e3779b9U);
+	c = (jenkins_v8_t)_mm256_set1_epi32((int)seed);
+	for (blk = 0; blk < nblocks; blk++)
+	{
+		__m256i q0 = _mm256_add_epi64(p0, four), q1 = _mm256_add_epi64(p1, four);
+		__m256i r0 = _mm256_add_epi64(q0, four), r1 = _mm256_add_epi64(q1, four);
+		va = (jenkins_v8_t)_mm256_set_m128i(_mm256_i64gather_epi32((const int *)0, p1, 1), _mm256_i64gather_epi32((const int *)0, p0, 1));
+		vb = (jenkins_v8_t)_mm256_set_m128i(_mm256_i64gather_epi32((const int *)0, q1, 1), _mm256_i64gather_epi32((const int *)0, q0, 1));
+		vc = (jenkins_v8_t)_mm256_set_m128i(_mm256_i64gather_epi32((const int *)0, r1, 1), _mm256_i64gather_epi32((const int *)0, r0, 1));
+		if (!_mm256_testz_si256(_mm256_or_si256(_mm256_or_si256((__m256i)va, (__m256i)vb), (__m256i)vc), high))
+		{
+			__jenkins_lanes_words(keys, idx, 8, blk, wa, wb, wc);
+			memcpy(&va, wa, sizeof(va)); memcpy(&vb, wb, sizeof(vb)); memcpy(&vc, wc, sizeof(vc));
+		}
+		a += va; b += vb; c += vc;
+		mix(a, b, c);
+		p0 = _mm256_add_epi64(p0, twelve); p1 = _mm256_add_epi64(p1, twelve);
+	}
+
+	__jenkins_lanes_tail(keys, keylens, idx, 8, nblocks, wa, wb, wc);
+	memcpy(&va, wa, sizeof(va)); memcpy(&vb, wb, sizeof(vb)); memcpy(&vc, wc, sizeof(vc));
+	a += va; b += vb; c += vc;
+	mix(a, b, c);
+	memcpy(wa, &a, sizeof(a)); memcpy(wb, &b, sizeof(b)); memcpy(wc, &c, sizeof(c));
+	__jenkins_lanes_store(idx, 8, wa, wb, wc, hashes);
+}
+
+/* Same as __jenkins_hash_lanes_avx2 for 16 keys */
+__attribute__((target("avx512f")))
+static void __jenkins_hash_lanes_avx512(cmph_uint32 seed, const char **keys, const cmph_uint32 *keylens, const cmph_uint32 *idx,
+		cmph_uint32 nblocks, cmph_uint32 *hashes)
+{
+	cmph_uint32 wa[16], wb[16], wc[16];
+	jenkins_v16_t a, b, c, va, vb, vc;
+	cmph_uint32 blk;
+	const __m512i four = _mm512_set1_epi64(4), twelve = _mm512_set1_epi64(12);
+	const __m512i high = _mm512_set1_epi32((int)0x80808080U);
+	__m512i p0 = _mm512_i32gather_epi64(_mm256_loadu_si256((const __m256i *)idx), (const void *)keys, 8);
+	__m512i p1 = _mm512_i32gather_epi64(_mm256_loadu_si256((const __m256i *)(idx + 8)), (const void *)keys, 8);
+
+	a = b = (jenkins_v16_t)_mm512_set1_epi32((int)0x9e3779b9U);
+	c = (jenkins_v16_t)_mm512_set1_epi32((int)seed);
+	for (blk = 0; blk < nblocks; blk++)
+	{
+		__m512i q0 = _mm512_add_epi64(p0, four), q1 = _mm512_add_epi64(p1, four);
+		__m512i r0 = _mm512_add_epi64(q0, four), r1 = _mm512_add_epi64(q1, four);
+		va = (jenkins_v16_t)_mm512_inserti64x4(_mm512_castsi256_si512(_mm512_i64gather_epi32(p0, (const void *)0, 1)), _mm512_i64gather_epi32(p1, (const void *)0, 1), 1);
+		vb = (jenkins_v16_t)_mm512_inserti64x4(_mm512_castsi256_si512(_mm512_i64gather_epi32(q0, (const void *)0, 1)), _mm512_i64gather_epi32(q1, (const void *)0, 1), 1);
+		vc = (jenkins_v16_t)_mm512_inserti64x4(_mm512_castsi256_si512(_mm512_i64gather_epi32(r0, (const void *)0, 1)), _mm512_i64gather_epi32(r1, (const void *)0, 1), 1);
+		if (_mm512_test_epi32_mask(_mm512_or_si512(_mm512_or_si512((__m512i)va, (__m512i)vb), (__m512i)vc), high))
+		{
+			__jenkins_lanes_words(keys, idx, 16, blk, wa, wb, wc);
+			memcpy(&va, wa, sizeof(va)); memcpy(&vb, wb, sizeof(vb)); memcpy(&vc, wc, sizeof(vc));
+		}
+		a += va; b += vb; c += vc;
+		mix(a, b, c);
+		p0 = _mm512_add_epi64(p0, twelve); p1 = _mm512_add_epi64(p1, twelve);
+	}
+
+	__jenkins_lanes_tail(keys, keylens, idx, 16, nblocks, wa, wb, wc);
+	memcpy(&va, wa, sizeof(va)); memcpy(&vb, wb, sizeof(vb)); memcpy(&vc, wc, sizeof(vc));
+	a += va; b += vb; c += vc;
+	mix(a, b, c);
+	memcpy(wa, &a, sizeof(a)); memcpy(wb, &b, sizeof(b)); memcpy(wc, &c, sizeof(c));
+	__jenkins_lanes_store(idx, 16, wa, wb, wc, hashes);
+}
+
+typedef void (*jenkins_lanes_fn_t)(cmph_uint32, const char **, const cmph_uint32 *, const cmph_uint32 *, cmph_uint32, cmph_uint32 *);
+
+/* Lane widths from the widest down, ending with a zero width */
+static cmph_uint32 jenkins_lanes_width[3];
+static jenkins_lanes_fn_t jenkins_lanes_fn[3];
+static int jenkins_lanes_ready = 0;
+
+static void __jenkins_lanes_init(void)
+{
+	int n = 0;
+	cmph_uint32 features = cmph_cpu_features();
+	if (features & CMPH_CPU_AVX512)
+	{
+		jenkins_lanes_width[n] = 16; jenkins_lanes_fn[n++] = __jenkins_hash_lanes_avx512;
+	}
+	if (features & CMPH_CPU_AVX2)
+	{
+		jenkins_lanes_width[n] = 8; jenkins_lanes_fn[n++] = __jenkins_hash_lanes_avx2;
+	}
+	jenkins_lanes_ready = 1;
+}
+
+/* Hashes the keys of a group, as many as possible in the widest lanes */
+static void __jenkins_flush_group(cmph_uint32 seed, const char **keys, const cmph_uint32 *keylens, const cmph_uint32 *idx,
+		cmph_uint32 count, cmph_uint32 nblocks, cmph_uint32 *hashes)
+{
+	cmph_uint32 i = 0, w;
+	for (w = 0; jenkins_lanes_width[w] > 0; w++)
+	{
+		for (; count - i >= jenkins_lanes_width[w]; i += jenkins_lanes_width[w])
+		{
+			jenkins_lanes_fn[w](seed, keys, keylens, idx + i, nblocks, hashes);
+		}
+	}
+	for (; i < count; i++)
+	{
+		__jenkins_hash_vector(seed, keys[idx[i]], keylens[idx[i]], hashes + 3 * idx[i]);
+	}
+}
+#endif
+
+static void __jenkins_hash_vector_many(cmph_uint32 seed, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 *hashes)
+{
+	cmph_uint32 i = 0;
+#ifdef JENKINS_HAS_LANES
+	/* Keys are collected into groups of the same number of blocks, reads of one file
+	 * mostly have one or a few lengths, and a group is hashed once it fills the lanes */
+	cmph_uint32 idx[JENKINS_MANY_GROUPS][16];
+	cmph_uint32 blocks[JENKINS_MANY_GROUPS], count[JENKINS_MANY_GROUPS];
+	cmph_uint32 g, width, fullest;
+	if (!jenkins_lanes_ready) __jenkins_lanes_init();
+	width = jenkins_lanes_width[0];
+	for (g = 0; g < JENKINS_MANY_GROUPS; g++) count[g] = 0;
+	for (; width > 0 && i < nkeys; i++)
+	{
+		cmph_uint32 nblocks = keylens[i] / 12;
+		fullest = 0;
+		for (g = 0; g < JENKINS_MANY_GROUPS; g++)
+		{
+			if (count[g] > 0 && blocks[g] == nblocks) break;
+			if (count[g] > count[fullest]) fullest = g;
+		}
+		if (g == JENKINS_MANY_GROUPS)
+		{
+			/* A new length, it takes an empty group or the fullest one is hashed to make room */
+			for (g = 0; g < JENKINS_MANY_GROUPS && count[g] > 0; g++);
+			if (g == JENKINS_MANY_GROUPS)
+			{
+				g = fullest;
+				__jenkins_flush_group(seed, keys, keylens, idx[g], count[g], blocks[g], hashes);
+				count[g] = 0;
+			}
+			blocks[g] = nblocks;
+		}
+		idx[g][count[g]++] = i;
+		if (count[g] == width)
+		{
+			jenkins_lanes_fn[0](seed, keys, keylens, idx[g], nblocks, hashes);
+			count[g] = 0;
+		}
+	}
+	for (g = 0; g < JENKINS_MANY_GROUPS; g++)
+	{
+		if (count[g] > 0) __jenkins_flush_group(seed, keys, keylens, idx[g], count[g], blocks[g], hashes);
+	}
+#endif
+	/* Without vector lanes every key is hashed on its own */
+	for (; i < nkeys; i++)
+	{
+		__jenkins_hash_vector(seed, keys[i], keylens[i], hashes + 3 * i);
+	}
 }
 
 cmph_uint32 jenkins_hash(jenkins_state_t *state, const char *k, cmph_uint32 keylen)
@@ -218,6 +485,11 @@ void jenkins_hash_vector_(jenkins_state_t *state, const char *k, cmph_uint32 key
 	__jenkins_hash_vector(state->seed, k, keylen, hashes);
 }
 
+void jenkins_hash_vector_many_(jenkins_state_t *state, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 * hashes)
+{
+	__jenkins_hash_vector_many(state->seed, nkeys, keys, keylens, hashes);
+}
+
 void jenkins_state_dump(jenkins_state_t *state, char **buf, cmph_uint32 *buflen)
 {
 	*buflen = sizeof(cmph_uint32);
@@ -296,3 +568,15 @@ void jenkins_hash_vector_packed(void *jenkins_packed, const char *k, cmph_uint32
 {
 	__jenkins_hash_vector(*((cmph_uint32 *)jenkins_packed), k, keylen, hashes);
 }
+
+/** \fn jenkins_hash_vector_many_packed(void *jenkins_packed, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 * hashes);
+ *  \param jenkins_packed is a pointer to a contiguous memory area
+ *  \param nkeys is the number of keys
+ *  \param keys are the keys
+ *  \param keylens are the key lengths
+ *  \param hashes is a pointer to a memory large enough to fit 3*nkeys 32-bit integers.
+ */
+void jenkins_hash_vector_many_packed(void *jenkins_packed, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 * hashes)
+{
+	__jenkins_hash_vector_many(*((cmph_uint32 *)jenkins_packed), nkeys, keys, keylens, hashes);
+}
@@ -27,6 +27,16 @@ cmph_uint32 jenkins_hash(jenkins_state_t *state, const char *k, cmph_uint32 keyl
  */
 void jenkins_hash_vector_(jenkins_state_t *state, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
 
+/** \fn void jenkins_hash_vector_many_(jenkins_state_t *state, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 * hashes);
+ *  \brief Hashes nkeys keys, keys with the same number of 12 byte blocks are hashed together in vector lanes.
+ *  \param state is a pointer to a jenkins_state_t structure
+ *  \param nkeys is the number of keys
+ *  \param keys are the keys
+ *  \param keylens are the key lengths
+ *  \param hashes is a pointer to a memory large enough to fit 3*nkeys 32-bit integers.
+ */
+void jenkins_hash_vector_many_(jenkins_state_t *state, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 * hashes);
+
 void jenkins_state_dump(jenkins_state_t *state, char **buf, cmph_uint32 *buflen);
 jenkins_state_t *jenkins_state_copy(jenkins_state_t *src_state);
 jenkins_state_t *jenkins_state_load(const char *buf, cmph_uint32 buflen);
@@ -62,4 +72,13 @@ cmph_uint32 jenkins_hash_packed(void *jenkins_packed, const char *k, cmph_uint32
  */
 void jenkins_hash_vector_packed(void *jenkins_packed, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
 
+/** \fn jenkins_hash_vector_many_packed(void *jenkins_packed, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 * hashes);
+ *  \param jenkins_packed is a pointer to a contiguous memory area
+ *  \param nkeys is the number of keys
+ *  \param keys are the keys
+ *  \param keylens are the key lengths
+ *  \param hashes is a pointer to a memory large enough to fit 3*nkeys 32-bit integers.
+ */
+void jenkins_hash_vector_many_packed(void *jenkins_packed, cmph_uint32 nkeys, const char **keys, const cmph_uint32 *keylens, cmph_uint32 * hashes);
+
 #endif
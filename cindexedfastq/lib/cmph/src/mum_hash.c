@@ -0,0 +1,251 @@
+#include "mum_hash.h"
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+
+//#define DEBUG
+#include "debug.h"
+
+/*
+   --------------------------------------------------------------------
+   A multiply-mix hash in the style of wyhash and mum-hash.
+
+   The key is consumed 16 bytes at a time, and every pair of 64-bit
+   words is folded by one 64x64->128 bit multiplication whose two
+   halves are xored together. Keys of up to 16 bytes take two
+   overlapping reads and a single multiplication. On 64-bit targets
+   this is a handful of instructions per 16 bytes, where Jenkins
+   spends about 36 dependent instructions and a byte by byte tail on
+   every 12 bytes, which matters for the 40-60 byte read names that
+   are hashed both when building and when querying.
+
+   The words are read little endian on every machine, so the hash
+   values do not depend on the byte order, as with Jenkins.
+   --------------------------------------------------------------------
+ */
+static const cmph_uint64 mum_p0 = 0xa0761d6478bd642fULL;
+static const cmph_uint64 mum_p1 = 0xe7037ed1a0b428dbULL;
+static const cmph_uint64 mum_p2 = 0x8ebc6af09c88c6e3ULL;
+static const cmph_uint64 mum_p3 = 0x589965cc75374cc3ULL;
+
+static inline void __mum_multiply(cmph_uint64 *a, cmph_uint64 *b)
+{
+#if defined(__SIZEOF_INT128__)
+	__uint128_t r = (__uint128_t)(*a) * (*b);
+	*a = (cmph_uint64)r;
+	*b = (cmph_uint64)(r >> 64);
+#else
+	cmph_uint64 ha = *a >> 32, hb = *b >> 32, la = (cmph_uint32)*a, lb = (cmph_uint32)*b;
+	cmph_uint64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	cmph_uint64 t = rl + (rm0 << 32), c = t < rl;
+	cmph_uint64 lo = t + (rm1 << 32);
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline cmph_uint64 __mum_mix(cmph_uint64 a, cmph_uint64 b)
+{
+	__mum_multiply(&a, &b);
+	return a ^ b;
+}
+
+static inline cmph_uint64 __mum_read64(const char *p)
+{
+	cmph_uint64 v;
+	memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+}
+
+static inline cmph_uint64 __mum_read32(const char *p)
+{
+	cmph_uint32 v;
+	memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap32(v);
+#endif
+	return v;
+}
+
+static inline cmph_uint64 __mum_read3(const char *p, cmph_uint32 keylen)
+{
+	return ((cmph_uint64)(cmph_uint8)p[0] << 16) | ((cmph_uint64)(cmph_uint8)p[keylen >> 1] << 8) | (cmph_uint8)p[keylen - 1];
+}
+
+static inline cmph_uint64 __mum_hash64(cmph_uint64 seed, const char *k, cmph_uint32 keylen)
+{
+	const char *p = k;
+	cmph_uint64 a, b;
+
+	seed ^= __mum_mix(seed ^ mum_p0, mum_p1);
+	if (keylen <= 16)
+	{
+		if (keylen >= 4)
+		{
+			/* Two overlapping pairs of 32-bit reads cover 4 to 16 bytes */
+			cmph_uint32 middle = (keylen >> 3) << 2;
+			a = (__mum_read32(p) << 32) | __mum_read32(p + middle);
+			b = (__mum_read32(p + keylen - 4) << 32) | __mum_read32(p + keylen - 4 - middle);
+		}
+		else if (keylen > 0)
+		{
+			a = __mum_read3(p, keylen);
+			b = 0;
+		}
+		else
+		{
+			a = b = 0;
+		}
+	}
+	else
+	{
+		cmph_uint32 i = keylen;
+		if (i > 48)
+		{
+			/* Three independent chains keep the multiplier busy */
+			cmph_uint64 seed1 = seed, seed2 = seed;
+			do
+			{
+				seed = __mum_mix(__mum_read64(p) ^ mum_p1, __mum_read64(p + 8) ^ seed);
+				seed1 = __mum_mix(__mum_read64(p + 16) ^ mum_p2, __mum_read64(p + 24) ^ seed1);
+				seed2 = __mum_mix(__mum_read64(p + 32) ^ mum_p3, __mum_read64(p + 40) ^ seed2);
+				p += 48; i -= 48;
+			} while (i > 48);
+			seed ^= seed1 ^ seed2;
+		}
+		while (i > 16)
+		{
+			seed = __mum_mix(__mum_read64(p) ^ mum_p1, __mum_read64(p + 8) ^ seed);
+			p += 16; i -= 16;
+		}
+		/* The last 16 bytes, overlapping what was already consumed */
+		a = __mum_read64(p + i - 16);
+		b = __mum_read64(p + i - 8);
+	}
+
+	a ^= mum_p1;
+	b ^= seed;
+	__mum_multiply(&a, &b);
+	return __mum_mix(a ^ mum_p0 ^ keylen, b ^ mum_p1);
+}
+
+static inline void __mum_hash_vector(cmph_uint64 seed, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes)
+{
+	cmph_uint64 h = __mum_hash64(seed, k, keylen);
+	cmph_uint64 g = __mum_mix(h ^ mum_p2, seed ^ mum_p3);
+
+	/* As for Jenkins the third value equals the scalar hash, BRZ
+	 * relies on it to find the bucket of a key */
+	hashes[0] = (cmph_uint32)(h >> 32);
+	hashes[1] = (cmph_uint32)g;
+	hashes[2] = (cmph_uint32)h;
+}
+
+mum_state_t *mum_state_new(cmph_uint32 size) //size of hash table
+{
+	mum_state_t *state = (mum_state_t *)malloc(sizeof(mum_state_t));
+	if (!state) return NULL;
+	DEBUGP("Initializing mum hash\n");
+	state->seed = ((cmph_uint64)rand() << 40) ^ ((cmph_uint64)rand() << 20) ^ (cmph_uint64)rand();
+	return state;
+}
+
+void mum_state_destroy(mum_state_t *state)
+{
+	free(state);
+}
+
+cmph_uint32 mum_hash(mum_state_t *state, const char *k, cmph_uint32 keylen)
+{
+	return (cmph_uint32)__mum_hash64(state->seed, k, keylen);
+}
+
+void mum_hash_vector_(mum_state_t *state, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes)
+{
+	__mum_hash_vector(state->seed, k, keylen, hashes);
+}
+
+void mum_state_dump(mum_state_t *state, char **buf, cmph_uint32 *buflen)
+{
+	*buflen = sizeof(cmph_uint64);
+	*buf = (char *)malloc(sizeof(cmph_uint64));
+	if (!*buf)
+	{
+		*buflen = UINT_MAX;
+		return;
+	}
+	memcpy(*buf, &(state->seed), sizeof(cmph_uint64));
+	DEBUGP("Dumped mum state with seed %llu\n", (unsigned long long)state->seed);
+	return;
+}
+
+mum_state_t *mum_state_copy(mum_state_t *src_state)
+{
+	mum_state_t *dest_state = (mum_state_t *)malloc(sizeof(mum_state_t));
+	dest_state->hashfunc = src_state->hashfunc;
+	dest_state->seed = src_state->seed;
+	return dest_state;
+}
+
+mum_state_t *mum_state_load(const char *buf, cmph_uint32 buflen)
+{
+	mum_state_t *state = (mum_state_t *)malloc(sizeof(mum_state_t));
+	memcpy(&(state->seed), buf, sizeof(cmph_uint64));
+	state->hashfunc = CMPH_HASH_MUM;
+	DEBUGP("Loaded mum state with seed %llu\n", (unsigned long long)state->seed);
+	return state;
+}
+
+
+/** \fn void mum_state_pack(mum_state_t *state, void *mum_packed);
+ *  \brief Support the ability to pack a mum function into a preallocated contiguous memory space pointed by mum_packed.
+ *  \param state points to the mum function
+ *  \param mum_packed pointer to the contiguous memory area used to store the mum function. The size of mum_packed must be at least mum_state_packed_size()
+ */
+void mum_state_pack(mum_state_t *state, void *mum_packed)
+{
+	if (state && mum_packed)
+	{
+		memcpy(mum_packed, &(state->seed), sizeof(cmph_uint64));
+	}
+}
+
+/** \fn cmph_uint32 mum_state_packed_size(void);
+ *  \brief Return the amount of space needed to pack a mum function.
+ *  \return the size of the packed function or zero for failures
+ */
+cmph_uint32 mum_state_packed_size(void)
+{
+	return sizeof(cmph_uint64);
+}
+
+
+/** \fn cmph_uint32 mum_hash_packed(void *mum_packed, const char *k, cmph_uint32 keylen);
+ *  \param mum_packed is a pointer to a contiguous memory area
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \return an integer that represents a hash value of 32 bits.
+ */
+cmph_uint32 mum_hash_packed(void *mum_packed, const char *k, cmph_uint32 keylen)
+{
+	cmph_uint64 seed;
+	memcpy(&seed, mum_packed, sizeof(cmph_uint64));
+	return (cmph_uint32)__mum_hash64(seed, k, keylen);
+}
+
+/** \fn mum_hash_vector_packed(void *mum_packed, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
+ *  \param mum_packed is a pointer to a contiguous memory area
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \param hashes is a pointer to a memory large enough to fit three 32-bit integers.
+ */
+void mum_hash_vector_packed(void *mum_packed, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes)
+{
+	cmph_uint64 seed;
+	memcpy(&seed, mum_packed, sizeof(cmph_uint64));
+	__mum_hash_vector(seed, k, keylen, hashes);
+}
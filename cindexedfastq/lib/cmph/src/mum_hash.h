@@ -0,0 +1,65 @@
+#ifndef __MUM_HASH_H__
+#define __MUM_HASH_H__
+
+#include "hash.h"
+
+typedef struct __mum_state_t
+{
+	CMPH_HASH hashfunc;
+	cmph_uint64 seed;
+} mum_state_t;
+
+mum_state_t *mum_state_new(cmph_uint32 size); //size of hash table
+
+/** \fn cmph_uint32 mum_hash(mum_state_t *state, const char *k, cmph_uint32 keylen);
+ *  \param state is a pointer to a mum_state_t structure
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \return an integer that represents a hash value of 32 bits.
+ */
+cmph_uint32 mum_hash(mum_state_t *state, const char *k, cmph_uint32 keylen);
+
+/** \fn void mum_hash_vector_(mum_state_t *state, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
+ *  \param state is a pointer to a mum_state_t structure
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \param hashes is a pointer to a memory large enough to fit three 32-bit integers.
+ */
+void mum_hash_vector_(mum_state_t *state, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
+
+void mum_state_dump(mum_state_t *state, char **buf, cmph_uint32 *buflen);
+mum_state_t *mum_state_copy(mum_state_t *src_state);
+mum_state_t *mum_state_load(const char *buf, cmph_uint32 buflen);
+void mum_state_destroy(mum_state_t *state);
+
+/** \fn void mum_state_pack(mum_state_t *state, void *mum_packed);
+ *  \brief Support the ability to pack a mum function into a preallocated contiguous memory space pointed by mum_packed.
+ *  \param state points to the mum function
+ *  \param mum_packed pointer to the contiguous memory area used to store the mum function. The size of mum_packed must be at least mum_state_packed_size()
+ */
+void mum_state_pack(mum_state_t *state, void *mum_packed);
+
+/** \fn cmph_uint32 mum_state_packed_size();
+ *  \brief Return the amount of space needed to pack a mum function.
+ *  \return the size of the packed function or zero for failures
+ */
+cmph_uint32 mum_state_packed_size(void);
+
+
+/** \fn cmph_uint32 mum_hash_packed(void *mum_packed, const char *k, cmph_uint32 keylen);
+ *  \param mum_packed is a pointer to a contiguous memory area
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \return an integer that represents a hash value of 32 bits.
+ */
+cmph_uint32 mum_hash_packed(void *mum_packed, const char *k, cmph_uint32 keylen);
+
+/** \fn mum_hash_vector_packed(void *mum_packed, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
+ *  \param mum_packed is a pointer to a contiguous memory area
+ *  \param key is a pointer to a key
+ *  \param keylen is the key length
+ *  \param hashes is a pointer to a memory large enough to fit three 32-bit integers.
+ */
+void mum_hash_vector_packed(void *mum_packed, const char *k, cmph_uint32 keylen, cmph_uint32 * hashes);
+
+#endif
@@ -5,6 +5,7 @@
 #include <limits.h>
 #include "select_lookup_tables.h"
 #include "select.h"
+#include "cmph_cpu.h"
 
 //#define DEBUG
 #include "debug.h"
@@ -187,10 +188,6 @@ static inline cmph_uint32 _select_query(cmph_uint8 * bits_table, cmph_uint32 * s
 	return select_lookup_table[bits_table[vec_byte_idx - 1]][one_idx - old_part_sum] + ((vec_byte_idx-1) << 3);
 }
 
-cmph_uint32 select_query(select_t * sel, cmph_uint32 one_idx)
-{
-	return _select_query((cmph_uint8 *)sel->bits_vec, sel->select_table, one_idx);
-};
 
 
 static inline cmph_uint32 _select_next_query(cmph_uint8 * bits_table, cmph_uint32 vec_bit_idx)
@@ -214,9 +211,129 @@ static inline cmph_uint32 _select_next_query(cmph_uint8 * bits_table, cmph_uint3
 	return select_lookup_table[bits_table[(vec_byte_idx - 1)]][(one_idx - old_part_sum)] + ((vec_byte_idx - 1) << 3);
 }
 
+#ifdef CMPH_CPU_X86
+#define SELECT_HAS_HW
+#include <immintrin.h>
+
+/*
+ * Kernels for processors with POPCNT and TZCNT, they skip a 32-bit word of
+ * the bit vector per step instead of a byte, and find the bit in the last
+ * word with PDEP. The bit vector is little endian, so bit i of the byte
+ * layout used above is bit i % 32 of word i / 32.
+ */
+#define SELECT_HW_TARGET "popcnt,bmi"
+
+static inline cmph_uint32 _select_hw_scan(const cmph_uint32 * words, cmph_uint32 vec_bit_idx, cmph_uint32 *one_idx, cmph_uint32 *word)
+{
+	register cmph_uint32 word_idx = vec_bit_idx >> 5;
+	register cmph_uint32 w = words[word_idx] & ~((1U << (vec_bit_idx & 0x1f)) - 1U); // drops the bits before vec_bit_idx
+	register cmph_uint32 ones;
+	while ((ones = (cmph_uint32)__builtin_popcount(w)) <= *one_idx)
+	{
+		*one_idx -= ones;
+		w = words[++word_idx];
+	}
+	*word = w;
+	return word_idx;
+}
+
+__attribute__((target(SELECT_HW_TARGET ",bmi2")))
+static cmph_uint32 _select_query_bmi2(cmph_uint8 * bits_table, cmph_uint32 * select_table, cmph_uint32 one_idx)
+{
+	cmph_uint32 word;
+	register cmph_uint32 vec_bit_idx = select_table[one_idx >> NBITS_STEP_SELECT_TABLE];
+	register cmph_uint32 word_idx;
+	one_idx &= MASK_STEP_SELECT_TABLE;
+	word_idx = _select_hw_scan((cmph_uint32 *)bits_table, vec_bit_idx, &one_idx, &word);
+	return (word_idx << 5) + _tzcnt_u32(_pdep_u32(1U << one_idx, word));
+}
+
+/* For processors where PDEP is microcoded, this one clears the lower ones instead */
+__attribute__((target(SELECT_HW_TARGET)))
+static cmph_uint32 _select_query_popcnt(cmph_uint8 * bits_table, cmph_uint32 * select_table, cmph_uint32 one_idx)
+{
+	cmph_uint32 word;
+	register cmph_uint32 vec_bit_idx = select_table[one_idx >> NBITS_STEP_SELECT_TABLE];
+	register cmph_uint32 word_idx;
+	one_idx &= MASK_STEP_SELECT_TABLE;
+	word_idx = _select_hw_scan((cmph_uint32 *)bits_table, vec_bit_idx, &one_idx, &word);
+	while (one_idx--)
+	{
+		word &= word - 1;
+	}
+	return (word_idx << 5) + _tzcnt_u32(word);
+}
+
+__attribute__((target(SELECT_HW_TARGET)))
+static cmph_uint32 _select_next_query_popcnt(cmph_uint8 * bits_table, cmph_uint32 vec_bit_idx)
+{
+	register const cmph_uint32 * words = (cmph_uint32 *)bits_table;
+	register cmph_uint32 word_idx = vec_bit_idx >> 5;
+	register cmph_uint32 w = words[word_idx] & ~((2U << (vec_bit_idx & 0x1f)) - 1U); // drops the bits up to vec_bit_idx
+	while (w == 0)
+	{
+		w = words[++word_idx];
+	}
+	return (word_idx << 5) + _tzcnt_u32(w);
+}
+#endif
+
+typedef cmph_uint32 (*select_query_fn_t)(cmph_uint8 * bits_table, cmph_uint32 * select_table, cmph_uint32 one_idx);
+typedef cmph_uint32 (*select_next_query_fn_t)(cmph_uint8 * bits_table, cmph_uint32 vec_bit_idx);
+
+static cmph_uint32 _select_query_table(cmph_uint8 * bits_table, cmph_uint32 * select_table, cmph_uint32 one_idx)
+{
+	return _select_query(bits_table, select_table, one_idx);
+}
+
+static cmph_uint32 _select_next_query_table(cmph_uint8 * bits_table, cmph_uint32 vec_bit_idx)
+{
+	return _select_next_query(bits_table, vec_bit_idx);
+}
+
+static cmph_uint32 _select_query_init(cmph_uint8 * bits_table, cmph_uint32 * select_table, cmph_uint32 one_idx);
+static cmph_uint32 _select_next_query_init(cmph_uint8 * bits_table, cmph_uint32 vec_bit_idx);
+
+// the kernels are chosen on the first query, from the features of the processor
+static select_query_fn_t select_query_fn = _select_query_init;
+static select_next_query_fn_t select_next_query_fn = _select_next_query_init;
+
+static void select_choose_kernels(void)
+{
+	select_query_fn_t query = _select_query_table;
+	select_next_query_fn_t next_query = _select_next_query_table;
+#ifdef SELECT_HAS_HW
+	cmph_uint32 features = cmph_cpu_features();
+	if ((features & CMPH_CPU_POPCNT) && (features & CMPH_CPU_BMI))
+	{
+		next_query = _select_next_query_popcnt;
+		query = (features & CMPH_CPU_BMI2) ? _select_query_bmi2 : _select_query_popcnt;
+	}
+#endif
+	select_query_fn = query;
+	select_next_query_fn = next_query;
+}
+
+static cmph_uint32 _select_query_init(cmph_uint8 * bits_table, cmph_uint32 * select_table, cmph_uint32 one_idx)
+{
+	select_choose_kernels();
+	return select_query_fn(bits_table, select_table, one_idx);
+}
+
+static cmph_uint32 _select_next_query_init(cmph_uint8 * bits_table, cmph_uint32 vec_bit_idx)
+{
+	select_choose_kernels();
+	return select_next_query_fn(bits_table, vec_bit_idx);
+}
+
+cmph_uint32 select_query(select_t * sel, cmph_uint32 one_idx)
+{
+	return select_query_fn((cmph_uint8 *)sel->bits_vec, sel->select_table, one_idx);
+};
+
 cmph_uint32 select_next_query(select_t * sel, cmph_uint32 vec_bit_idx)
 {
-	return _select_next_query((cmph_uint8 *)sel->bits_vec, vec_bit_idx);
+	return select_next_query_fn((cmph_uint8 *)sel->bits_vec, vec_bit_idx);
 };
 
 void select_dump(select_t *sel, char **buf, cmph_uint32 *buflen)
@@ -325,7 +442,7 @@ cmph_uint32 select_query_packed(void * sel_packed, cmph_uint32 one_idx)
 	register cmph_uint8 * bits_vec = (cmph_uint8 *)ptr;
 	register cmph_uint32 * select_table = ptr + vec_size;
 	
-	return _select_query(bits_vec, select_table, one_idx);
+	return select_query_fn(bits_vec, select_table, one_idx);
 }
 
 
@@ -333,5 +450,24 @@ cmph_uint32 select_next_query_packed(void * sel_packed, cmph_uint32 vec_bit_idx)
 {
 	register cmph_uint8 * bits_vec = (cmph_uint8 *)sel_packed;
 	bits_vec += 8; // skipping n and m
-	return _select_next_query(bits_vec, vec_bit_idx);
+	return select_next_query_fn(bits_vec, vec_bit_idx);
+}
+
+void select_prefetch_packed(void * sel_packed, cmph_uint32 one_idx)
+{
+	register cmph_uint32 *ptr = (cmph_uint32 *)sel_packed;
+	register cmph_uint32 n = *ptr++;
+	register cmph_uint32 m = *ptr++;
+	register cmph_uint32 vec_size = (n + m + 31) >> 5;
+	CMPH_PREFETCH(ptr + vec_size + (one_idx >> NBITS_STEP_SELECT_TABLE));
+}
+
+void select_prefetch_bits_packed(void * sel_packed, cmph_uint32 one_idx)
+{
+	register cmph_uint32 *ptr = (cmph_uint32 *)sel_packed;
+	register cmph_uint32 n = *ptr++;
+	register cmph_uint32 m = *ptr++;
+	register cmph_uint32 vec_size = (n + m + 31) >> 5;
+	register cmph_uint32 vec_bit_idx = ptr[vec_size + (one_idx >> NBITS_STEP_SELECT_TABLE)];
+	CMPH_PREFETCH((cmph_uint8 *)ptr + (vec_bit_idx >> 3));
 }
@@ -3,6 +3,14 @@
 
 #include "cmph_types.h"
 
+/* Hints the cache that addr will be read soon. Searches over many keys
+ * issue these a few steps ahead so the misses of different keys overlap */
+#if defined(__GNUC__)
+#define CMPH_PREFETCH(addr) __builtin_prefetch((const void *)(addr), 0, 3)
+#else
+#define CMPH_PREFETCH(addr) ((void)(addr))
+#endif
+
 struct _select_t
 {
 	cmph_uint32 n,m;
@@ -58,4 +66,19 @@ cmph_uint32 select_query_packed(void * sel_packed, cmph_uint32 one_idx);
  */
 cmph_uint32 select_next_query_packed(void * sel_packed, cmph_uint32 vec_bit_idx);
 
+/** \fn void select_prefetch_packed(void * sel_packed, cmph_uint32 one_idx);
+ *  \brief Prefetches the select table entry that @see select_query_packed reads for one_idx.
+ *  \param sel_packed is a pointer to a contiguous memory area
+ *  \param one_idx is the rank that will be queried
+ */
+void select_prefetch_packed(void * sel_packed, cmph_uint32 one_idx);
+
+/** \fn void select_prefetch_bits_packed(void * sel_packed, cmph_uint32 one_idx);
+ *  \brief Prefetches the bit vector bytes that @see select_query_packed scans for one_idx.
+ *  It reads the select table entry, which should have been prefetched by @see select_prefetch_packed.
+ *  \param sel_packed is a pointer to a contiguous memory area
+ *  \param one_idx is the rank that will be queried
+ */
+void select_prefetch_bits_packed(void * sel_packed, cmph_uint32 one_idx);
+
 #endif
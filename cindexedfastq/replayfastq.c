@@ -0,0 +1,536 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <bgzf.h>
+#include <khash.h>
+#include <ifq.h>
+#include <ifq_format.h>
+
+/*
+ * Size of a decompressed block as bgzf accounts for it in its cache.
+ */
+#define REPLAY_BLOCK_SIZE 65536
+
+/*
+ * Size of the header of a bgzf block, the compressed length of the
+ * block is stored in its last two bytes.
+ */
+#define REPLAY_HEADER_LENGTH 18
+
+KHASH_SET_INIT_INT64(blocks)
+KHASH_MAP_INIT_INT64(slots, uint32_t)
+
+void usage()
+{
+    printf( "Usage: replayfastq [-r rounds] [-C bgzf_cache_bytes] [-c cache_sizes] [-P policies] fastq index trace\n" );
+    printf( "Replays a query trace against an index and simulates the hit rate of the block cache.\n" );
+    printf( "Sizes take the suffixes K, M and G, the policies are bgzf, fifo and lru.\n" );
+}
+
+typedef enum
+{
+    /* Evicts the block in the first bucket of the hash table, as bgzf does */
+    POLICY_BGZF,
+    POLICY_FIFO,
+    POLICY_LRU,
+    POLICY_COUNT
+} replay_policy_t;
+
+static const char *policy_names[] = { "bgzf", "fifo", "lru" };
+
+static double
+now()
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Parses a size with an optional K, M or G suffix.
+ *
+ * @return The size in bytes, or -1 if it is invalid.
+ */
+static int64_t
+parse_size(const char *size)
+{
+    char *end;
+    double value = strtod( size, &end );
+    if( end == size || value < 0 )
+    {
+        return -1;
+    }
+
+    switch( *end )
+    {
+        case 'k': case 'K': value *= 1024.0; end++; break;
+        case 'm': case 'M': value *= 1024.0 * 1024.0; end++; break;
+        case 'g': case 'G': value *= 1024.0 * 1024.0 * 1024.0; end++; break;
+        default: break;
+    }
+
+    return *end == '\0' ? (int64_t) value : -1;
+}
+
+/**
+ * The blocks that the reads of a trace decompress, in the
+ * order that bgzf_read_range visits them.
+ */
+typedef struct
+{
+    /**
+     * Block addresses of all reads.
+     */
+    int64_t *blocks;
+
+    /**
+     * Blocks of read i are blocks[ first[ i ] ] to blocks[ first[ i + 1 ] - 1 ].
+     */
+    size_t *first;
+
+    /**
+     * Number of reads.
+     */
+    size_t num_reads;
+} read_blocks_t;
+
+/**
+ * Finds the blocks of every read of the trace from the block headers
+ * in the compressed fastq file.
+ *
+ * @param fastq_path Path of the compressed fastq file.
+ * @param records The records of the trace.
+ * @param num_records Number of records.
+ * @param reads Output, free the arrays with free.
+ *
+ * @return 1 if successful, 0 otherwise.
+ */
+static int
+find_read_blocks(const char *fastq_path, const ifq_trace_record_t *records, size_t num_records, read_blocks_t *reads)
+{
+    size_t capacity = num_records + 1;
+    size_t num_blocks = 0;
+    size_t i;
+    memset( reads, 0, sizeof( read_blocks_t ) );
+
+    int fd = open( fastq_path, O_RDONLY );
+    reads->blocks = (int64_t *) malloc( sizeof( int64_t ) * capacity );
+    reads->first = (size_t *) malloc( sizeof( size_t ) * ( num_records + 1 ) );
+    if( fd < 0 || reads->blocks == NULL || reads->first == NULL )
+    {
+        goto error;
+    }
+
+    for(i = 0; i < num_records; i++)
+    {
+        if( records[ i ].slot == IFQ_TRACE_NO_SLOT )
+        {
+            continue;
+        }
+
+        int64_t block_address = (int64_t) ( records[ i ].offset >> 16 );
+        uint32_t consumed = 0;
+        reads->first[ reads->num_reads++ ] = num_blocks;
+        while( consumed < records[ i ].span )
+        {
+            unsigned char header[ REPLAY_HEADER_LENGTH ];
+            if( pread( fd, header, REPLAY_HEADER_LENGTH, block_address + consumed ) != REPLAY_HEADER_LENGTH ||
+                header[ 0 ] != 31 || header[ 1 ] != 139 )
+            {
+                goto error;
+            }
+
+            if( num_blocks == capacity )
+            {
+                int64_t *blocks = (int64_t *) realloc( reads->blocks, sizeof( int64_t ) * capacity * 2 );
+                if( blocks == NULL )
+                {
+                    goto error;
+                }
+                reads->blocks = blocks;
+                capacity *= 2;
+            }
+            reads->blocks[ num_blocks++ ] = block_address + consumed;
+            consumed += (uint32_t) ( header[ 16 ] | ( header[ 17 ] << 8 ) ) + 1;
+        }
+    }
+    reads->first[ reads->num_reads ] = num_blocks;
+
+    close( fd );
+    return 1;
+
+error:
+    if( fd >= 0 )
+    {
+        close( fd );
+    }
+    free( reads->blocks );
+    free( reads->first );
+    memset( reads, 0, sizeof( read_blocks_t ) );
+    return 0;
+}
+
+/**
+ * Result of a simulated cache.
+ */
+typedef struct
+{
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+} cache_result_t;
+
+/**
+ * Simulates the bgzf policy, where the first block in the hash table
+ * is evicted. The table is the same khash as in bgzf, so that the
+ * same blocks are evicted.
+ */
+static void
+simulate_bgzf(const read_blocks_t *reads, size_t capacity, cache_result_t *result)
+{
+    khash_t(blocks) *h = kh_init( blocks );
+    int64_t last = -1;
+    size_t i;
+    for(i = 0; i < reads->first[ reads->num_reads ]; i++)
+    {
+        int64_t block = reads->blocks[ i ];
+        if( block == last || kh_get( blocks, h, block ) != kh_end( h ) )
+        {
+            result->hits++;
+            last = block;
+            continue;
+        }
+
+        result->misses++;
+        last = block;
+        if( capacity == 0 )
+        {
+            continue;
+        }
+        if( kh_size( h ) + 1 > capacity )
+        {
+            khint_t k;
+            for(k = kh_begin( h ); k < kh_end( h ); ++k)
+            {
+                if( kh_exist( h, k ) )
+                {
+                    break;
+                }
+            }
+            if( k < kh_end( h ) )
+            {
+                kh_del( blocks, h, k );
+                result->evictions++;
+            }
+        }
+
+        int ret;
+        kh_put( blocks, h, block, &ret );
+    }
+    kh_destroy( blocks, h );
+}
+
+/**
+ * Simulates a FIFO or an LRU cache, the cached blocks are kept in
+ * a list ordered by insertion or by use.
+ */
+static void
+simulate_list(const read_blocks_t *reads, size_t capacity, int lru, cache_result_t *result)
+{
+    khash_t(slots) *h = kh_init( slots );
+    int64_t *addresses = (int64_t *) malloc( sizeof( int64_t ) * ( capacity + 1 ) );
+    uint32_t *prev = (uint32_t *) malloc( sizeof( uint32_t ) * ( capacity + 1 ) );
+    uint32_t *next = (uint32_t *) malloc( sizeof( uint32_t ) * ( capacity + 1 ) );
+    uint32_t size = 0;
+    int64_t last = -1;
+    size_t i;
+
+    /* Node capacity is the head of the circular list, newest first */
+    uint32_t head = (uint32_t) capacity;
+    if( addresses == NULL || prev == NULL || next == NULL )
+    {
+        goto done;
+    }
+    prev[ head ] = next[ head ] = head;
+
+    for(i = 0; i < reads->first[ reads->num_reads ]; i++)
+    {
+        int64_t block = reads->blocks[ i ];
+        khint_t k = kh_get( slots, h, block );
+        if( block == last || k != kh_end( h ) )
+        {
+            result->hits++;
+            last = block;
+            if( lru && k != kh_end( h ) )
+            {
+                uint32_t node = kh_val( h, k );
+                next[ prev[ node ] ] = next[ node ];
+                prev[ next[ node ] ] = prev[ node ];
+                prev[ node ] = head;
+                next[ node ] = next[ head ];
+                prev[ next[ head ] ] = node;
+                next[ head ] = node;
+            }
+            continue;
+        }
+
+        result->misses++;
+        last = block;
+        if( capacity == 0 )
+        {
+            continue;
+        }
+
+        uint32_t node;
+        if( size < capacity )
+        {
+            node = size++;
+        }
+        else
+        {
+            node = prev[ head ];
+            next[ prev[ node ] ] = head;
+            prev[ head ] = prev[ node ];
+            kh_del( slots, h, kh_get( slots, h, addresses[ node ] ) );
+            result->evictions++;
+        }
+
+        int ret;
+        k = kh_put( slots, h, block, &ret );
+        kh_val( h, k ) = node;
+        addresses[ node ] = block;
+        prev[ node ] = head;
+        next[ node ] = next[ head ];
+        prev[ next[ head ] ] = node;
+        next[ head ] = node;
+    }
+
+done:
+    free( addresses );
+    free( prev );
+    free( next );
+    kh_destroy( slots, h );
+}
+
+static int
+compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return ( x > y ) - ( x < y );
+}
+
+/**
+ * Reads the records of the trace again and prints the throughput
+ * and the latencies of the reads.
+ *
+ * @return The number of found reads whose record no longer has the
+ *         fingerprint of the trace.
+ */
+static size_t
+replay(ifq_index_t *index, const ifq_trace_record_t *records, size_t num_records, int rounds, double *latencies)
+{
+    ifq_record_t *record = ifq_new_record( );
+    size_t num_samples = 0;
+    size_t mismatches = 0;
+    size_t i;
+    int round;
+
+    double start = now( );
+    for(round = 0; round < rounds; round++)
+    {
+        for(i = 0; i < num_records; i++)
+        {
+            if( records[ i ].slot == IFQ_TRACE_NO_SLOT )
+            {
+                continue;
+            }
+
+            double t = now( );
+            ifq_codes_t ret = ifq_read_slot( index, records[ i ].slot, record );
+            latencies[ num_samples++ ] = ( now( ) - t ) * 1e9;
+            if( ( records[ i ].flags & IFQ_TRACE_FOUND ) != 0 &&
+                ( ret != IFQ_OK || ifq_fingerprint( record->name, strlen( record->name ) ) != records[ i ].fingerprint ) )
+            {
+                mismatches++;
+            }
+        }
+    }
+    double seconds = now( ) - start;
+    ifq_destroy_record( record );
+
+    printf( "%-8s %10s %10s %9s %9s %9s %9s\n", "replay", "reads", "reads/s", "p50_ns", "p90_ns", "p99_ns", "max_ns" );
+    if( num_samples > 0 )
+    {
+        qsort( latencies, num_samples, sizeof( double ), compare_doubles );
+        printf( "%-8s %10zu %10.0f %9.0f %9.0f %9.0f %9.0f\n", "", num_samples, num_samples / seconds,
+                latencies[ num_samples / 2 ], latencies[ num_samples * 90 / 100 ],
+                latencies[ num_samples * 99 / 100 ], latencies[ num_samples - 1 ] );
+    }
+
+    ifq_stats_t stats;
+    ifq_get_stats( index, &stats );
+    printf( "io       %.1f MB read, %llu blocks inflated, %llu cache hits, %llu cache misses, %llu evictions\n",
+            stats.compressed_bytes_read / 1e6, (unsigned long long) stats.blocks_inflated,
+            (unsigned long long) stats.cache_hits, (unsigned long long) stats.cache_misses,
+            (unsigned long long) stats.cache_evictions );
+
+    return mismatches;
+}
+
+int main(int argc, char **argv)
+{
+    const char *cache_sizes = "0,1M,8M,64M";
+    int policies[ POLICY_COUNT ] = { 1, 1, 1 };
+    int64_t bgzf_cache = 0;
+    int rounds = 1;
+
+    int opt;
+    while( ( opt = getopt( argc, argv, "r:C:c:P:" ) ) != -1 )
+    {
+        switch( opt )
+        {
+            case 'r':
+                rounds = atoi( optarg );
+                break;
+            case 'C':
+                bgzf_cache = parse_size( optarg );
+                if( bgzf_cache < 0 || bgzf_cache > INT32_MAX )
+                {
+                    printf( "Invalid cache size: %s\n", optarg );
+                    exit( 1 );
+                }
+                break;
+            case 'c':
+                cache_sizes = optarg;
+                break;
+            case 'P':
+            {
+                memset( policies, 0, sizeof( policies ) );
+                char *names = strdup( optarg );
+                char *name;
+                for(name = strtok( names, "," ); name != NULL; name = strtok( NULL, "," ))
+                {
+                    int p;
+                    for(p = 0; p < POLICY_COUNT && strcmp( name, policy_names[ p ] ) != 0; p++);
+                    if( p == POLICY_COUNT )
+                    {
+                        printf( "Unknown policy: %s\n", name );
+                        exit( 1 );
+                    }
+                    policies[ p ] = 1;
+                }
+                free( names );
+                break;
+            }
+            default:
+                usage( );
+                exit( 1 );
+        }
+    }
+
+    if( argc - optind != 3 || rounds <= 0 )
+    {
+        usage( );
+        exit( 1 );
+    }
+
+    ifq_trace_header_t header;
+    ifq_trace_record_t *records;
+    size_t num_records;
+    if( ifq_load_trace( argv[ optind + 2 ], &header, &records, &num_records ) != IFQ_OK )
+    {
+        printf( "Failed to read trace %s\n", argv[ optind + 2 ] );
+        return 1;
+    }
+
+    ifq_index_t index;
+    if( ifq_open_index( argv[ optind ], argv[ optind + 1 ], &index ) != IFQ_OK )
+    {
+        printf( "Failed to open index\n" );
+        return 1;
+    }
+    if( header.num_entries != index.num_entries )
+    {
+        printf( "The trace is of another index, it has %llu entries and the index %llu\n",
+                (unsigned long long) header.num_entries, (unsigned long long) index.num_entries );
+        return 1;
+    }
+    bgzf_set_cache_size( index.fastq_file, (int) bgzf_cache );
+
+    read_blocks_t reads;
+    if( find_read_blocks( argv[ optind ], records, num_records, &reads ) != 1 )
+    {
+        printf( "Failed to find the blocks of the reads\n" );
+        return 1;
+    }
+    size_t num_blocks = reads.first[ reads.num_reads ];
+    printf( "trace    %zu records, %zu reads, %zu blocks\n", num_records, reads.num_reads, num_blocks );
+
+    double *latencies = (double *) malloc( sizeof( double ) * ( reads.num_reads * rounds + 1 ) );
+    if( latencies == NULL )
+    {
+        printf( "Out of memory\n" );
+        return 1;
+    }
+    size_t mismatches = replay( &index, records, num_records, rounds, latencies );
+    if( mismatches > 0 )
+    {
+        printf( "warning: %zu reads returned another record than in the trace\n", mismatches );
+    }
+
+    printf( "%-8s %10s %10s %10s %10s %8s %13s\n", "policy", "cache", "hits", "misses", "evictions", "hit_rate",
+            "inflates/read" );
+    char *sizes = strdup( cache_sizes );
+    char *size;
+    for(size = strtok( sizes, "," ); size != NULL; size = strtok( NULL, "," ))
+    {
+        int64_t cache_bytes = parse_size( size );
+        if( cache_bytes < 0 )
+        {
+            printf( "Invalid cache size: %s\n", size );
+            continue;
+        }
+
+        /* bgzf caches nothing unless the cache holds more than one block */
+        size_t capacity = cache_bytes > REPLAY_BLOCK_SIZE ? (size_t) ( cache_bytes / REPLAY_BLOCK_SIZE ) : 0;
+        int p;
+        for(p = 0; p < POLICY_COUNT; p++)
+        {
+            if( !policies[ p ] )
+            {
+                continue;
+            }
+
+            cache_result_t result;
+            memset( &result, 0, sizeof( cache_result_t ) );
+            if( p == POLICY_BGZF )
+            {
+                simulate_bgzf( &reads, capacity, &result );
+            }
+            else
+            {
+                simulate_list( &reads, capacity, p == POLICY_LRU, &result );
+            }
+
+            printf( "%-8s %10s %10llu %10llu %10llu %7.2f%% %13.3f\n", policy_names[ p ], size,
+                    (unsigned long long) result.hits, (unsigned long long) result.misses,
+                    (unsigned long long) result.evictions,
+                    num_blocks > 0 ? 100.0 * result.hits / num_blocks : 0.0,
+                    reads.num_reads > 0 ? (double) result.misses / reads.num_reads : 0.0 );
+        }
+    }
+
+    free( sizes );
+    free( latencies );
+    free( reads.blocks );
+    free( reads.first );
+    free( records );
+    ifq_destroy_index( &index );
+
+    return 0;
+}
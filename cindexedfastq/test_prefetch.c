@@ -0,0 +1,185 @@
+/**
+ * Checks that ifq_prefetch asks the kernel to read ahead the blocks of
+ * the records also when the index is not in the page cache. Linked
+ * with -Wl,--wrap=posix_fadvise,--wrap=madvise so that the advice to
+ * the fastq file can be recorded, and the read ahead of the index can
+ * be held back as on a slow disk.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <bgzf.h>
+
+#include <ifq.h>
+#include <ifq_format.h>
+
+#define NUM_READS 4000
+#define NUM_MISSES 1000
+#define READ_LENGTH 150
+
+int __real_posix_fadvise(int fd, off_t offset, off_t length, int advice);
+int __real_madvise(void *address, size_t length, int advice);
+
+static int recording = 0;
+static int num_advised = 0;
+static int num_bad = 0;
+static int fastq_fd = -1;
+
+int
+__wrap_posix_fadvise(int fd, off_t offset, off_t length, int advice)
+{
+    if( recording )
+    {
+        if( fd == fastq_fd && length > 0 && advice == POSIX_FADV_WILLNEED )
+        {
+            num_advised++;
+        }
+        else
+        {
+            num_bad++;
+        }
+    }
+
+    return __real_posix_fadvise( fd, offset, length, advice );
+}
+
+int
+__wrap_madvise(void *address, size_t length, int advice)
+{
+    /* The index pages have not arrived yet when the blocks are advised */
+    if( recording && advice == MADV_WILLNEED )
+    {
+        return 0;
+    }
+
+    return __real_madvise( address, length, advice );
+}
+
+/**
+ * Writes a bgzipped fastq file with NUM_READS reads named read0, read1...
+ *
+ * @return 1 if successful, 0 otherwise.
+ */
+static int
+write_fastq(const char *path)
+{
+    BGZF *fp = bgzf_open( path, "w" );
+    if( fp == NULL )
+    {
+        return 0;
+    }
+
+    char record[ 2 * READ_LENGTH + 64 ];
+    uint32_t state = 1;
+    int ok = 1;
+    int i, j;
+    for(i = 0; ok && i < NUM_READS; i++)
+    {
+        int length = sprintf( record, "@read%d\n", i );
+        for(j = 0; j < READ_LENGTH; j++)
+        {
+            state = state * 1664525 + 1013904223;
+            record[ length++ ] = "ACGT"[ state >> 30 ];
+        }
+        length += sprintf( record + length, "\n+\n" );
+        memset( record + length, 'I', READ_LENGTH );
+        length += READ_LENGTH;
+        record[ length++ ] = '\n';
+        ok = bgzf_write( fp, record, length ) == length;
+    }
+
+    return bgzf_close( fp ) == 0 && ok;
+}
+
+/**
+ * Drops the pages of a file from the page cache.
+ */
+static void
+evict_file(const char *path)
+{
+    int fd = open( path, O_RDONLY );
+    if( fd != -1 )
+    {
+        fdatasync( fd );
+        __real_posix_fadvise( fd, 0, 0, POSIX_FADV_DONTNEED );
+        close( fd );
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *directory = argc > 1 ? argv[ 1 ] : ".";
+    char fastq_path[ 4096 ];
+    char index_path[ 4096 ];
+    snprintf( fastq_path, sizeof( fastq_path ), "%s/prefetch.fq.gz", directory );
+    snprintf( index_path, sizeof( index_path ), "%s%s", fastq_path, IFQ_INDEX_EXTENSION );
+
+    if( !write_fastq( fastq_path ) || ifq_create_index( fastq_path, fastq_path ) != IFQ_OK )
+    {
+        fprintf( stderr, "test_prefetch: could not create the index in %s\n", directory );
+        return 1;
+    }
+
+    /* A cold index in a fresh mapping */
+    evict_file( index_path );
+    evict_file( fastq_path );
+    ifq_index_t index;
+    int i;
+    if( ifq_open_index( fastq_path, fastq_path, &index ) != IFQ_OK )
+    {
+        fprintf( stderr, "test_prefetch: could not open the index\n" );
+        return 1;
+    }
+    fastq_fd = index.fastq_file->file_descriptor;
+
+    /* Opening faults in the pages around the header, unmap them and
+     * drop them from the page cache again. Without read around on the
+     * faults of the hash function the table stays cold until read */
+    __real_madvise( index.data, index.data_size, MADV_DONTNEED );
+    __real_madvise( index.data, index.data_size, MADV_RANDOM );
+    evict_file( index_path );
+    evict_file( fastq_path );
+    long page_size = sysconf( _SC_PAGESIZE );
+    uintptr_t first = (uintptr_t) index.table & ~( (uintptr_t) page_size - 1 );
+    size_t num_pages = ( (uintptr_t) index.table + index.lookup_size - first + page_size - 1 ) / page_size;
+    unsigned char *resident = (unsigned char *) malloc( num_pages );
+    size_t num_resident = 0;
+    if( resident != NULL && mincore( (void *) first, num_pages * page_size, resident ) == 0 )
+    {
+        for(i = 0; i < (int) num_pages; i++)
+        {
+            num_resident += resident[ i ] & 1;
+        }
+    }
+    free( resident );
+
+    char **queries = (char **) malloc( sizeof( char * ) * ( NUM_READS + NUM_MISSES ) );
+    for(i = 0; i < NUM_READS + NUM_MISSES; i++)
+    {
+        queries[ i ] = (char *) malloc( 32 );
+        sprintf( queries[ i ], i < NUM_READS ? "read%d" : "missing%d", i );
+    }
+
+    recording = 1;
+    ifq_prefetch( &index, queries, NUM_READS + NUM_MISSES );
+    recording = 0;
+
+    int failed = num_advised != NUM_READS || num_bad != 0;
+    printf( "test_prefetch: %zu of %zu table pages resident, %d of %d records advised, %d bad calls\n",
+            num_resident, num_pages, num_advised, NUM_READS, num_bad );
+
+    for(i = 0; i < NUM_READS + NUM_MISSES; i++)
+    {
+        free( queries[ i ] );
+    }
+    free( queries );
+    ifq_destroy_index( &index );
+    unlink( index_path );
+    unlink( fastq_path );
+
+    return failed;
+}
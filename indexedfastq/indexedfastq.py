@@ -1,57 +1,197 @@
+import itertools
+
 import cindexedfastq
 
-class FastqRecord:
-    def __init__(self, name, sequence, quality):
-        self.name = name
-        self.sequence = sequence
-        self.quality = quality
+# Number of accessions that fetch looks up in each call to the C library
+FETCH_BATCH_SIZE = 1024
+
+# Number of worker threads that read the records of fetch_async
+ASYNC_WORKERS = 4
 
-    def __str__(self):
-        return "@{0}\n{1}\n+\n{2}\n".format( self.name, self.sequence, self.quality )
+try:
+    basestring
+except NameError:
+    basestring = str
 
-    def __repr__(self):
-        return "(@{0},{1},+,{2})".format( self.name, self.sequence, self.quality )
+# A record holds its fields in one buffer, name, sequence and quality
+# are decoded when accessed, name_bytes, sequence_bytes and
+# quality_bytes are copies without decoding, and name_view,
+# sequence_view and quality_view are memoryviews that copy nothing.
+FastqRecord = cindexedfastq.FastqRecord
 
 class IndexedFastq:
     def __init__(self, handle):
         self.handle = handle
+        self.executor = None
 
     def fetch(self, query_iter):
         if not self.handle:
             return
 
         if isinstance( query_iter, basestring ):
-            name, sequence, quality = cindexedfastq.query_indexed_fastq( self.handle, query_iter )
-            if name != None:
-                yield FastqRecord( name, sequence, quality )
+            record = cindexedfastq.query_indexed_fastq( self.handle, query_iter )
+            if record != None:
+                yield record
+            return
+
+        # Look up the accessions in batches, each read in file order
+        query_iter = iter( query_iter )
+        while True:
+            batch = list( itertools.islice( query_iter, FETCH_BATCH_SIZE ) )
+            if not batch:
                 return
 
-        for query in query_iter:
-            name, sequence, quality = cindexedfastq.query_indexed_fastq( self.handle, query )
+            for record in cindexedfastq.query_many_indexed_fastq( self.handle, batch ):
+                if record != None:
+                    yield record
+
+    def fetch_many(self, queries):
+        """Returns a list with the FastqRecord of every accession in
+        queries, or None where it is not in the file. All accessions are
+        looked up in a single call, and the records are read in file
+        order rather than in the order of the queries."""
+        if not self.handle:
+            return None
+
+        return cindexedfastq.query_many_indexed_fastq( self.handle, list( queries ) )
+
+    def extract(self, queries, field="sequence", out=None):
+        """Copies the sequence, quality or name of the records of queries
+        one after the other into a contiguous buffer, and returns it with
+        a buffer of int64 offsets, field i is data[offsets[i]:offsets[i + 1]]
+        and is empty for accessions that are not in the file. Both support
+        the buffer protocol, numpy.frombuffer( data, dtype = numpy.uint8 )
+        and numpy.asarray( offsets ) wrap them without copying, and no
+        Python object is made per read. With out, a writable contiguous
+        buffer such as a bytearray or a numpy array, the fields are written
+        into it and it is returned as data. When it is full only the first
+        len( offsets ) - 1 accessions are extracted."""
+        if not self.handle:
+            return None
+
+        return cindexedfastq.extract_indexed_fastq( self.handle, list( queries ), field, out )
+
+    def fetch_async(self, queries):
+        """Returns an asyncio future of fetch_many( queries ), for use
+        as records = await ifq.fetch_async( keys ). The records are read
+        by a pool of ASYNC_WORKERS threads, and the C library releases
+        the GIL while it reads and inflates, so the event loop keeps
+        serving other requests meanwhile."""
+        import asyncio
+        import concurrent.futures
+
+        if not self.handle:
+            raise ValueError( "The index is closed." )
+
+        if self.executor == None:
+            self.executor = concurrent.futures.ThreadPoolExecutor( max_workers = ASYNC_WORKERS )
+
+        loop = asyncio.get_running_loop( )
+        return loop.run_in_executor( self.executor, self.fetch_many, list( queries ) )
+
+    def prefetch(self, query_iter):
+        if not self.handle:
+            return
+
+        if isinstance( query_iter, basestring ):
+            query_iter = [ query_iter ]
+
+        cindexedfastq.prefetch_indexed_fastq( self.handle, list( query_iter ) )
+
+    def stats(self):
+        """Returns a dict with the number of queries, records_returned
+        and not_found, the compressed_bytes_read, blocks_inflated,
+        cache_hits, cache_misses and cache_evictions of the fastq file,
+        and the table_bytes and table_entries of the lookup table."""
+        if not self.handle:
+            return None
+
+        return cindexedfastq.stats_indexed_fastq( self.handle )
 
-            if name != None:
-                yield FastqRecord( name, sequence, quality )
+    def reset_stats(self):
+        if self.handle:
+            cindexedfastq.reset_stats_indexed_fastq( self.handle )
+
+    def start_trace(self, path):
+        """Logs the key fingerprint, slot and block address of every
+        query to a binary trace at path, that replayfastq replays."""
+        if self.handle:
+            cindexedfastq.start_trace_indexed_fastq( self.handle, path )
+
+    def stop_trace(self):
+        if self.handle:
+            cindexedfastq.stop_trace_indexed_fastq( self.handle )
+
+    def latency_histograms(self):
+        """Returns a dict from query stage (hash, table, seek, inflate,
+        parse and total) to a dict with the count, mean_ns, max_ns,
+        p50_ns, p90_ns, p99_ns, p999_ns and the nonempty buckets as
+        (lower_ns, count) pairs. None unless the index was opened with
+        timing=True in a build with IFQ_TIMING."""
+        if not self.handle:
+            return None
+
+        return cindexedfastq.latency_histograms_indexed_fastq( self.handle )
+
+    def reset_latency_histograms(self):
+        if self.handle:
+            cindexedfastq.reset_latency_histograms_indexed_fastq( self.handle )
 
     def close(self):
+        """Closes the index, after waiting for the pending fetch_async
+        calls. This blocks the event loop until they are done, services
+        built on asyncio should await close_async( ) instead."""
+        if self.executor != None:
+            self.executor.shutdown( wait = True )
+            self.executor = None
+
         if self.handle:
-            handle = cindexedfastq.close_indexed_fastq( fastq_path, index_prefix )
+            cindexedfastq.close_indexed_fastq( self.handle )
             self.handle = None
 
-def create_indexed_fastq(fastq_path, index_prefix=None, open=True):
+    def close_async(self):
+        """Returns an asyncio future that closes the index once the
+        pending fetch_async calls are done, for use as
+        await ifq.close_async( ). The waiting happens on a thread of the
+        event loop, so it keeps serving other requests meanwhile."""
+        import asyncio
+
+        loop = asyncio.get_running_loop( )
+        return loop.run_in_executor( None, self.close )
+
+def create_indexed_fastq(fastq_path, index_prefix=None, open=True, algorithm=None, b=0, keys_per_bin=0, graph_size=0.0, hash=None, profile=None, progress=None):
+    """Indexes a bgzipped fastq file. The measurements of each phase of
+    the build are written as JSON to the path profile, and progress is
+    called as progress( event, phase, done, total ) where event is
+    "start", "end" or "progress" and phase a dict with the name, runs,
+    wall_seconds, cpu_seconds, peak_rss_kb and bytes_decompressed of the
+    phase."""
     if not index_prefix:
         index_prefix = fastq_path
 
-    cindexedfastq.create_indexed_fastq( fastq_path, index_prefix )
+    cindexedfastq.create_indexed_fastq( fastq_path, index_prefix, algorithm, b, keys_per_bin, graph_size, hash, profile, progress )
 
     if open:
         return cindexedfastq.open_indexed_fastq( fastq_path, index_prefix )
     else:
         return None
 
-def open_indexed_fastq(fastq_path, index_prefix=None):
+def open_indexed_fastq(fastq_path, index_prefix=None, populate=False, lock=False, hugepages=False, verify=False, timing=False):
     if not index_prefix:
         index_prefix = fastq_path
+
+    flags = cindexedfastq.OPEN_DEFAULT
+    if populate:
+        flags |= cindexedfastq.OPEN_POPULATE
+    if lock:
+        flags |= cindexedfastq.OPEN_LOCK
+    if hugepages:
+        flags |= cindexedfastq.OPEN_HUGEPAGES
+    if verify:
+        flags |= cindexedfastq.OPEN_VERIFY
+    if timing:
+        flags |= cindexedfastq.OPEN_TIMING
     
-    handle = cindexedfastq.open_indexed_fastq( fastq_path, index_prefix )
+    handle = cindexedfastq.open_indexed_fastq( fastq_path, index_prefix, flags )
 
     return IndexedFastq( handle )
@@ -22,6 +22,7 @@ cmph_src_files = [
     "cindexedfastq/lib/cmph/src/chm.c",
     "cindexedfastq/lib/cmph/src/cmph.c",
     "cindexedfastq/lib/cmph/src/cmph_benchmark.c",
+    "cindexedfastq/lib/cmph/src/cmph_cpu.c",
     "cindexedfastq/lib/cmph/src/cmph_structs.c",
     "cindexedfastq/lib/cmph/src/compressed_rank.c",
     "cindexedfastq/lib/cmph/src/compressed_seq.c",
@@ -32,6 +33,7 @@ cmph_src_files = [
     "cindexedfastq/lib/cmph/src/jenkins_hash.c",
     "cindexedfastq/lib/cmph/src/linear_string_map.c",
     "cindexedfastq/lib/cmph/src/miller_rabin.c",
+    "cindexedfastq/lib/cmph/src/mum_hash.c",
     "cindexedfastq/lib/cmph/src/select.c",
     "cindexedfastq/lib/cmph/src/vqueue.c",
     "cindexedfastq/lib/cmph/src/vstack.c"
@@ -43,6 +45,7 @@ bgzf_src_files = [
 
 cindexedfastq_src_files = [
     "cindexedfastq/ifq.c",
+    "cindexedfastq/ifq_format.c",
     "cindexedfastq/cindexedfastq.c"
 ]
 
@@ -67,6 +70,15 @@ config_file.write( """#define VERSION "2.0"
 #define HAVE_UNISTD_H 1""" )
 config_file.close( )
 
+# Per-stage latency histograms of the queries, built with IFQ_TIMING=1
+cindexedfastq_macros = []
+if os.environ.get( "IFQ_TIMING", "0" ) not in ( "", "0" ):
+    cindexedfastq_macros += [ ( "IFQ_TIMING", None ), ( "BGZF_TIMING", None ) ]
+
+# USDT probes for perf and bpftrace, built with IFQ_USDT=1, needs sys/sdt.h
+if os.environ.get( "IFQ_USDT", "0" ) not in ( "", "0" ):
+    cindexedfastq_macros += [ ( "IFQ_USDT", None ), ( "BGZF_USDT", None ), ( "CMPH_USDT", None ) ]
+
 cindexedfastq = Extension(
     "indexedfastq.cindexedfastq",
     cmph_src_files + bgzf_src_files + cindexedfastq_src_files,
@@ -75,7 +87,7 @@ cindexedfastq = Extension(
     libraries=["z"],
     language="c",
     extra_compile_args=[],
-    define_macros=[]
+    define_macros=cindexedfastq_macros
 )
 
 setup(name='indexedfastq',